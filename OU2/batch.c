@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "parallel.h"
+#include "file_map.h"
+#include <pthread.h>
+
+typedef struct batch_work batch_work;
+
+/* A file of the list, from reading it to writing the result */
+typedef struct {
+    batch_work *work;
+    const char *in_path;
+    char *out_path;
+    unsigned char *data;
+    size_t size;
+    unsigned char *out;
+    bool mapped;
+    FILE *out_file_p;
+    container *header;
+    block_job *job;
+    size_t remaining;
+} batch_file;
+
+struct batch_work {
+    const huffman_table *table;
+    block_options blocks;
+    bool decode;
+    batch_file *files;
+    size_t count;
+
+    pthread_mutex_t lock;
+    size_t failed;
+};
+
+static size_t parse_list(char *list, bool decode, batch_file **files);
+static void start_file(task_worker *worker, void *context, size_t i);
+static void code_block(task_worker *worker, void *context, size_t i);
+static void finish_file(batch_file *file);
+static int close_result(batch_file *file, int err);
+
+int batch(const char *mode, const char *frequency_path, const char *list_path,
+          const prog_options *options) {
+    bool decode = strcmp(mode, "-decode") == 0;
+    if (!decode && strcmp(mode, "-encode") != 0) {
+        fprintf(stderr, "Unknown option: %s\n", mode);
+        return 1;
+    }
+
+    FILE *list_file_p = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "rb");
+    if (list_file_p == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", list_path);
+        return 1;
+    }
+    size_t list_size;
+    unsigned char *list = read_file(list_file_p, &list_size);
+    if (list_file_p != stdin) {
+        fclose(list_file_p);
+    }
+    if (list == NULL) {
+        fprintf(stderr, "Could not read the file: %s\n", list_path);
+        return 1;
+    }
+    /* Terminated, so that the lines can be used as strings */
+    list = realloc(list, list_size + 1);
+    list[list_size] = '\0';
+
+    FILE *frequency_file_p = fopen(frequency_path, "r");
+    if (frequency_file_p == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", frequency_path);
+        free(list);
+        return 1;
+    }
+    huffman_table *table = load_table(frequency_file_p, options);
+    fclose(frequency_file_p);
+    if (table == NULL) {
+        fprintf(stderr, "Could not read the file: %s\n", frequency_path);
+        free(list);
+        return 1;
+    }
+
+    batch_work work;
+    work.table = table;
+    work.blocks = options->blocks;
+    work.decode = decode;
+    work.count = parse_list((char *)list, decode, &work.files);
+    work.failed = 0;
+    pthread_mutex_init(&work.lock, NULL);
+    for (size_t i = 0; i < work.count; i++) {
+        work.files[i].work = &work;
+    }
+
+    /* One task per file, which spawns a task per block, so the blocks
+       of a large file are stolen by the threads that have run out of
+       files */
+    parallel_tasks(work.count, options->blocks.threads, start_file, &work);
+
+    for (size_t i = 0; i < work.count; i++) {
+        free(work.files[i].out_path);
+    }
+    pthread_mutex_destroy(&work.lock);
+    free(work.files);
+    free(table);
+    free(list);
+
+    return work.failed > 0 ? 1 : 0;
+}
+
+/*
+ * Splits the list into lines and stores a newly allocated array of the
+ * files in *files. The names point into list. Returns the number of
+ * files.
+ */
+static size_t parse_list(char *list, bool decode, batch_file **files) {
+    size_t capacity = 16;
+    size_t used = 0;
+    *files = malloc(capacity * sizeof(batch_file));
+
+    for (char *line = list; *line != '\0';) {
+        char *end = line + strcspn(line, "\n");
+        char *next = *end != '\0' ? end + 1 : end;
+        *end = '\0';
+        if (end > line && end[-1] == '\r') {
+            *--end = '\0';
+        }
+        if (end == line) {
+            line = next;
+            continue;
+        }
+
+        batch_file *file = memset(&(*files)[used], 0, sizeof(batch_file));
+        char *tab = strchr(line, '\t');
+        size_t suffix = strlen(BATCH_SUFFIX);
+        size_t length = end - line;
+
+        if (tab != NULL) {
+            *tab = '\0';
+            file->out_path = strdup(tab + 1);
+        } else if (!decode) {
+            file->out_path = malloc(length + suffix + 1);
+            memcpy(file->out_path, line, length);
+            strcpy(file->out_path + length, BATCH_SUFFIX);
+        } else if (length > suffix && strcmp(end - suffix, BATCH_SUFFIX) == 0) {
+            file->out_path = strndup(line, length - suffix);
+        }
+        file->in_path = line;
+
+        if (++used == capacity) {
+            capacity *= 2;
+            *files = realloc(*files, capacity * sizeof(batch_file));
+        }
+        line = next;
+    }
+
+    return used;
+}
+
+static void start_file(task_worker *worker, void *context, size_t i) {
+    batch_work *work = context;
+    batch_file *file = &work->files[i];
+    size_t count = 0;
+
+    FILE *in = file->out_path != NULL ? fopen(file->in_path, "rb") : NULL;
+    if (in != NULL) {
+        file->data = read_file(in, &file->size);
+        fclose(in);
+    }
+
+    if (file->data != NULL && !work->decode) {
+        file->job = encode_blocks_start(work->table, file->data, file->size,
+                                        &work->blocks, &count);
+    } else if (file->data != NULL) {
+        file->header = malloc(sizeof(container));
+        container *c = file->header;
+        if (container_read(c, file->data, file->size, work->table) == 0 &&
+            (file->out_file_p = fopen(file->out_path, "w+b")) != NULL) {
+            /* The blocks are decoded straight into the output file */
+            file->out = file_map_output(file->out_file_p, c->characters);
+            file->mapped = file->out != NULL;
+            if (!file->mapped) {
+                file->out = malloc(c->characters > 0 ? c->characters : 1);
+            }
+            if (file->out != NULL) {
+                file->job = decode_blocks_start(c->model, c->blocks, c->size, c->sizes,
+                                                c->count, file->out, c->characters,
+                                                &count);
+            }
+        }
+    }
+
+    if (file->job == NULL || count == 0) {
+        finish_file(file);
+        return;
+    }
+    file->remaining = count;
+    for (size_t j = count; j-- > 0;) {
+        parallel_spawn(worker, code_block, file, j);
+    }
+}
+
+static void code_block(task_worker *worker, void *context, size_t i) {
+    (void)worker;
+    batch_file *file = context;
+    block_job_run(file->job, i);
+
+    pthread_mutex_lock(&file->work->lock);
+    bool last = --file->remaining == 0;
+    pthread_mutex_unlock(&file->work->lock);
+
+    if (last) {
+        finish_file(file);
+    }
+}
+
+/* Joins the blocks of the file, writes the result and frees the data */
+static void finish_file(batch_file *file) {
+    batch_work *work = file->work;
+    int err = -1;
+
+    if (file->job != NULL && !work->decode) {
+        file->out_file_p = fopen(file->out_path, "w+b");
+        if (file->out_file_p != NULL) {
+            err = encode_file_finish(file->out_file_p, work->table, file->job, file->size,
+                                     &work->blocks);
+        } else {
+            encode_blocks_finish_bytes(file->job, NULL);
+        }
+    } else if (file->job != NULL) {
+        err = decode_blocks_finish(file->job);
+    }
+    file->job = NULL;
+    err = close_result(file, err);
+
+    if (err) {
+        fprintf(stderr, "Could not %s the file: %s\n", work->decode ? "decode" : "encode",
+                file->in_path);
+        pthread_mutex_lock(&work->lock);
+        work->failed++;
+        pthread_mutex_unlock(&work->lock);
+    }
+
+    free(file->data);
+    free(file->header);
+    file->data = NULL;
+    file->header = NULL;
+}
+
+/* Writes a decoded result that is not mapped, and closes the output
+   file. Returns err, or -1 if writing failed. */
+static int close_result(batch_file *file, int err) {
+    size_t n = file->header != NULL ? file->header->characters : 0;
+
+    if (file->mapped) {
+        if (file_unmap_output(file->out_file_p, file->out, n, err) != 0) {
+            err = -1;
+        }
+    } else {
+        if (err == 0 && file->out != NULL && fwrite(file->out, 1, n, file->out_file_p) != n) {
+            err = -1;
+        }
+        free(file->out);
+    }
+    file->out = NULL;
+    file->mapped = false;
+
+    if (file->out_file_p != NULL && fclose(file->out_file_p) != 0) {
+        err = -1;
+    }
+    file->out_file_p = NULL;
+    return err;
+}
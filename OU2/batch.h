@@ -0,0 +1,27 @@
+#ifndef BATCH
+#define BATCH
+
+#include "huffman.h"
+
+/*
+ * Encodes or decodes many files with one model.
+ *
+ * Each line of the list file names a file, optionally followed by a tab
+ * and the name of the result. By default -encode stores the result in
+ * the name with BATCH_SUFFIX added, and -decode in the name with
+ * BATCH_SUFFIX removed. A list file of - is read from stdin.
+ */
+
+#define BATCH_SUFFIX ".huf"
+
+/*
+ * Encodes (mode "-encode") or decodes (mode "-decode") the files in
+ * list_path with the model of the file frequency_path. The files are
+ * split into blocks and the blocks of all files are coded by
+ * options->blocks.threads threads, see parallel_tasks. Returns 0 if
+ * every file was coded and 1 otherwise.
+ */
+int batch(const char *mode, const char *frequency_path, const char *list_path,
+          const prog_options *options);
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ * Measures the throughput of the block encoder and decoder, with and
+ * without block checksums, run-length coding and the Burrows-Wheeler
+ * transform. Built and run with
+ * make bench.
+ *
+ * USAGE: bench_huffman [-counters] FILE0 FILE [ITERATIONS]
+ *
+ * The model table is built from FILE0 and FILE is encoded and decoded
+ * in memory. The best time of the iterations is reported.
+ *
+ * With -counters the hardware counters of perf_counters.h are read
+ * around every stage, and the counts of the best iteration are reported
+ * per byte of FILE (/B), or per symbol (/sym) for the stages whose work
+ * follows the symbols: the tree build per used symbol and the single
+ * threaded huffman_encode and huffman_decode per coded symbol. Counters
+ * that are not available are left out.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "calc_frequency.h"
+#include "huffman_trie.h"
+#include "huffman_table.h"
+#include "huffman_codec.h"
+#include "huffman_block.h"
+#include "container.h"
+#include "huffman_speculative.h"
+#include "crc32c.h"
+#include "parallel.h"
+#include "perf_counters.h"
+
+#define DEFAULT_ITERATIONS 10
+
+/* The best time of the iterations of a stage and the counts of the
+   iteration that took it */
+typedef struct {
+    double time;
+    perf_sample sample;
+} measure;
+
+static bool use_counters = false;
+static perf_counters counters;
+
+static double now(void);
+static double measure_start(void);
+static void measure_stop(measure *best, double start, int iteration);
+static void print_counts(const measure *m, double units, const char *unit);
+static huffman_table *model_table(FILE *fp);
+static void bench_stages(const unsigned char *data, size_t n, const huffman_table *model,
+                         int iterations);
+static void bench_blocks(const huffman_table *model, const unsigned char *data,
+                         size_t n, const char *name, const block_options *options,
+                         int iterations);
+
+int main(int argc, const char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "-counters") == 0) {
+        use_counters = true;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+    if (argc < 3) {
+        printf("USAGE:\n%s [-counters] FILE0 FILE [ITERATIONS]\n", argv[0]);
+        return 1;
+    }
+    int iterations = argc > 3 ? atoi(argv[3]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        iterations = DEFAULT_ITERATIONS;
+    }
+
+    FILE *model_file = fopen(argv[1], "r");
+    FILE *data_file = fopen(argv[2], "rb");
+    if (model_file == NULL || data_file == NULL) {
+        fprintf(stderr, "Could not open the files\n");
+        return 1;
+    }
+
+    huffman_table *model = model_table(model_file);
+    size_t n;
+    unsigned char *data = read_file(data_file, &n);
+    fclose(model_file);
+    fclose(data_file);
+    if (data == NULL) {
+        fprintf(stderr, "Could not read the file: %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("%s: %zu bytes, %d iterations\n", argv[2], n, iterations);
+    if (use_counters && perf_counters_open(&counters) == 0) {
+        printf("No hardware counters: %s\n", counters.error);
+        use_counters = false;
+    } else if (use_counters && counters.error != NULL) {
+        printf("Some hardware counters are missing: %s\n", counters.error);
+    }
+
+    measure best;
+    uint32_t crc = 0;
+    for (int i = 0; i < iterations; i++) {
+        double start = measure_start();
+        crc = crc32c(0, data, n);
+        measure_stop(&best, start, i);
+    }
+    printf("crc32c (%s): %8.1f MB/s  [%08x]\n",
+           crc32c_hardware() ? "sse4.2" : "table", n / best.time / 1e6, crc);
+    print_counts(&best, n, "B");
+
+    bench_stages(data, n, model, iterations);
+
+    block_options plain = {0};
+    block_options checksum = {.checksum = true};
+    block_options rle = {.rle = true};
+    block_options bwt = {.bwt = true};
+    block_options ans = {.ans = true};
+    bench_blocks(model, data, n, "plain", &plain, iterations);
+    bench_blocks(model, data, n, "checksum", &checksum, iterations);
+    bench_blocks(model, data, n, "rle", &rle, iterations);
+    bench_blocks(model, data, n, "bwt", &bwt, iterations);
+    bench_blocks(model, data, n, "ans", &ans, iterations);
+
+    free(data);
+    free(model);
+    if (use_counters) {
+        perf_counters_close(&counters);
+    }
+    return 0;
+}
+
+/* The stages of the codec one by one: counting, building the code, the
+   bit_buffer and the symbol loops of huffman_encode and huffman_decode,
+   on one thread */
+static void bench_stages(const unsigned char *data, size_t n, const huffman_table *model,
+                         int iterations) {
+    measure best;
+    uint64_t counts[256];
+    for (int i = 0; i < iterations; i++) {
+        memset(counts, 0, sizeof(counts));
+        double start = measure_start();
+        count_bytes(data, n, counts);
+        measure_stop(&best, start, i);
+    }
+    printf("histogram   %8.1f MB/s\n", n / best.time / 1e6);
+    print_counts(&best, n, "B");
+
+    int used = 0;
+    for (int s = 0; s < 256; s++) {
+        used += counts[s] > 0;
+    }
+    for (int i = 0; i < iterations; i++) {
+        charFrequency frequency[256];
+        for (int s = 0; s < 256; s++) {
+            frequency[s].character = s;
+            frequency[s].frequency = counts[s];
+        }
+        double start = measure_start();
+        trie_pq *pq = process_frequency(frequency);
+        trie_node *root = build_huffman_trie(pq);
+        huffman_table *table = build_huffman_table(root);
+        measure_stop(&best, start, i);
+
+        free_huffman_trie(root);
+        trie_pq_kill(pq);
+        free(table);
+    }
+    printf("tree        %8.1f us for %d symbols\n", best.time * 1e6, used);
+    print_counts(&best, used, "sym");
+
+    /* The codes in memory, as the block coder leaves them */
+    bit_buffer *codes = bit_buffer_empty();
+    huffman_encode(model, data, n, codes);
+    size_t size = (bit_buffer_size(codes) + 7) / 8;
+    char *code_bytes = bit_buffer_to_byte_array(codes);
+    bit_buffer_free(codes);
+
+    for (int i = 0; i < iterations; i++) {
+        double start = measure_start();
+        bit_buffer *b = bit_buffer_empty();
+        for (size_t k = 0; k < size; k += 64 * 1024) {
+            bit_buffer_append_bytes(b, code_bytes + k, size - k < 64 * 1024 ? size - k : 64 * 1024);
+        }
+        char *bytes = bit_buffer_to_byte_array(b);
+        bit_buffer_free(b);
+        measure_stop(&best, start, i);
+        free(bytes);
+    }
+    printf("bit_buffer  %8.1f MB/s  append and to_byte_array of %zu bytes\n",
+           size / best.time / 1e6, size);
+    print_counts(&best, size, "B");
+
+    measure best_decode;
+    unsigned char *out = malloc(n > 0 ? n : 1);
+    for (int i = 0; i < iterations; i++) {
+        bit_buffer *b = bit_buffer_empty();
+        double start = measure_start();
+        huffman_encode(model, data, n, b);
+        measure_stop(&best, start, i);
+        bit_buffer_free(b);
+
+        start = measure_start();
+        int err = huffman_decode(model, (const unsigned char *)code_bytes, size, out, n, NULL);
+        measure_stop(&best_decode, start, i);
+        if (err != 0 || memcmp(out, data, n) != 0) {
+            fprintf(stderr, "The decoded data differs\n");
+        }
+    }
+    printf("symbols     encode %8.1f MB/s  decode %8.1f MB/s\n",
+           n / best.time / 1e6, n / best_decode.time / 1e6);
+    print_counts(&best, n, "sym");
+    print_counts(&best_decode, n, "sym");
+
+    /* The same codes as one unindexed run, on all processors */
+    for (int i = 0; i < iterations; i++) {
+        double start = measure_start();
+        int err = huffman_decode_speculative(model, (const unsigned char *)code_bytes, size,
+                                             out, n, 0);
+        measure_stop(&best_decode, start, i);
+        if (err != 0 || memcmp(out, data, n) != 0) {
+            fprintf(stderr, "The decoded data differs\n");
+        }
+    }
+    printf("speculative decode %8.1f MB/s on %d threads\n",
+           n / best_decode.time / 1e6, parallel_processors());
+    print_counts(&best_decode, n, "sym");
+
+    free(out);
+    free(code_bytes);
+}
+
+static void bench_blocks(const huffman_table *model, const unsigned char *data,
+                         size_t n, const char *name, const block_options *options,
+                         int iterations) {
+    measure best_encode;
+    measure best_decode;
+    size_t size = 0;
+    unsigned char *out = malloc(n > 0 ? n : 1);
+    container *c = malloc(sizeof(container));
+
+    for (int i = 0; i < iterations; i++) {
+        double start = measure_start();
+        unsigned char *codes = encode_buffer(model, data, n, options, &size);
+        measure_stop(&best_encode, start, i);
+
+        /* The blocks are located with the block table of the header */
+        start = measure_start();
+        int err = container_read(c, codes, size, model);
+        if (err == 0) {
+            err = decode_blocks(model, c->blocks, c->size, c->sizes, c->count, out, n, options);
+        }
+        measure_stop(&best_decode, start, i);
+
+        if (err != 0 || memcmp(out, data, n) != 0) {
+            fprintf(stderr, "The decoded data differs\n");
+        }
+        free(codes);
+    }
+
+    printf("%-10s  encode %8.1f MB/s  decode %8.1f MB/s  size %zu (%.1f%%)\n",
+           name, n / best_encode.time / 1e6, n / best_decode.time / 1e6,
+           size, n > 0 ? 100.0 * size / n : 0.0);
+    print_counts(&best_encode, n, "B");
+    print_counts(&best_decode, n, "B");
+    free(c);
+    free(out);
+}
+
+static huffman_table *model_table(FILE *fp) {
+    charFrequency *frequency = calc_frequency(fp);
+    trie_pq *pq = process_frequency(frequency);
+    trie_node *root = build_huffman_trie(pq);
+    huffman_table *table = build_huffman_table(root);
+
+    free_huffman_trie(root);
+    trie_pq_kill(pq);
+    free(frequency);
+    return table;
+}
+
+static double measure_start(void) {
+    if (use_counters) {
+        perf_counters_start(&counters);
+    }
+    return now();
+}
+
+/* Keeps the time and the counts of the iteration if it is the fastest
+   so far */
+static void measure_stop(measure *best, double start, int iteration) {
+    double t = now() - start;
+    perf_sample sample;
+    if (use_counters) {
+        perf_counters_stop(&counters, &sample);
+    }
+    if (iteration == 0 || t < best->time) {
+        best->time = t;
+        if (use_counters) {
+            best->sample = sample;
+        }
+    }
+}
+
+/* Prints the counts of the measure divided by units */
+static void print_counts(const measure *m, double units, const char *unit) {
+    if (!use_counters || units <= 0) {
+        return;
+    }
+    const perf_sample *s = &m->sample;
+
+    printf("           ");
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (s->valid[c]) {
+            printf(" %s %.3f/%s", perf_counter_name(c), s->value[c] / units, unit);
+        }
+    }
+    if (s->valid[PERF_CYCLES] && s->valid[PERF_INSTRUCTIONS] && s->value[PERF_CYCLES] > 0) {
+        printf(" IPC %.2f", (double)s->value[PERF_INSTRUCTIONS] / s->value[PERF_CYCLES]);
+    }
+    printf("\n");
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
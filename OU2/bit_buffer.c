@@ -15,8 +15,15 @@
  * next_insert, points to where the next bit should be inserted. To
  * keep track of the content to be removed a "pointer" (the index of
  * the bit in the array), next_removed, points to the next bit to be
- * removed. The buffer is circular and dynamically increases it size
- * when needed.
+ * removed. The content is always the contiguous bits from next_remove
+ * up to next_insert, so it can be copied with memcpy when it is byte
+ * aligned. When an insert reaches the end of the array, the content
+ * is moved to the start of a new array, which is at least twice as
+ * large as the content.
+ *
+ * A buffer created with bit_buffer_wrap uses the caller's array
+ * without copying it. The array is only read, it is copied the first
+ * time something is inserted into the buffer.
  *
  * For more information see the corresponding .h-file.
  *
@@ -30,6 +37,8 @@
 
 #include "bit_buffer.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <assert.h>
 
 /* A structure used to handle the resources connected to the bit
@@ -44,6 +53,8 @@
  *                      the array.
  * @elem next_remove    A "pointer" (the index of the bit) to the bit
  *                      that is next to be removed from the array.
+ * @elem owns_array     False if the array belongs to the caller of
+ *                      bit_buffer_wrap.
  */
 struct bit_buffer {
 	int capacity;
@@ -51,6 +62,7 @@ struct bit_buffer {
 	int size;
 	int next_insert;
 	int next_remove;
+	bool owns_array;
 };
 
 
@@ -60,6 +72,11 @@ static int bit_buffer_get_bit_value(const bit_buffer *const b,
 static void bit_buffer_set_bit_value(bit_buffer *b,
                                      const int bit_in_array,
                                      const int value);
+static void bit_buffer_make_room(bit_buffer *b, const int bits);
+static void copy_bits(char *dst, int dst_bit, const char *src,
+                      int src_bit, int bits);
+static inline uint64_t load_be64(const unsigned char *p);
+static inline void store_be64(unsigned char *p, uint64_t value);
 
 
 /* ---------------------- External functions ---------------------- */
@@ -69,9 +86,10 @@ bit_buffer *bit_buffer_copy(const bit_buffer *const b)
 	assert(b);
 	assert(b->array);
 	bit_buffer *res = bit_buffer_empty();
-	for (int i = 0 ; i < bit_buffer_size(b) ; i++) {
-		bit_buffer_insert_bit(res, bit_buffer_inspect_bit(b, i));
-	}
+	bit_buffer_make_room(res, b->size);
+	copy_bits(res->array, 0, b->array, b->next_remove, b->size);
+	res->size = b->size;
+	res->next_insert = b->size;
 
 	return res;
 }
@@ -81,15 +99,29 @@ bit_buffer *bit_buffer_create(const char *const byte_array,
                               const int size)
 {
 	bit_buffer *b = bit_buffer_empty();
-	b->array = realloc(b->array, size);
-	assert(b->array);
+	bit_buffer_append_bytes(b, byte_array, size);
+
+	return b;
+}
 
-	for (int i = 0 ; i < size ; i++) {
-		b->array[i] = byte_array[i];
+
+bit_buffer *bit_buffer_wrap(const char *const byte_array,
+                            const int size)
+{
+	if (size <= 0) {
+		return bit_buffer_empty();
 	}
 
+	bit_buffer *b = malloc(sizeof(*b));
+	assert(b);
+
+	/* The array is never written while owns_array is false */
+	b->array = (char *)byte_array;
 	b->capacity = size * 8;
 	b->size = size * 8;
+	b->next_insert = size * 8;
+	b->next_remove = 0;
+	b->owns_array = false;
 
 	return b;
 }
@@ -106,6 +138,7 @@ bit_buffer *bit_buffer_empty()
 	b->size = 0;
 	b->next_insert = 0;
 	b->next_remove = 0;
+	b->owns_array = true;
 
 	return b;
 }
@@ -115,7 +148,9 @@ void bit_buffer_free(bit_buffer *b)
 {
 	assert(b);
 	assert(b->array);
-	free(b->array);
+	if (b->owns_array) {
+		free(b->array);
+	}
 	free(b);
 }
 
@@ -126,31 +161,13 @@ void bit_buffer_insert_bit(bit_buffer *b, const int value)
 	assert(b->array);
 
 	/* Extend the capacity of the buffer if needed */
-	if (bit_buffer_size(b) + 1 == b->capacity) {
-		b->array = realloc(b->array, b->capacity / 8 + 1);
-		b->capacity += 8;
-		b->array[(b->capacity / 8) - 1] = 0;
-
-		/* Handle the case if the new byte is inserted in the middle of
-		legal data in the buffer */
-		if (b->next_remove >= b->next_insert) {
-			int i;
-			for (i = b->capacity - 1 ; i - 8 >= b->next_remove ; i--) {
-				int value = bit_buffer_get_bit_value(b, i - 8);
-				bit_buffer_set_bit_value(b, i, value);
-			}
-			for (i = b->next_remove ; i < b->next_remove + 8 ; i++) {
-				bit_buffer_set_bit_value(b, i, 0);
-			}
-			b->next_remove += 8;
-		}
-	}
+	bit_buffer_make_room(b, 1);
 
 	/* Update the value of the bit in the buffer */
 	bit_buffer_set_bit_value(b, b->next_insert, value);
 
 	/* Update information */
-	b->next_insert = (b->next_insert + 1) % b->capacity;
+	b->next_insert++;
 	b->size++;
 }
 
@@ -159,9 +176,54 @@ void bit_buffer_insert_byte(bit_buffer *b, const char the_byte)
 {
 	assert(b);
 	assert(b->array);
-	for (int bit = 7 ; bit >= 0 ; bit--) {
-		bit_buffer_insert_bit(b, (the_byte & (1 << bit)));
+	bit_buffer_append_bytes(b, &the_byte, 1);
+}
+
+
+void bit_buffer_append_bytes(bit_buffer *b, const char *const bytes,
+                             const int n)
+{
+	assert(b);
+	assert(b->array);
+	if (n <= 0) {
+		return;
 	}
+
+	bit_buffer_make_room(b, n * 8);
+	copy_bits(b->array, b->next_insert, bytes, 0, n * 8);
+	b->next_insert += n * 8;
+	b->size += n * 8;
+}
+
+
+void bit_buffer_concat(bit_buffer *dst, const bit_buffer *const src)
+{
+	assert(dst);
+	assert(src);
+	assert(dst != src);
+
+	bit_buffer_make_room(dst, src->size);
+	copy_bits(dst->array, dst->next_insert, src->array, src->next_remove,
+	          src->size);
+	dst->next_insert += src->size;
+	dst->size += src->size;
+}
+
+
+void bit_buffer_splice(bit_buffer *dst, bit_buffer *src, const int bits)
+{
+	assert(dst);
+	assert(src);
+	assert(dst != src);
+	assert(bits >= 0 && bits <= src->size);
+
+	bit_buffer_make_room(dst, bits);
+	copy_bits(dst->array, dst->next_insert, src->array, src->next_remove,
+	          bits);
+	dst->next_insert += bits;
+	dst->size += bits;
+	src->next_remove += bits;
+	src->size -= bits;
 }
 
 
@@ -170,9 +232,8 @@ int bit_buffer_inspect_bit(const bit_buffer *const b,
 {
 	assert(b);
 	assert(b->array);
-	int bit_in_buffer = (bit_no + b->next_remove) % b->capacity;
 
-	return bit_buffer_get_bit_value(b, bit_in_buffer);
+	return bit_buffer_get_bit_value(b, b->next_remove + bit_no);
 }
 
 
@@ -182,8 +243,10 @@ int bit_buffer_remove_bit(bit_buffer *b)
 	assert(b->array);
 	assert(b->size > 0);
 	int value = bit_buffer_get_bit_value(b, b->next_remove);
-	bit_buffer_set_bit_value(b, b->next_remove, false);
-	b->next_remove = (b->next_remove + 1) % b->capacity;
+	if (b->owns_array) {
+		bit_buffer_set_bit_value(b, b->next_remove, false);
+	}
+	b->next_remove++;
 	b->size--;
 
 	return value;
@@ -197,16 +260,37 @@ char bit_buffer_remove_byte(bit_buffer *b)
 	assert(b->size >= 8);
 	char the_byte = 0;
 
-	for (int bit = 7 ; bit >= 0 ; bit--) {
-		if (bit_buffer_remove_bit(b)) {
-			the_byte = the_byte | 1 << bit;
-		}
-	}
+	bit_buffer_read_bytes(b, &the_byte, 1);
 
 	return the_byte;
 }
 
 
+void bit_buffer_read_bytes(bit_buffer *b, char *const bytes, const int n)
+{
+	assert(b);
+	assert(b->array);
+	assert(b->size >= n * 8);
+	if (n <= 0) {
+		return;
+	}
+
+	copy_bits(bytes, 0, b->array, b->next_remove, n * 8);
+	b->next_remove += n * 8;
+	b->size -= n * 8;
+}
+
+
+const char *bit_buffer_span(const bit_buffer *const b, int *const first_bit)
+{
+	assert(b);
+	assert(b->array);
+
+	*first_bit = b->next_remove % 8;
+	return b->array + b->next_remove / 8;
+}
+
+
 int bit_buffer_size(const bit_buffer *const b)
 {
 	assert(b);
@@ -219,10 +303,10 @@ char *bit_buffer_to_byte_array(const bit_buffer *const b)
 {
 	assert(b);
 	assert(b->array);
-	char *res = calloc(b->capacity / 8, sizeof(char));
-	for (int i = 0 ; i < b->capacity / 8 ; i++) {
-		res[i] = b->array[i];
-	}
+	int bytes = (b->size + 7) / 8;
+	char *res = calloc(bytes > 0 ? bytes : 1, sizeof(char));
+	assert(res);
+	copy_bits(res, 0, b->array, b->next_remove, b->size);
 
 	return res;
 }
@@ -337,3 +421,144 @@ static void bit_buffer_set_bit_value(bit_buffer *b,
 	/* Copy the updated byte to the buffer */
 	b->array[byte_no] = the_byte;
 }
+
+
+/*
+ * @brief               Makes sure that bits more bits can be inserted
+ *                      at next_insert in the array, and that the array
+ *                      belongs to the buffer. If not, the content is
+ *                      moved to the start of a new array at least
+ *                      twice as large as the new content.
+ *
+ * @param b             The bit buffer.
+ * @param bits          The number of bits to make room for.
+ * @return              -
+ */
+static void bit_buffer_make_room(bit_buffer *b, const int bits)
+{
+	if (b->owns_array && b->next_insert + bits <= b->capacity) {
+		return;
+	}
+
+	int needed = b->size + bits;
+	int capacity = b->capacity > 16 ? b->capacity : 16;
+	while (capacity < 2 * needed) {
+		capacity *= 2;
+	}
+
+	char *array = calloc(capacity / 8, sizeof(char));
+	assert(array);
+	copy_bits(array, 0, b->array, b->next_remove, b->size);
+
+	if (b->owns_array) {
+		free(b->array);
+	}
+	b->array = array;
+	b->capacity = capacity;
+	b->next_remove = 0;
+	b->next_insert = b->size;
+	b->owns_array = true;
+}
+
+
+/*
+ * @brief               Copies bits from one array to another. Bit 0 is
+ *                      the most significant bit of the first byte. The
+ *                      copy uses memcpy when both positions are byte
+ *                      aligned, and merges shifted 64-bit words when
+ *                      they are not. Bits outside the destination
+ *                      range are left unchanged.
+ *
+ * @param dst           The destination array.
+ * @param dst_bit       The index of the first bit to write in dst.
+ * @param src           The source array.
+ * @param src_bit       The index of the first bit to read in src.
+ * @param bits          The number of bits to copy.
+ * @return              -
+ */
+static void copy_bits(char *dst, int dst_bit, const char *src,
+                      int src_bit, int bits)
+{
+	unsigned char *d = (unsigned char *)dst + dst_bit / 8;
+	const unsigned char *s = (const unsigned char *)src + src_bit / 8;
+	int d_off = dst_bit % 8;
+	int s_off = src_bit % 8;
+
+	/* Copy single bits until the destination is byte aligned */
+	while (bits > 0 && d_off != 0) {
+		int bit = (*s >> (7 - s_off)) & 1;
+		*d = (*d & ~(1 << (7 - d_off))) | bit << (7 - d_off);
+		bits--;
+		if (++s_off == 8) {
+			s_off = 0;
+			s++;
+		}
+		if (++d_off == 8) {
+			d_off = 0;
+			d++;
+		}
+	}
+
+	int bytes = bits / 8;
+	if (s_off == 0) {
+		memcpy(d, s, bytes);
+	} else {
+		int i = 0;
+		for ( ; i + 8 <= bytes ; i += 8) {
+			uint64_t word = load_be64(s + i) << s_off | s[i + 8] >> (8 - s_off);
+			store_be64(d + i, word);
+		}
+		for ( ; i < bytes ; i++) {
+			d[i] = (unsigned char)(s[i] << s_off | s[i + 1] >> (8 - s_off));
+		}
+	}
+	d += bytes;
+	s += bytes;
+	bits -= bytes * 8;
+
+	/* The last bits, less than a byte */
+	if (bits > 0) {
+		unsigned int next = s[0] << 8;
+		if (s_off + bits > 8) {
+			next |= s[1];
+		}
+		unsigned char value = (unsigned char)(next >> (8 - s_off));
+		unsigned char mask = (unsigned char)(0xFF << (8 - bits));
+		*d = (*d & ~mask) | (value & mask);
+	}
+}
+
+
+/*
+ * @brief               Reads 8 bytes as a big-endian 64-bit word, so
+ *                      that bit 0 of the array is the most significant
+ *                      bit of the word.
+ *
+ * @param p             The bytes to read.
+ * @return              The word.
+ */
+static inline uint64_t load_be64(const unsigned char *p)
+{
+	uint64_t value = 0;
+	for (int i = 0 ; i < 8 ; i++) {
+		value = value << 8 | p[i];
+	}
+
+	return value;
+}
+
+
+/*
+ * @brief               Writes a 64-bit word as 8 big-endian bytes.
+ *
+ * @param p             Where to write the bytes.
+ * @param value         The word.
+ * @return              -
+ */
+static inline void store_be64(unsigned char *p, uint64_t value)
+{
+	for (int i = 7 ; i >= 0 ; i--) {
+		p[i] = (unsigned char)value;
+		value >>= 8;
+	}
+}
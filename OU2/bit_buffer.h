@@ -62,6 +62,23 @@ bit_buffer *bit_buffer_copy(const bit_buffer *const b);
 bit_buffer *bit_buffer_create(const char *const byte_array,
                               const int size);
 
+/**
+ * @brief             Creates a new bit buffer holding the bytes in
+ *                    byte_array without copying them. The array is
+ *                    only read by the buffer and must stay valid until
+ *                    the buffer is deallocated, or until something is
+ *                    inserted into the buffer, which makes it copy the
+ *                    content into its own memory. The user is
+ *                    responsible for deallocating the new buffer, which
+ *                    does not deallocate byte_array.
+ *
+ * @param byte_array  The bytes that the buffer will hold.
+ * @param size        The number of bytes in the byte_array.
+ * @return            The new allocated bit buffer.
+ */
+bit_buffer *bit_buffer_wrap(const char *const byte_array,
+                            const int size);
+
 /**
  * @brief             Creates a new empty bit buffer. The user is
  *                    responsible for deallocating the new buffer.
@@ -101,6 +118,48 @@ void bit_buffer_insert_bit(bit_buffer *b, const int value);
  */
 void bit_buffer_insert_byte(bit_buffer *b, const char the_byte);
 
+/**
+ * @brief             Insert n bytes (8 bits each) into the given bit
+ *                    buffer, in the same order as inserting them one
+ *                    at a time with bit_buffer_insert_byte. The bytes
+ *                    are copied with memcpy when the insert position
+ *                    is byte aligned. The size of the buffer is
+ *                    increased if needed.
+ *
+ * @param b           The bit buffer.
+ * @param bytes       The bytes to be inserted.
+ * @param n           The number of bytes.
+ * @return            -
+ */
+void bit_buffer_append_bytes(bit_buffer *b, const char *const bytes,
+                             const int n);
+
+/**
+ * @brief             Insert all bits in src into dst, as if they were
+ *                    inserted one at a time with bit_buffer_insert_bit.
+ *                    Neither buffer needs to be byte aligned, the bits
+ *                    are copied a 64-bit word at a time. src is not
+ *                    changed.
+ *
+ * @param dst         The bit buffer to insert the bits into.
+ * @param src         The bit buffer with the bits to insert.
+ * @return            -
+ */
+void bit_buffer_concat(bit_buffer *dst, const bit_buffer *const src);
+
+/**
+ * @brief             Remove the next bits bits from src and insert
+ *                    them into dst, at any bit alignment. If src
+ *                    contains less than bits bits the behaviour is
+ *                    undefined.
+ *
+ * @param dst         The bit buffer to insert the bits into.
+ * @param src         The bit buffer to remove the bits from.
+ * @param bits        The number of bits to move.
+ * @return            -
+ */
+void bit_buffer_splice(bit_buffer *dst, bit_buffer *src, const int bits);
+
 /**
  * @brief             Returns the value of the given bit_no within the
  *                    bit buffer. bit_no = 0 referes to the first bit
@@ -138,6 +197,37 @@ int bit_buffer_remove_bit(bit_buffer *b);
  */
 char bit_buffer_remove_byte(bit_buffer *b);
 
+/**
+ * @brief             Removes the next n bytes of bits (8 bits each)
+ *                    from the bit buffer and stores them in bytes, as
+ *                    if bit_buffer_remove_byte was called n times. If
+ *                    the bit buffer contains less than 8 * n bits the
+ *                    behaviour is undefined.
+ *
+ * @param b           The bit buffer.
+ * @param bytes       The array to store the removed bytes in.
+ * @param n           The number of bytes.
+ * @return            -
+ */
+void bit_buffer_read_bytes(bit_buffer *b, char *const bytes, const int n);
+
+/**
+ * @brief             Returns a pointer to the content of the bit
+ *                    buffer without copying it. The bits to be
+ *                    removed are stored contiguously, starting at bit
+ *                    *first_bit (0 is the most significant bit) of
+ *                    the returned byte and continuing for
+ *                    bit_buffer_size(b) bits. The pointer is valid
+ *                    until the next insert into the buffer.
+ *
+ * @param b           The bit buffer.
+ * @param first_bit   Set to the index of the first bit in the first
+ *                    byte.
+ * @return            A pointer to the byte holding the next bit to be
+ *                    removed.
+ */
+const char *bit_buffer_span(const bit_buffer *const b, int *const first_bit);
+
 /**
  * @brief             Returns the number of bits in the bit buffer.
  *
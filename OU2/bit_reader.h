@@ -0,0 +1,56 @@
+#ifndef BIT_READER
+#define BIT_READER
+
+#include <stddef.h>
+#include <stdint.h>
+#include "byte_order.h"
+
+/*
+ * Helpers for reading codes, which are stored most significant bit
+ * first, through a 64-bit accumulator whose most significant bits are
+ * the next bits of the codes.
+ */
+
+/*
+ * Tops acc up to at least 56 bits, or to all that is left of the size
+ * bytes of codes in data, from byte *pos on. bits is the number of
+ * valid bits in acc. With 8 bytes left this is a single load: the bits
+ * past the counted ones are the next bits of the codes, which the next
+ * refill puts in the same places again.
+ */
+static inline void bit_refill(const unsigned char *data, size_t size, size_t *pos,
+                              uint64_t *acc, int *bits) {
+    if (size - *pos >= 8) {
+        *acc |= load_be64(data + *pos) >> *bits;
+        *pos += (63 - *bits) >> 3;
+        *bits |= 56;
+        return;
+    }
+    while (*bits <= 56 && *pos < size) {
+        *acc |= (uint64_t)data[(*pos)++] << (56 - *bits);
+        *bits += 8;
+    }
+}
+
+/*
+ * Returns the bits of the size bytes in data from bit pos on, most
+ * significant first, with 0 bits after the end of the data. At least 57
+ * of them are valid.
+ */
+static inline uint64_t bit_peek(const unsigned char *data, size_t size, uint64_t pos) {
+    size_t byte = pos >> 3;
+    uint64_t acc = 0;
+    if (byte >= size) {
+        return 0;
+    }
+    if (size - byte >= 8) {
+        acc = load_be64(data + byte);
+    } else {
+        for (size_t i = 0; byte + i < size; i++) {
+            acc |= (uint64_t)data[byte + i] << (56 - 8 * i);
+        }
+    }
+    return acc << (pos & 7);
+}
+
+#endif
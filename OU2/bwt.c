@@ -0,0 +1,177 @@
+#include "bwt.h"
+#include "sais.h"
+#include "rle.h"
+#include <stdlib.h>
+#include <string.h>
+
+int bwt_forward(const unsigned char *data, size_t n, unsigned char *out,
+                uint32_t *index) {
+    if (n > BWT_MAX_BLOCK) {
+        return -1;
+    }
+    int32_t *sa = malloc((n + 1) * sizeof(int32_t));
+    if (sa == NULL || sais(data, sa, n) != 0) {
+        free(sa);
+        return -1;
+    }
+
+    size_t starts[BWT_CHAINS];
+    for (int j = 0; j < BWT_CHAINS; j++) {
+        starts[j] = bwt_chain_start(n, j);
+        index[j] = 0;
+    }
+
+    /* Row 0 is the rotation that starts with the marker. The row of the
+       rotation that starts with the data ends with the marker. */
+    size_t k = 0;
+    if (n > 0) {
+        out[k++] = data[n - 1];
+    }
+    for (size_t i = 0; i < n; i++) {
+        size_t pos = sa[i];
+        for (int j = 0; j < BWT_CHAINS; j++) {
+            if (pos == starts[j]) {
+                index[j] = i + 1;
+            }
+        }
+        if (pos > 0) {
+            out[k++] = data[pos - 1];
+        }
+    }
+
+    free(sa);
+    return 0;
+}
+
+int bwt_inverse(const unsigned char *last, size_t n, const uint32_t *index,
+                unsigned char *out) {
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t primary = index[0];
+    if (n > BWT_MAX_BLOCK || primary == 0 || primary > n) {
+        return -1;
+    }
+    for (int j = 1; j < BWT_CHAINS; j++) {
+        if (index[j] > n) {
+            return -1;
+        }
+    }
+
+    /* next[row] holds the row of the rotation one step back in the
+       data, shifted up by 8 bits, and the character of the row. One
+       random access per character is then all a step needs. */
+    uint32_t *next = malloc((n + 1) * sizeof(uint32_t));
+    if (next == NULL) {
+        return -1;
+    }
+
+    size_t count[256] = {0};
+    for (size_t i = 0; i < n; i++) {
+        count[last[i]]++;
+    }
+    uint32_t start[256];
+    uint32_t sum = 1;
+    for (int c = 0; c < 256; c++) {
+        start[c] = sum;
+        sum += count[c];
+    }
+
+    for (size_t row = 0, i = 0; row <= n; row++) {
+        if (row == primary) {
+            next[row] = 0;
+            continue;
+        }
+        unsigned char c = last[i++];
+        next[row] = start[c]++ << 8 | c;
+    }
+
+    /* Segment j is written backwards from the start of segment j + 1,
+       and the loads of the segments do not depend on each other */
+    uint32_t row[BWT_CHAINS];
+    size_t end[BWT_CHAINS];
+    size_t shortest = n;
+    for (int j = 0; j < BWT_CHAINS; j++) {
+        row[j] = j + 1 < BWT_CHAINS ? index[j + 1] : 0;
+        end[j] = j + 1 < BWT_CHAINS ? bwt_chain_start(n, j + 1) : n;
+        size_t length = end[j] - bwt_chain_start(n, j);
+        shortest = length < shortest ? length : shortest;
+    }
+
+    for (size_t k = 0; k < shortest; k++) {
+        for (int j = 0; j < BWT_CHAINS; j++) {
+            uint32_t entry = next[row[j]];
+            out[--end[j]] = entry;
+            row[j] = entry >> 8;
+        }
+    }
+    for (int j = 0; j < BWT_CHAINS; j++) {
+        size_t first = bwt_chain_start(n, j);
+        while (end[j] > first) {
+            uint32_t entry = next[row[j]];
+            out[--end[j]] = entry;
+            row[j] = entry >> 8;
+        }
+    }
+
+    free(next);
+    return 0;
+}
+
+void mtf_encode(unsigned char *data, size_t n) {
+    unsigned char order[256];
+    for (int i = 0; i < 256; i++) {
+        order[i] = i;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = data[i];
+        int j = 0;
+        while (order[j] != c) {
+            j++;
+        }
+        memmove(order + 1, order, j);
+        order[0] = c;
+        data[i] = j;
+    }
+}
+
+void mtf_decode(unsigned char *data, size_t n) {
+    unsigned char order[256];
+    for (int i = 0; i < 256; i++) {
+        order[i] = i;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        int j = data[i];
+        unsigned char c = order[j];
+        memmove(order + 1, order, j);
+        order[0] = c;
+        data[i] = c;
+    }
+}
+
+size_t zero_run_encode(const unsigned char *mtf, size_t n, uint16_t *tokens) {
+    size_t used = 0;
+
+    for (size_t i = 0; i < n; ) {
+        if (mtf[i] != 0) {
+            tokens[used++] = mtf[i++];
+            continue;
+        }
+
+        size_t run = rle_run_length(mtf + i, n - i);
+        i += run;
+        while (run > 0) {
+            if (run & 1) {
+                tokens[used++] = RLE_RUNA;
+                run = (run - 1) / 2;
+            } else {
+                tokens[used++] = RLE_RUNB;
+                run = (run - 2) / 2;
+            }
+        }
+    }
+
+    return used;
+}
@@ -0,0 +1,61 @@
+#ifndef BWT
+#define BWT
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Burrows-Wheeler transform, move-to-front and zero-run coding, the
+ * transforms that bzip2 applies before its Huffman coding.
+ *
+ * The transform sorts the rotations of the data with an end marker that
+ * is smaller than all characters, and keeps the last column without
+ * the marker. index[0] is the row of the marker.
+ *
+ * The inverse follows one row to the next through the whole block,
+ * which is a cache miss per character. To keep several misses in
+ * flight, the data is also split into BWT_CHAINS segments, and index[j]
+ * for j > 0 is the row of the rotation that starts at segment j. The
+ * inverse then follows all segments at once.
+ */
+
+/* The inverse packs a row index and a character into 32 bits */
+#define BWT_MAX_BLOCK (8 * 1024 * 1024)
+#define BWT_CHAINS 8
+
+/* The position in the data where segment j starts */
+static inline size_t bwt_chain_start(size_t n, int j) {
+    return (size_t)((uint64_t)n * j / BWT_CHAINS);
+}
+
+/*
+ * Stores the transform of the n <= BWT_MAX_BLOCK characters in data in
+ * out, and the BWT_CHAINS rows described above in index. Returns 0 on
+ * success and -1 if memory runs out.
+ */
+int bwt_forward(const unsigned char *data, size_t n, unsigned char *out,
+                uint32_t *index);
+
+/*
+ * Stores the n characters that the transform in last came from in out.
+ * Returns 0 on success and -1 if index is invalid or memory runs out.
+ */
+int bwt_inverse(const unsigned char *last, size_t n, const uint32_t *index,
+                unsigned char *out);
+
+/*
+ * Replaces each character with the number of distinct characters seen
+ * since its last occurrence, in place.
+ */
+void mtf_encode(unsigned char *data, size_t n);
+void mtf_decode(unsigned char *data, size_t n);
+
+/*
+ * Codes the n move-to-front indices as symbols in tokens, which must
+ * have room for n symbols. Runs of zeros become their length in RLE_RUNA
+ * and RLE_RUNB digits as in rle.h, other indices are coded as
+ * themselves. Returns the number of symbols.
+ */
+size_t zero_run_encode(const unsigned char *mtf, size_t n, uint16_t *tokens);
+
+#endif
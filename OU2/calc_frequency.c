@@ -1,6 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "calc_frequency.h"
+#include <math.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_BLOCK_SIZE (64 * 1024)
+#define SAMPLE_BLOCK_SIZE (64 * 1024)
+#define SAMPLE_MIN_BLOCKS 16
+
+static charFrequency *empty_frequency(void);
+static void scale_counts(charFrequency *frequency, const uint64_t *counts,
+                         long long bytes_read, long long file_size);
+static uint64_t next_random(uint64_t *state);
 
 charFrequency *calc_frequency(FILE *frequency_file_p) {
+    charFrequency *frequency = empty_frequency();
+    unsigned char *buffer = malloc(READ_BLOCK_SIZE);
+    uint64_t counts[256] = {0};
+
+    size_t n;
+    while((n = fread(buffer, 1, READ_BLOCK_SIZE, frequency_file_p)) > 0) {
+        count_bytes(buffer, n, counts);
+    }
+    free(buffer);
+
+    for(int i = 0; i < 256; i++) {
+        frequency[i].frequency = counts[i];
+    }
+
+    // for(int i = 0; i < 256; i++) {
+    //     if(frequency[i].frequency > 0)
+    //     printf("Item %d: [%d, %d]\n", i, frequency[i].character, frequency[i].frequency);
+    // }
+
+    return frequency;
+}
+
+charFrequency *calc_frequency_sample(FILE *frequency_file_p, long long budget,
+                                     sample_stats *stats) {
+    int fd = fileno(frequency_file_p);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= budget) {
+        charFrequency *frequency = calc_frequency(frequency_file_p);
+        if (stats != NULL) {
+            stats->bytes_read = 0;
+            for (int i = 0; i < 256; i++) {
+                stats->bytes_read += frequency[i].frequency;
+            }
+            stats->file_size = stats->bytes_read;
+            stats->blocks = 1;
+            stats->est_kl_bits = 0.0;
+        }
+        return frequency;
+    }
+
+    /* Use smaller blocks for small budgets so the sample is still
+       spread over the whole file */
+    long long block_size = SAMPLE_BLOCK_SIZE;
+    if (budget / block_size < SAMPLE_MIN_BLOCKS) {
+        block_size = budget / SAMPLE_MIN_BLOCKS > 0 ? budget / SAMPLE_MIN_BLOCKS : 1;
+    }
+    long long blocks = budget / block_size;
+    long long stride = st.st_size / blocks;
+
+    unsigned char *buffer = malloc(block_size);
+    uint64_t halves[2][256] = {{0}};
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    long long bytes_read = 0;
+    int blocks_read = 0;
+
+    /* One block at a random offset within each stride. The generator
+       has a fixed seed, so the same file always gives the same model. */
+    for (long long i = 0; i < blocks; i++) {
+        long long slack = stride - block_size;
+        long long offset = i * stride;
+        if (slack > 0) {
+            offset += (long long)(next_random(&rng) % (uint64_t)(slack + 1));
+        }
+
+        ssize_t n = pread(fd, buffer, block_size, offset);
+        if (n <= 0) {
+            continue;
+        }
+
+        count_bytes(buffer, n, halves[blocks_read & 1]);
+        bytes_read += n;
+        blocks_read++;
+    }
+    free(buffer);
+
+    uint64_t total[256];
+    for (int i = 0; i < 256; i++) {
+        total[i] = halves[0][i] + halves[1][i];
+    }
+
+    charFrequency *frequency = empty_frequency();
+    scale_counts(frequency, total, bytes_read, st.st_size);
+
+    if (stats != NULL) {
+        /* The two halves are independent samples of half the size, so
+           their divergence is about four times the divergence between
+           the full sample and the whole file. */
+        charFrequency *half_a = empty_frequency();
+        charFrequency *half_b = empty_frequency();
+        for (int i = 0; i < 256; i++) {
+            half_a[i].frequency = halves[0][i];
+            half_b[i].frequency = halves[1][i];
+        }
+
+        stats->file_size = st.st_size;
+        stats->bytes_read = bytes_read;
+        stats->blocks = blocks_read;
+        stats->est_kl_bits = frequency_kl_divergence(half_a, half_b) / 4.0;
+
+        free(half_a);
+        free(half_b);
+    }
+
+    return frequency;
+}
+
+void count_bytes(const unsigned char *data, size_t n, uint64_t *counts) {
+    /* Four tables, so that runs of the same byte do not wait for the
+       previous increment of the same counter */
+    uint32_t tables[4][256] = {{0}};
+    size_t i = 0;
+
+    while (i < n) {
+        /* Flush before the 32-bit counters can overflow */
+        size_t end = n - i > (1u << 30) ? i + (1u << 30) : n;
+        for (; i + 4 <= end; i += 4) {
+            tables[0][data[i]]++;
+            tables[1][data[i + 1]]++;
+            tables[2][data[i + 2]]++;
+            tables[3][data[i + 3]]++;
+        }
+        for (; i < end; i++) {
+            tables[0][data[i]]++;
+        }
+        for (int s = 0; s < 256; s++) {
+            counts[s] += (uint64_t)tables[0][s] + tables[1][s] + tables[2][s] + tables[3][s];
+            tables[0][s] = tables[1][s] = tables[2][s] = tables[3][s] = 0;
+        }
+    }
+}
+
+double frequency_kl_divergence(const charFrequency *p, const charFrequency *q) {
+    double p_total = 0.0;
+    double q_total = 0.0;
+    int symbols = 0;
+
+    for (int i = 0; i < 256; i++) {
+        p_total += p[i].frequency;
+        q_total += q[i].frequency;
+        if (p[i].frequency > 0 || q[i].frequency > 0) {
+            symbols++;
+        }
+    }
+    if (p_total == 0.0 || q_total == 0.0) {
+        return 0.0;
+    }
+
+    /* Add half a count to every used symbol in q */
+    q_total += 0.5 * symbols;
+
+    double kl = 0.0;
+    for (int i = 0; i < 256; i++) {
+        if (p[i].frequency > 0) {
+            double p_i = p[i].frequency / p_total;
+            double q_i = (q[i].frequency + 0.5) / q_total;
+            kl += p_i * log2(p_i / q_i);
+        }
+    }
+
+    return kl > 0.0 ? kl : 0.0;
+}
+
+static charFrequency *empty_frequency(void) {
     charFrequency *frequency = (charFrequency *)malloc(256 * sizeof(charFrequency));
 
     for(int i = 0; i < 256; i++) {
@@ -8,17 +187,29 @@ charFrequency *calc_frequency(FILE *frequency_file_p) {
         frequency[i].frequency = 0;
     }
 
-    int character;
-    while((character = fgetc(frequency_file_p)) != EOF) {
-        if(character >= 0 && character < 256) {
-            frequency[character].frequency++;
+    return frequency;
+}
+
+/* Scales sampled counts to the file size. Symbols that were seen keep a
+   count of at least one. */
+static void scale_counts(charFrequency *frequency, const uint64_t *counts,
+                         long long bytes_read, long long file_size) {
+    double factor = bytes_read > 0 ? (double)file_size / bytes_read : 0.0;
+
+    for (int i = 0; i < 256; i++) {
+        if (counts[i] > 0) {
+            long long scaled = (long long)(counts[i] * factor + 0.5);
+            frequency[i].frequency = scaled > 0 ? scaled : 1;
         }
     }
-    
-    // for(int i = 0; i < 256; i++) {
-    //     if(frequency[i].frequency > 0) 
-    //     printf("Item %d: [%d, %d]\n", i, frequency[i].character, frequency[i].frequency);
-    // }
-    
-    return frequency;
-}
\ No newline at end of file
+}
+
+/* xorshift64* */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
@@ -4,12 +4,55 @@
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
+#include <stdint.h>
 
 typedef struct {
     int character;
-    int frequency;
+    long long frequency;
 } charFrequency;
 
+/*
+ * Statistics from a sampled frequency analysis.
+ *
+ * file_size    Size of the analysed file in bytes.
+ * bytes_read   Number of bytes actually read.
+ * blocks       Number of blocks read.
+ * est_kl_bits  Estimated KL divergence (bits per byte) between the
+ *              distribution of the whole file and the sampled one.
+ *              This is roughly the ratio lost compared with a full
+ *              scan. 0 when the whole file was read.
+ */
+typedef struct {
+    long long file_size;
+    long long bytes_read;
+    int blocks;
+    double est_kl_bits;
+} sample_stats;
+
 charFrequency *calc_frequency(FILE *frequency_file_p);
 
-#endif
\ No newline at end of file
+/*
+ * Calculates the frequencies of FILE0 by reading at most budget bytes
+ * in blocks spread evenly over the file, and scales the counts up to
+ * the full file size. Falls back to calc_frequency if the file is not
+ * a regular file or is smaller than the budget. The sampling is
+ * deterministic, so encoder and decoder get the same model. stats may
+ * be NULL.
+ */
+charFrequency *calc_frequency_sample(FILE *frequency_file_p, long long budget,
+                                     sample_stats *stats);
+
+/*
+ * Adds the number of occurrences of each byte value in data to counts,
+ * which must have 256 elements.
+ */
+void count_bytes(const unsigned char *data, size_t n, uint64_t *counts);
+
+/*
+ * Returns the KL divergence D(p || q) in bits per symbol between two
+ * frequency tables. Symbols missing in q are smoothed so the result
+ * stays finite.
+ */
+double frequency_kl_divergence(const charFrequency *p, const charFrequency *q);
+
+#endif
@@ -0,0 +1,100 @@
+#include "container.h"
+#include "byte_order.h"
+#include "crc32c.h"
+#include <string.h>
+
+uint32_t container_model_id(const huffman_table *model) {
+    unsigned char table[HUFF_TABLE_MAX_BYTES];
+    size_t size = huffman_table_write(model, table);
+    return crc32c(0, table, size);
+}
+
+size_t container_header_size(const huffman_table *model, size_t count, bool store_model) {
+    unsigned char table[HUFF_TABLE_MAX_BYTES];
+    size_t table_size = store_model ? huffman_table_write(model, table) : 0;
+    return CONTAINER_HEADER_BYTES + table_size + 8 * count;
+}
+
+size_t container_write(unsigned char *out, const huffman_table *model, uint64_t n,
+                       const block_size *sizes, size_t count, bool store_model) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        bytes += sizes[i].bytes;
+    }
+
+    memcpy(out, CONTAINER_MAGIC, 4);
+    out[4] = CONTAINER_VERSION;
+    out[5] = store_model ? CONTAINER_MODEL_TABLE : 0;
+    store_le64(out + 6, n);
+    store_le64(out + 14, bytes * 8);
+    store_le32(out + 22, count);
+    store_le32(out + 26, container_model_id(model));
+
+    size_t pos = CONTAINER_HEADER_BYTES;
+    if (store_model) {
+        pos += huffman_table_write(model, out + pos);
+    }
+    for (size_t i = 0; i < count; i++) {
+        store_le32(out + pos, sizes[i].chars);
+        store_le32(out + pos + 4, sizes[i].bytes);
+        pos += 8;
+    }
+
+    return pos;
+}
+
+int container_read(container *c, const unsigned char *data, size_t size,
+                   const huffman_table *model) {
+    if (size < CONTAINER_HEADER_BYTES || memcmp(data, CONTAINER_MAGIC, 4) != 0 ||
+        data[4] != CONTAINER_VERSION || (data[5] & ~CONTAINER_MODEL_TABLE) != 0) {
+        return -1;
+    }
+    c->flags = data[5];
+    c->characters = load_le64(data + 6);
+    c->bits = load_le64(data + 14);
+    c->count = load_le32(data + 22);
+    uint32_t model_id = load_le32(data + 26);
+    size_t pos = CONTAINER_HEADER_BYTES;
+
+    c->model = model;
+    if (c->flags & CONTAINER_MODEL_TABLE) {
+        size_t table_size = huffman_table_read(&c->stored_model, data + pos, size - pos);
+        if (table_size == 0) {
+            return -1;
+        }
+        c->model = &c->stored_model;
+        pos += table_size;
+    }
+    if (c->model == NULL || container_model_id(c->model) != model_id) {
+        return -1;
+    }
+
+    if ((size - pos) / 8 < c->count) {
+        return -1;
+    }
+    c->sizes = data + pos;
+    c->blocks = data + pos + 8 * (size_t)c->count;
+    c->size = size - (pos + 8 * (size_t)c->count);
+
+    /* Checked up front, so the decoder can trust the sizes it
+       allocates */
+    uint64_t chars = 0;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        block_size block = container_block(c, i);
+        chars += block.chars;
+        bytes += block.bytes;
+    }
+    if (chars != c->characters || bytes != c->size || c->bits != bytes * 8) {
+        return -1;
+    }
+
+    return 0;
+}
+
+block_size container_block(const container *c, size_t i) {
+    block_size block;
+    block.chars = load_le32(c->sizes + 8 * i);
+    block.bytes = load_le32(c->sizes + 8 * i + 4);
+    return block;
+}
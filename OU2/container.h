@@ -0,0 +1,96 @@
+#ifndef CONTAINER
+#define CONTAINER
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "huffman_table.h"
+#include "huffman_block.h"
+
+/*
+ * The header of an encoded file, in front of the blocks described in
+ * huffman_block.h:
+ *
+ *   offset  size  field
+ *   0       4     magic "HUFC"
+ *   4       1     version (1)
+ *   5       1     flags, CONTAINER_MODEL_TABLE if the model table is
+ *                 stored
+ *   6       8     number of characters
+ *   14      8     number of bits in the blocks, always whole bytes
+ *                 since every block ends on a byte boundary
+ *   22      4     number of blocks
+ *   26      4     model id, see container_model_id
+ *   30            the model table, only with CONTAINER_MODEL_TABLE,
+ *                 see huffman_table_write
+ *                 the block table, the u32 characters and u32 bytes of
+ *                 every block
+ *                 the blocks
+ *
+ * with all integers little-endian. The header tells the decoder the
+ * size of the output and of every block before it reads any codes.
+ * Each block is located from the sizes of the blocks before it, and a
+ * block whose header differs from its entry makes the file invalid, see
+ * parse_blocks.
+ */
+
+#define CONTAINER_MAGIC "HUFC"
+#define CONTAINER_VERSION 1
+#define CONTAINER_HEADER_BYTES 30
+#define CONTAINER_MODEL_TABLE 0x01
+
+/*
+ * A header as read by container_read.
+ *
+ * model    The table to decode the blocks with, either the given model
+ *          or stored_model.
+ * sizes    The block table, count entries of 8 bytes.
+ * blocks   The first block, and size the number of bytes of blocks.
+ */
+typedef struct {
+    int flags;
+    uint64_t characters;
+    uint64_t bits;
+    uint32_t count;
+    const unsigned char *sizes;
+    const unsigned char *blocks;
+    size_t size;
+    const huffman_table *model;
+    huffman_table stored_model;
+} container;
+
+/*
+ * Returns the CRC-32C of the model table as written by
+ * huffman_table_write, which identifies the model of a file.
+ */
+uint32_t container_model_id(const huffman_table *model);
+
+/*
+ * Returns the size of the header of a file with count blocks.
+ */
+size_t container_header_size(const huffman_table *model, size_t count, bool store_model);
+
+/*
+ * Writes the header of a file with n characters in the count blocks of
+ * sizes to out, which must have room for container_header_size bytes.
+ * Returns the number of bytes written.
+ */
+size_t container_write(unsigned char *out, const huffman_table *model, uint64_t n,
+                       const block_size *sizes, size_t count, bool store_model);
+
+/*
+ * Reads the header of the size bytes of an encoded file in data into
+ * c, and checks that the block table adds up to the characters and the
+ * bytes of the file. Files without a stored model table must have been
+ * encoded with model. Returns 0 on success and -1 if the header is
+ * invalid or the model differs.
+ */
+int container_read(container *c, const unsigned char *data, size_t size,
+                   const huffman_table *model);
+
+/*
+ * Returns the characters and bytes of block i of the block table.
+ */
+block_size container_block(const container *c, size_t i);
+
+#endif
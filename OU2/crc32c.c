@@ -0,0 +1,103 @@
+#include "crc32c.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86
+#endif
+
+#define CRC32C_POLY 0x82f63b78
+
+static uint32_t crc32c_table(uint32_t crc, const unsigned char *p, size_t n);
+static void init_tables(void);
+static void detect_hardware(void);
+
+static uint32_t tables[8][256];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static int hardware;
+static pthread_once_t hardware_once = PTHREAD_ONCE_INIT;
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *p, size_t n) {
+    for (; n > 0 && ((uintptr_t)p & 7) != 0; n--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for (; n >= 4; n -= 4, p += 4) {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; n > 0; n--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t n) {
+    crc = ~crc;
+#ifdef CRC32C_X86
+    if (crc32c_hardware()) {
+        return ~crc32c_sse42(crc, data, n);
+    }
+#endif
+    return ~crc32c_table(crc, data, n);
+}
+
+int crc32c_hardware(void) {
+    pthread_once(&hardware_once, detect_hardware);
+    return hardware;
+}
+
+static void detect_hardware(void) {
+    hardware = 0;
+#ifdef CRC32C_X86
+    __builtin_cpu_init();
+    hardware = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+#endif
+}
+
+/* Slicing-by-8: tables[k][b] is the CRC of byte b followed by k zero
+   bytes, so eight bytes can be combined with independent lookups. The
+   words are read as little-endian regardless of the host. */
+static uint32_t crc32c_table(uint32_t crc, const unsigned char *p, size_t n) {
+    pthread_once(&tables_once, init_tables);
+
+    for (; n >= 8; n -= 8, p += 8) {
+        uint32_t low = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                              (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        crc = tables[7][low & 0xff] ^ tables[6][low >> 8 & 0xff] ^
+              tables[5][low >> 16 & 0xff] ^ tables[4][low >> 24] ^
+              tables[3][p[4]] ^ tables[2][p[5]] ^ tables[1][p[6]] ^ tables[0][p[7]];
+    }
+    for (; n > 0; n--) {
+        crc = tables[0][(crc ^ *p++) & 0xff] ^ crc >> 8;
+    }
+    return crc;
+}
+
+static void init_tables(void) {
+    for (int i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = crc & 1 ? crc >> 1 ^ CRC32C_POLY : crc >> 1;
+        }
+        tables[0][i] = crc;
+    }
+    for (int i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            tables[k][i] = tables[0][tables[k - 1][i] & 0xff] ^ tables[k - 1][i] >> 8;
+        }
+    }
+}
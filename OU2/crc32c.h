@@ -0,0 +1,43 @@
+#ifndef CRC32C
+#define CRC32C
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CRC-32C (Castagnoli), as used by iSCSI and ext4.
+ *
+ * Uses the crc32 instruction of SSE4.2 when the processor has it, and
+ * otherwise a table-driven version that handles 8 bytes per step.
+ */
+
+/*
+ * Returns the CRC of the n bytes in data, continued from crc. Start
+ * with crc = 0.
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t n);
+
+/*
+ * Returns true if crc32c uses the hardware instruction.
+ */
+int crc32c_hardware(void);
+
+/* Decoders fold their output into a CRC in steps of this many bytes,
+   which are still in the L1 cache when the CRC reads them */
+#define CRC32C_STEP (8 * 1024)
+
+/*
+ * Folds the bytes of out from *done up to end into *crc once there are
+ * CRC32C_STEP of them, or any number of them if last is set, and moves
+ * *done to end. Does nothing if crc is NULL.
+ */
+static inline void crc32c_step(uint32_t *crc, const unsigned char *out, size_t *done,
+                               size_t end, bool last) {
+    if (crc != NULL && (end - *done >= CRC32C_STEP || last)) {
+        *crc = crc32c(*crc, out + *done, end - *done);
+        *done = end;
+    }
+}
+
+#endif
@@ -0,0 +1,72 @@
+#define _GNU_SOURCE
+
+#include "file_map.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+unsigned char *file_map_output(FILE *fp, size_t size) {
+    int fd = fileno(fp);
+    struct stat st;
+
+    if (size == 0 || fd < 0 || fflush(fp) != 0 || fstat(fd, &st) != 0 ||
+        !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+
+    /* fallocate reserves the blocks, so running out of space shows up
+       here and not as a SIGBUS while writing to the mapping */
+    if (fallocate(fd, 0, 0, size) != 0) {
+        if ((errno != EOPNOTSUPP && errno != ENOSYS) || ftruncate(fd, size) != 0) {
+            return NULL;
+        }
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ftruncate(fd, 0);
+        return NULL;
+    }
+    return map;
+}
+
+int file_unmap_output(FILE *fp, unsigned char *map, size_t size, int failed) {
+    int err = munmap(map, size);
+    if (failed && ftruncate(fileno(fp), 0) != 0) {
+        err = -1;
+    }
+    return err;
+}
+
+const unsigned char *file_map_input(FILE *fp, size_t *size) {
+    int fd = fileno(fp);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    *size = st.st_size;
+    return map;
+}
+
+void file_unmap_input(const unsigned char *map, size_t size) {
+    munmap((void *)map, size);
+}
+
+bool file_is_regular(FILE *fp) {
+    struct stat st;
+    return fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+int file_discard_output(FILE *fp) {
+    /* Flushed first, so that nothing is written after the truncation */
+    fflush(fp);
+    return file_is_regular(fp) ? ftruncate(fileno(fp), 0) : 0;
+}
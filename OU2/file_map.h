@@ -0,0 +1,51 @@
+#ifndef FILE_MAP
+#define FILE_MAP
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Output files written through a shared mapping, so that the result is
+ * coded straight into the page cache instead of going through a buffer
+ * and stdio. The file must be open for reading and writing, like "w+b".
+ */
+
+/*
+ * Allocates size bytes for the file and maps them for writing. Returns
+ * NULL if the file can not be mapped, for example a pipe or an empty
+ * result, and the caller should then write it with fwrite.
+ */
+unsigned char *file_map_output(FILE *fp, size_t size);
+
+/*
+ * Unmaps an output mapped with file_map_output. If failed is set the
+ * file is truncated to 0 bytes, as if nothing was written. Returns 0 on
+ * success.
+ */
+int file_unmap_output(FILE *fp, unsigned char *map, size_t size, int failed);
+
+/*
+ * Maps the whole of an input file for reading, so that only the pages
+ * that are used are read from the disk. Stores its size in *size.
+ * Returns NULL if the file can not be mapped, for example a pipe or an
+ * empty file, and the caller should then read it with fread.
+ */
+const unsigned char *file_map_input(FILE *fp, size_t *size);
+
+void file_unmap_input(const unsigned char *map, size_t size);
+
+/*
+ * Returns whether fp is a regular file, which can be mapped and read
+ * at any position.
+ */
+bool file_is_regular(FILE *fp);
+
+/*
+ * Truncates a regular output file that was written with fwrite to 0
+ * bytes after a failure, as file_unmap_output does. Pipes are left
+ * alone. Returns 0 on success.
+ */
+int file_discard_output(FILE *fp);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Generates the preset models of preset.c. Run by make.
+ *
+ * USAGE:
+ * gen_presets NAME=FILE...
+ *
+ * Builds a model from the files of each NAME, in the same way as a
+ * FILE0 is used, and prints them to stdout as C source with the tables
+ * as static const arrays. Arguments with the same NAME must follow each
+ * other.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calc_frequency.h"
+#include "huffman_trie.h"
+#include "huffman_table.h"
+
+static huffman_table *build_preset(const char *files[], int count);
+static void print_table(const char *name, const huffman_table *table);
+static void print_array(const char *field, const void *data, int n, int size);
+
+int main(int argc, const char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "USAGE:\n%s NAME=FILE...\n", argv[0]);
+        return 1;
+    }
+
+    const char *names[argc];
+    int presets = 0;
+    printf("/* Generated by gen_presets, do not edit */\n\n");
+
+    for (int i = 1; i < argc;) {
+        const char *eq = strchr(argv[i], '=');
+        if (eq == NULL) {
+            fprintf(stderr, "Expected NAME=FILE: %s\n", argv[i]);
+            return 1;
+        }
+        size_t length = eq - argv[i];
+
+        const char *files[argc];
+        int count = 0;
+        for (; i < argc && strncmp(argv[i], argv[i - count], length + 1) == 0; i++) {
+            files[count++] = strchr(argv[i], '=') + 1;
+        }
+
+        huffman_table *table = build_preset(files, count);
+        if (table == NULL) {
+            return 1;
+        }
+        char *name = strndup(argv[i - count], length);
+        print_table(name, table);
+        names[presets++] = name;
+        free(table);
+    }
+
+    printf("static const preset presets[] = {\n");
+    for (int i = 0; i < presets; i++) {
+        printf("    {\"%s\", &preset_%s},\n", names[i], names[i]);
+        free((char *)names[i]);
+    }
+    printf("};\n");
+
+    return 0;
+}
+
+/* Counts all the files together and builds the table as load_table
+   does for a FILE0 */
+static huffman_table *build_preset(const char *files[], int count) {
+    charFrequency *frequency = NULL;
+
+    for (int i = 0; i < count; i++) {
+        FILE *fp = fopen(files[i], "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "Could not open the file: %s\n", files[i]);
+            free(frequency);
+            return NULL;
+        }
+        charFrequency *file_frequency = calc_frequency(fp);
+        fclose(fp);
+
+        if (frequency == NULL) {
+            frequency = file_frequency;
+            continue;
+        }
+        for (int c = 0; c < 256; c++) {
+            frequency[c].frequency += file_frequency[c].frequency;
+        }
+        free(file_frequency);
+    }
+
+    trie_pq *pq = process_frequency(frequency);
+    trie_node *root = build_huffman_trie(pq);
+    huffman_table *table = build_huffman_table(root);
+
+    free_huffman_trie(root);
+    trie_pq_kill(pq);
+    free(frequency);
+
+    return table;
+}
+
+static void print_table(const char *name, const huffman_table *table) {
+    printf("static const huffman_table preset_%s = {\n", name);
+    print_array("length", table->length, HUFF_SYMBOLS, sizeof(table->length[0]));
+    print_array("code", table->code, HUFF_SYMBOLS, sizeof(table->code[0]));
+    printf("    .max_length = %d,\n", table->max_length);
+    print_array("lookup", table->lookup, 1 << HUFF_LOOKUP_BITS, sizeof(table->lookup[0]));
+    print_array("first_code", table->first_code, HUFF_MAX_CODE_LEN + 1,
+                sizeof(table->first_code[0]));
+    print_array("first_index", table->first_index, HUFF_MAX_CODE_LEN + 1,
+                sizeof(table->first_index[0]));
+    print_array("count", table->count, HUFF_MAX_CODE_LEN + 1, sizeof(table->count[0]));
+    print_array("sorted", table->sorted, HUFF_SYMBOLS, sizeof(table->sorted[0]));
+    printf("};\n\n");
+}
+
+/* Prints n unsigned integers of size bytes each, 12 to a line */
+static void print_array(const char *field, const void *data, int n, int size) {
+    printf("    .%s = {", field);
+    for (int i = 0; i < n; i++) {
+        unsigned long value;
+        if (size == 1) {
+            value = ((const unsigned char *)data)[i];
+        } else if (size == 2) {
+            value = ((const uint16_t *)data)[i];
+        } else {
+            value = ((const uint32_t *)data)[i];
+        }
+        printf("%s%lu,", i % 12 == 0 ? "\n        " : " ", value);
+    }
+    printf("\n    },\n");
+}
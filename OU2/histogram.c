@@ -0,0 +1,94 @@
+#include "histogram.h"
+#include "byte_order.h"
+
+bool histogram_is_histogram(FILE *fp) {
+    char magic[4];
+    size_t n = fread(magic, 1, sizeof(magic), fp);
+    rewind(fp);
+
+    return n == sizeof(magic) && memcmp(magic, HISTOGRAM_MAGIC, 4) == 0;
+}
+
+charFrequency *histogram_load(FILE *fp) {
+    unsigned char data[HISTOGRAM_FILE_SIZE];
+
+    if (fread(data, 1, sizeof(data), fp) != sizeof(data) ||
+        memcmp(data, HISTOGRAM_MAGIC, 4) != 0 ||
+        load_le32(data + 4) != HISTOGRAM_VERSION) {
+        return NULL;
+    }
+
+    charFrequency *frequency = malloc(256 * sizeof(charFrequency));
+    for (int i = 0; i < 256; i++) {
+        frequency[i].character = i;
+        frequency[i].frequency = (long long)load_le64(data + 16 + i * 8);
+    }
+
+    return frequency;
+}
+
+int histogram_save(FILE *fp, const charFrequency *frequency) {
+    unsigned char data[HISTOGRAM_FILE_SIZE];
+    uint64_t total = 0;
+
+    memcpy(data, HISTOGRAM_MAGIC, 4);
+    store_le32(data + 4, HISTOGRAM_VERSION);
+    for (int i = 0; i < 256; i++) {
+        store_le64(data + 16 + i * 8, (uint64_t)frequency[i].frequency);
+        total += frequency[i].frequency;
+    }
+    store_le64(data + 8, total);
+
+    return fwrite(data, 1, sizeof(data), fp) == sizeof(data) ? 0 : -1;
+}
+
+int histogram_save_path(const char *path, const charFrequency *frequency) {
+    size_t len = strlen(path);
+    char *tmp_path = malloc(len + 5);
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".tmp", 5);
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        free(tmp_path);
+        return -1;
+    }
+
+    int err = histogram_save(fp, frequency);
+    if (fclose(fp) != 0) {
+        err = -1;
+    }
+    if (err == 0) {
+        err = rename(tmp_path, path);
+    } else {
+        remove(tmp_path);
+    }
+
+    free(tmp_path);
+    return err;
+}
+
+void histogram_merge(charFrequency *dst, const charFrequency *src) {
+    for (int i = 0; i < 256; i++) {
+        dst[i].frequency += src[i].frequency;
+    }
+}
+
+void histogram_subtract(charFrequency *dst, const charFrequency *src) {
+    for (int i = 0; i < 256; i++) {
+        if (dst[i].frequency > src[i].frequency) {
+            dst[i].frequency -= src[i].frequency;
+        } else {
+            dst[i].frequency = 0;
+        }
+    }
+}
+
+void histogram_decay(charFrequency *frequency, double factor) {
+    for (int i = 0; i < 256; i++) {
+        if (frequency[i].frequency > 0) {
+            long long decayed = (long long)(frequency[i].frequency * factor + 0.5);
+            frequency[i].frequency = decayed > 0 ? decayed : 1;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef HISTOGRAM
+#define HISTOGRAM
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "calc_frequency.h"
+
+/*
+ * Persisted frequency tables (histograms).
+ *
+ * A histogram file stores the 256 counts of a charFrequency table as
+ * 64-bit little-endian integers after a small header:
+ *
+ *   offset  size  field
+ *   0       4     magic "HHST"
+ *   4       4     version (1)
+ *   8       8     sum of all counts
+ *   16      2048  counts for byte 0..255
+ *
+ * Histogram files can be given as FILE0 instead of a training file.
+ */
+
+#define HISTOGRAM_MAGIC "HHST"
+#define HISTOGRAM_VERSION 1
+#define HISTOGRAM_FILE_SIZE (16 + 256 * 8)
+
+/*
+ * Checks whether the file starts with a histogram header. The file
+ * position is reset to the start of the file.
+ */
+bool histogram_is_histogram(FILE *fp);
+
+/*
+ * Reads a histogram from the current position of fp. Returns NULL if
+ * the file is not a valid histogram.
+ */
+charFrequency *histogram_load(FILE *fp);
+
+/*
+ * Writes the frequency table as a histogram. Returns 0 on success.
+ */
+int histogram_save(FILE *fp, const charFrequency *frequency);
+
+/*
+ * Writes the histogram to a temporary file next to path and renames
+ * it over path, so readers never see a half written histogram.
+ * Returns 0 on success.
+ */
+int histogram_save_path(const char *path, const charFrequency *frequency);
+
+/* Adds the counts in src to dst. */
+void histogram_merge(charFrequency *dst, const charFrequency *src);
+
+/* Subtracts the counts in src from dst. Counts do not go below 0. */
+void histogram_subtract(charFrequency *dst, const charFrequency *src);
+
+/*
+ * Multiplies all counts by factor (0 < factor <= 1), so that older
+ * data weighs less than data merged later. Symbols that have been
+ * seen keep a count of at least 1.
+ */
+void histogram_decay(charFrequency *frequency, double factor);
+
+#endif
@@ -1,38 +1,80 @@
 #include "huffman.h"
+#include "server.h"
+#include "batch.h"
+#include "preset.h"
+#include "train.h"
+#include "huffman_search.h"
+#include "file_map.h"
 
 int main(int argc, const char *argv[]) {
     FILE *frequency_file_p;
     FILE *process_file_p;
     FILE *out_file_p;
+    prog_options options;
+    const char *args[argc + 1];
 
-    int wrong_prog_params = check_prog_params(argc, argv, &frequency_file_p, &process_file_p, &out_file_p);
+    argc = parse_flags(argc, argv, &options, args);
+    if (argc < 0) {
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(args[1], "-serve") == 0) {
+        return serve(args[2], args + 3, argc - 3, &options) == 0 ? 0 : 1;
+    }
+    if (options.preset != NULL) {
+        return code_with_preset(argc, args, &options);
+    }
+    if (argc == 5 && strcmp(args[1], "-batch") == 0) {
+        return batch(args[2], args[3], args[4], &options);
+    }
+    if (argc >= 2 && strcmp(args[1], "-train") == 0) {
+        return train_corpus(argc, args, &options);
+    }
+    if (argc >= 2 && strcmp(args[1], "-train-incremental") == 0) {
+        return train_incremental(argc, args, &options);
+    }
+    if (argc == 5 && strcmp(args[1], "-search") == 0) {
+        return search_file(args[2], args[3], args[4], &options);
+    }
+    if (argc >= 2 && (strcmp(args[1], "-hist-merge") == 0 ||
+                      strcmp(args[1], "-hist-subtract") == 0)) {
+        return combine_histograms(argc, args);
+    }
+
+    int wrong_prog_params = check_prog_params(argc, args, &frequency_file_p, &process_file_p, &out_file_p);
 
     if (wrong_prog_params) {
         return 0;
     }
     
-    charFrequency *frequency = calc_frequency(frequency_file_p);
-    pqueue *pq = process_frequency(frequency);
-
-   
-    while(pqueue_is_empty(pq) == 0) {
-        trie_node *test = pqueue_inspect_first(pq);
-        printf("%d %c\n", test->weight, test->key);
-        pqueue_delete_first(pq);
-    }
-    //pqueue_print(pq, print_func);
-   // huffTree *tree = fillhuffTree(pq);
-
-    // huffmanTable *table = build_huffman_table(root);
-
-   /* if (strcmp(argv[1], "-encode") == 0) {
-        encode_file(process_file_p, out_file_p, table);
-    } else if (strcmp(argv[1], "-decode") == 0) {
-        decode_file(process_file_p, out_file_p, table);
-    }*/
-    //test
-  
-    return 0;
+    huffman_table *table = load_table(frequency_file_p, &options);
+    if (table == NULL) {
+        fprintf(stderr, "Could not read the file: %s\n", args[2]);
+        fclose(frequency_file_p);
+        fclose(process_file_p);
+        fclose(out_file_p);
+        return 1;
+    }
+
+    int err;
+    if (strcmp(args[1], "-encode") == 0) {
+        err = encode_file(process_file_p, out_file_p, table, &options.blocks);
+    } else {
+        err = decode_file(process_file_p, out_file_p, table, &options.blocks);
+    }
+    if (err) {
+        fprintf(stderr, "Could not %s the file: %s\n", args[1] + 1, args[3]);
+    }
+
+    free(table);
+    fclose(frequency_file_p);
+    fclose(process_file_p);
+    if (fclose(out_file_p) != 0) {
+        fprintf(stderr, "Could not write the file: %s\n", args[4]);
+        err = -1;
+    }
+
+    return err ? 1 : 0;
 }
 
 int check_prog_params(int argc, const char *argv[],
@@ -54,7 +96,9 @@ int check_prog_params(int argc, const char *argv[],
                 return -1;
             }
 
-            *out_file_p = fopen(argv[4], "wb");
+            /* Also open for reading, so the result can be written
+               through a mapping */
+            *out_file_p = fopen(argv[4], "w+b");
             if (*out_file_p == NULL){
                 fprintf(stderr, "Could not open the file: %s\n", argv[4]);
                 fclose(*frequency_file_p);
@@ -71,7 +115,7 @@ int check_prog_params(int argc, const char *argv[],
                 
                 return -1;
             }
-            *out_file_p = fopen(argv[4], "w");
+            *out_file_p = fopen(argv[4], "w+b");
             if (*out_file_p == NULL){
                 fprintf(stderr, "Could not open the file: %s\n", argv[4]);
                 fclose(*frequency_file_p);
@@ -79,14 +123,437 @@ int check_prog_params(int argc, const char *argv[],
                 
                 return -1;
             }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[1]);
+            fclose(*frequency_file_p);
+
+            return -1;
         }
     } else {
-        printf("USAGE:\n%s [OPTION] [FILE0] [FILE1] [FILE2]\n", argv[0]);
+        printf("USAGE:\n%s [FLAGS] [OPTION] [FILE0] [FILE1] [FILE2]\n", argv[0]);
         printf("Options:\n");
         printf("-encode encodes FILE1 according to frequence analysis done on FILE0. Stores the result in FILE2\n");
         printf("-decode decodes FILE1 according to frequence analysis done on FILE0. Stores the result in FILE2\n");
+        printf("FILE0 can also be a histogram file created with the options below:\n");
+        printf("-train [-by-extension|-by-content] HIST SOURCE... stores the frequencies of all files of\n");
+        printf("  the SOURCEs, files, directories or @LIST files, in HIST, and with -by-extension or\n");
+        printf("  -by-content also those of each kind of file in HIST.KIND\n");
+        printf("-train-incremental HIST FILE... adds the frequencies of the FILEs to the histogram HIST\n");
+        printf("-hist-merge OUT HIST... stores the sum of the HISTs in OUT\n");
+        printf("-hist-subtract OUT HIST1 HIST2 stores HIST1 minus HIST2 in OUT\n");
+        printf("-batch -encode|-decode FILE0 LIST codes the files named in LIST, one per line, with\n");
+        printf("  the model of FILE0 into FILE.huf or back, or into the name after a tab on the line\n");
+        printf("-search PATTERN FILE0 FILE1 prints OFFSET:PATTERN for every occurrence of PATTERN in\n");
+        printf("  the decoded FILE1, like grep -b -o, mostly without decoding it, and exits with 0 if\n");
+        printf("  there is one, 1 if not and 2 on errors\n");
+        printf("-serve SOCK [FILE0...] serves encode and decode requests on the Unix socket SOCK,\n");
+        printf("  with the models of the FILE0s loaded in advance and only those unless\n");
+        printf("  -load-on-demand is given (see huffman_client)\n");
+        printf("Flags:\n");
+        printf("-preset NAME uses the built-in model NAME instead of FILE0, which is then left out\n");
+        printf("  (presets: ");
+        preset_print_names(stdout);
+        printf(")\n");
+        printf("-sample BUDGET only reads BUDGET bytes (K, M and G suffixes allowed) of FILE0, spread over the file\n");
+        printf("-checksum adds a CRC-32C to every block with -encode, which -decode verifies\n");
+        printf("-rle run-length codes blocks with -encode where that makes them smaller\n");
+        printf("-bwt applies the Burrows-Wheeler transform to blocks of up to 8M with -encode\n");
+        printf("-ans codes blocks with table-based ANS instead of Huffman codes with -encode where that is smaller\n");
+        printf("-store-model stores the model table in the file with -encode, so -decode does not need FILE0\n");
+        printf("-legacy decodes FILE1 in the format from before the container header with -decode,\n");
+        printf("  on all threads even though it has no blocks\n");
+        printf("-threads N codes blocks on N threads (default one per processor)\n");
+        printf("-no-cache does not use the model cache\n");
+        printf("-cache-dir DIR stores cached models in DIR (default $HUFFMAN_CACHE_DIR or ~/.cache/huffman)\n");
+        printf("-cache-max-size SIZE limits the total size of the model cache (default $HUFFMAN_CACHE_MAX_SIZE or 16M)\n");
+        printf("-cache-max-entries N limits the number of cached models (default $HUFFMAN_CACHE_MAX_ENTRIES or 256)\n");
+        printf("-load-on-demand lets -serve load any FILE0 a client names on first use, not only\n");
+        printf("  the FILE0s given to it\n");
+        printf("-decay FACTOR scales the old counts by FACTOR before -train-incremental adds the new ones\n");
         
         return -1;
     }
     return 0;
-}
\ No newline at end of file
+}
+
+int parse_flags(int argc, const char *argv[], prog_options *options, const char *args[]) {
+    int nargs = 0;
+
+    options->preset = NULL;
+    options->sample_budget = 0;
+    options->decay = 1.0;
+    options->blocks.checksum = false;
+    options->blocks.rle = false;
+    options->blocks.bwt = false;
+    options->blocks.ans = false;
+    options->blocks.threads = 0;
+    options->blocks.store_model = false;
+    options->blocks.legacy = false;
+    init_cache_options(&options->cache);
+    options->load_on_demand = false;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-preset") == 0 && i + 1 < argc) {
+            options->preset = argv[++i];
+        } else if (strcmp(argv[i], "-sample") == 0) {
+            if (i + 1 >= argc || (options->sample_budget = parse_size(argv[i + 1])) <= 0) {
+                fprintf(stderr, "Invalid sample budget\n");
+                return -1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-decay") == 0) {
+            if (i + 1 >= argc || (options->decay = atof(argv[i + 1])) <= 0.0 ||
+                options->decay > 1.0) {
+                fprintf(stderr, "The decay factor must be in (0, 1]\n");
+                return -1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-checksum") == 0) {
+            options->blocks.checksum = true;
+        } else if (strcmp(argv[i], "-rle") == 0) {
+            options->blocks.rle = true;
+        } else if (strcmp(argv[i], "-bwt") == 0) {
+            options->blocks.bwt = true;
+        } else if (strcmp(argv[i], "-ans") == 0) {
+            options->blocks.ans = true;
+        } else if (strcmp(argv[i], "-legacy") == 0) {
+            options->blocks.legacy = true;
+        } else if (strcmp(argv[i], "-store-model") == 0) {
+            options->blocks.store_model = true;
+        } else if (strcmp(argv[i], "-load-on-demand") == 0) {
+            options->load_on_demand = true;
+        } else if (strcmp(argv[i], "-threads") == 0) {
+            if (i + 1 >= argc || (options->blocks.threads = atoi(argv[i + 1])) < 0) {
+                fprintf(stderr, "Invalid number of threads\n");
+                return -1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-no-cache") == 0) {
+            options->cache.dir = NULL;
+        } else if (strcmp(argv[i], "-cache-dir") == 0 && i + 1 < argc) {
+            options->cache.dir = argv[++i];
+        } else if (strcmp(argv[i], "-cache-max-size") == 0) {
+            if (i + 1 >= argc || (options->cache.max_bytes = parse_size(argv[i + 1])) < 0) {
+                fprintf(stderr, "Invalid cache size\n");
+                return -1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-cache-max-entries") == 0) {
+            if (i + 1 >= argc || (options->cache.max_entries = atoi(argv[i + 1])) < 0) {
+                fprintf(stderr, "Invalid number of cache entries\n");
+                return -1;
+            }
+            i++;
+        } else {
+            args[nargs++] = argv[i];
+        }
+    }
+    args[nargs] = NULL;
+
+    return nargs;
+}
+
+/* Encodes or decodes FILE1 into FILE2 with a built-in model, which
+   needs no FILE0 and no trie */
+int code_with_preset(int argc, const char *argv[], const prog_options *options) {
+    const huffman_table *table = preset_find(options->preset);
+    if (table == NULL) {
+        fprintf(stderr, "Unknown preset: %s (presets: ", options->preset);
+        preset_print_names(stderr);
+        fprintf(stderr, ")\n");
+        return 1;
+    }
+    if (argc != 4 || (strcmp(argv[1], "-encode") != 0 && strcmp(argv[1], "-decode") != 0)) {
+        fprintf(stderr, "USAGE: %s -preset NAME -encode|-decode FILE1 FILE2\n", argv[0]);
+        return 1;
+    }
+
+    FILE *process_file_p = fopen(argv[2], "rb");
+    if (process_file_p == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", argv[2]);
+        return 1;
+    }
+    FILE *out_file_p = fopen(argv[3], "w+b");
+    if (out_file_p == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", argv[3]);
+        fclose(process_file_p);
+        return 1;
+    }
+
+    int err;
+    if (strcmp(argv[1], "-encode") == 0) {
+        err = encode_file(process_file_p, out_file_p, table, &options->blocks);
+    } else {
+        err = decode_file(process_file_p, out_file_p, table, &options->blocks);
+    }
+    if (err) {
+        fprintf(stderr, "Could not %s the file: %s\n", argv[1] + 1, argv[2]);
+    }
+
+    fclose(process_file_p);
+    if (fclose(out_file_p) != 0) {
+        fprintf(stderr, "Could not write the file: %s\n", argv[3]);
+        err = -1;
+    }
+
+    return err ? 1 : 0;
+}
+
+void init_cache_options(model_cache *cache) {
+    static char default_dir[4096];
+    const char *env;
+
+    cache->dir = NULL;
+    cache->max_bytes = 16 * 1024 * 1024;
+    cache->max_entries = 256;
+
+    if ((env = getenv("HUFFMAN_CACHE_DIR")) != NULL) {
+        cache->dir = env[0] != '\0' ? env : NULL;
+    } else if ((env = getenv("XDG_CACHE_HOME")) != NULL && env[0] != '\0') {
+        snprintf(default_dir, sizeof(default_dir), "%s/huffman", env);
+        cache->dir = default_dir;
+    } else if ((env = getenv("HOME")) != NULL && env[0] != '\0') {
+        snprintf(default_dir, sizeof(default_dir), "%s/.cache/huffman", env);
+        cache->dir = default_dir;
+    }
+
+    if ((env = getenv("HUFFMAN_CACHE_MAX_SIZE")) != NULL && parse_size(env) >= 0) {
+        cache->max_bytes = parse_size(env);
+    }
+    if ((env = getenv("HUFFMAN_CACHE_MAX_ENTRIES")) != NULL && atoi(env) >= 0) {
+        cache->max_entries = atoi(env);
+    }
+}
+
+huffman_table *load_table(FILE *frequency_file_p, const prog_options *options) {
+    uint64_t key = 0;
+    if (options->cache.dir != NULL) {
+        key = model_cache_key(frequency_file_p, options->sample_budget);
+        huffman_table *table = model_cache_load(&options->cache, key);
+        if (table != NULL) {
+            return table;
+        }
+    }
+
+    /* A truncated or invalid histogram has no frequencies */
+    charFrequency *frequency = load_frequency(frequency_file_p, options);
+    if (frequency == NULL) {
+        return NULL;
+    }
+    trie_pq *pq = process_frequency(frequency);
+    trie_node *root = build_huffman_trie(pq);
+    huffman_table *table = build_huffman_table(root);
+
+    free_huffman_trie(root);
+    trie_pq_kill(pq);
+    free(frequency);
+
+    if (options->cache.dir != NULL) {
+        model_cache_store(&options->cache, key, table);
+    }
+
+    return table;
+}
+
+charFrequency *load_frequency(FILE *frequency_file_p, const prog_options *options) {
+    if (histogram_is_histogram(frequency_file_p)) {
+        return histogram_load(frequency_file_p);
+    }
+
+    if (options->sample_budget > 0) {
+        sample_stats stats;
+        charFrequency *frequency = calc_frequency_sample(frequency_file_p,
+                                                         options->sample_budget, &stats);
+        fprintf(stderr, "Sampled %lld of %lld bytes in %d blocks\n",
+                stats.bytes_read, stats.file_size, stats.blocks);
+        fprintf(stderr, "Estimated KL divergence from a full scan: %.6f bits/byte\n",
+                stats.est_kl_bits);
+        return frequency;
+    }
+
+    return calc_frequency(frequency_file_p);
+}
+
+int train_corpus(int argc, const char *argv[], const prog_options *options) {
+    int categories = TRAIN_WHOLE;
+    int first = 2;
+    if (argc > 2 && strcmp(argv[2], "-by-extension") == 0) {
+        categories = TRAIN_BY_EXTENSION;
+        first++;
+    } else if (argc > 2 && strcmp(argv[2], "-by-content") == 0) {
+        categories = TRAIN_BY_CONTENT;
+        first++;
+    }
+    if (argc < first + 2) {
+        fprintf(stderr, "USAGE: %s -train [-by-extension|-by-content] HIST SOURCE...\n", argv[0]);
+        return 1;
+    }
+
+    return train(argv[first], argv + first + 1, argc - first - 1, categories, options);
+}
+
+int train_incremental(int argc, const char *argv[], const prog_options *options) {
+    if (argc < 3) {
+        fprintf(stderr, "USAGE: %s -train-incremental HIST FILE...\n", argv[0]);
+        return 1;
+    }
+
+    charFrequency *histogram = NULL;
+    FILE *hist_file_p = fopen(argv[2], "rb");
+    if (hist_file_p != NULL) {
+        histogram = histogram_load(hist_file_p);
+        fclose(hist_file_p);
+        if (histogram == NULL) {
+            fprintf(stderr, "Not a histogram file: %s\n", argv[2]);
+            return 1;
+        }
+        histogram_decay(histogram, options->decay);
+    } else {
+        histogram = calloc(256, sizeof(charFrequency));
+        for (int i = 0; i < 256; i++) {
+            histogram[i].character = i;
+        }
+    }
+
+    for (int i = 3; i < argc; i++) {
+        FILE *file_p = fopen(argv[i], "rb");
+        if (file_p == NULL) {
+            fprintf(stderr, "Could not open the file: %s\n", argv[i]);
+            free(histogram);
+            return 1;
+        }
+        charFrequency *frequency = load_frequency(file_p, options);
+        fclose(file_p);
+        if (frequency == NULL) {
+            fprintf(stderr, "Could not read the file: %s\n", argv[i]);
+            free(histogram);
+            return 1;
+        }
+        histogram_merge(histogram, frequency);
+        free(frequency);
+    }
+
+    int err = histogram_save_path(argv[2], histogram);
+    if (err) {
+        fprintf(stderr, "Could not write the histogram: %s\n", argv[2]);
+    }
+    free(histogram);
+
+    return err ? 1 : 0;
+}
+
+int combine_histograms(int argc, const char *argv[]) {
+    bool subtract = strcmp(argv[1], "-hist-subtract") == 0;
+    if (argc < 4 || (subtract && argc != 5)) {
+        fprintf(stderr, "USAGE: %s %s OUT HIST...\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    charFrequency *result = NULL;
+    for (int i = 3; i < argc; i++) {
+        FILE *hist_file_p = fopen(argv[i], "rb");
+        charFrequency *histogram = hist_file_p ? histogram_load(hist_file_p) : NULL;
+        if (hist_file_p != NULL) {
+            fclose(hist_file_p);
+        }
+        if (histogram == NULL) {
+            fprintf(stderr, "Could not read the histogram: %s\n", argv[i]);
+            free(result);
+            return 1;
+        }
+
+        if (result == NULL) {
+            result = histogram;
+            continue;
+        }
+        if (subtract) {
+            histogram_subtract(result, histogram);
+        } else {
+            histogram_merge(result, histogram);
+        }
+        free(histogram);
+    }
+
+    int err = histogram_save_path(argv[2], result);
+    if (err) {
+        fprintf(stderr, "Could not write the histogram: %s\n", argv[2]);
+    }
+    free(result);
+
+    return err ? 1 : 0;
+}
+
+long long parse_size(const char *str) {
+    char *end;
+    long long size = strtoll(str, &end, 10);
+
+    switch (*end) {
+    case 'G': case 'g':
+        size *= 1024;
+        /* fall through */
+    case 'M': case 'm':
+        size *= 1024;
+        /* fall through */
+    case 'K': case 'k':
+        size *= 1024;
+        end++;
+        break;
+    }
+
+    return (*end == '\0' && end != str) ? size : -1;
+}
+
+static void print_match(void *context, uint64_t offset) {
+    const char *pattern = context;
+    printf("%llu:%s\n", (unsigned long long)offset, pattern);
+}
+
+/* Searches the encoded FILE1 for PATTERN, with the exit codes of grep */
+int search_file(const char *pattern, const char *frequency_path, const char *path,
+                const prog_options *options) {
+    if (pattern[0] == '\0') {
+        fprintf(stderr, "The pattern is empty\n");
+        return 2;
+    }
+    FILE *frequency_file_p = fopen(frequency_path, "r");
+    if (frequency_file_p == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", frequency_path);
+        return 2;
+    }
+    FILE *process_file_p = fopen(path, "rb");
+    if (process_file_p == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", path);
+        fclose(frequency_file_p);
+        return 2;
+    }
+    huffman_table *table = load_table(frequency_file_p, options);
+    fclose(frequency_file_p);
+    if (table == NULL) {
+        fprintf(stderr, "Could not read the file: %s\n", frequency_path);
+        fclose(process_file_p);
+        return 2;
+    }
+
+    /* Mapped, so that the blocks that can not hold the pattern are
+       never read from the disk */
+    size_t size;
+    const unsigned char *map = file_map_input(process_file_p, &size);
+    unsigned char *data = map == NULL ? read_file(process_file_p, &size) : NULL;
+    int64_t found = -1;
+    if (map != NULL || data != NULL) {
+        found = huffman_search(table, map != NULL ? map : data, size,
+                               (const unsigned char *)pattern, strlen(pattern),
+                               options->blocks.threads, print_match, (void *)pattern);
+    }
+    if (found < 0) {
+        fprintf(stderr, "Could not search the file: %s\n", path);
+    }
+
+    if (map != NULL) {
+        file_unmap_input(map, size);
+    }
+    free(data);
+    free(table);
+    fclose(process_file_p);
+    return found > 0 ? 0 : found == 0 ? 1 : 2;
+}
@@ -3,13 +3,37 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "calc_frequency.h"
 #include "pqueue.h"
 #include "huffman_trie.h"
+#include "histogram.h"
+#include "huffman_table.h"
+#include "huffman_codec.h"
+#include "model_cache.h"
 
 
+typedef struct {
+    const char *preset;
+    long long sample_budget;
+    double decay;
+    block_options blocks;
+    model_cache cache;
+    bool load_on_demand;
+} prog_options;
 
 int check_prog_params(int argc, const char *argv[],
                       FILE **frequency_file_p, FILE **process_file_p, FILE **out_file_p);
+int parse_flags(int argc, const char *argv[], prog_options *options, const char *args[]);
+int code_with_preset(int argc, const char *argv[], const prog_options *options);
+void init_cache_options(model_cache *cache);
+huffman_table *load_table(FILE *frequency_file_p, const prog_options *options);
+charFrequency *load_frequency(FILE *frequency_file_p, const prog_options *options);
+int train_corpus(int argc, const char *argv[], const prog_options *options);
+int train_incremental(int argc, const char *argv[], const prog_options *options);
+int combine_histograms(int argc, const char *argv[]);
+int search_file(const char *pattern, const char *frequency_path, const char *path,
+                const prog_options *options);
+long long parse_size(const char *str);
 
 #endif
\ No newline at end of file
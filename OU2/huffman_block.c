@@ -0,0 +1,841 @@
+#include "huffman_block.h"
+#include "huffman_codec.h"
+#include "calc_frequency.h"
+#include "byte_order.h"
+#include "crc32c.h"
+#include "rle.h"
+#include "bwt.h"
+#include "parallel.h"
+#include "tans.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * How a block is coded, decided in order before the blocks are coded
+ * in parallel.
+ *
+ * type    BLOCK_MODEL, BLOCK_TABLE, BLOCK_REUSE, BLOCK_ANS or
+ *         BLOCK_STORED.
+ * table   The table of a BLOCK_TABLE, or the table it reuses.
+ * norm    The normalized counts of a BLOCK_ANS, see tans.h.
+ * ref     The block whose table a BLOCK_REUSE uses.
+ * bits    The bits of the codes, plus the table or the reference.
+ * shared  Later blocks reuse the table, so it must be stored as it is.
+ * incompressible  The sample of the block looked random, so it is
+ *                 stored without trying anything else.
+ */
+typedef struct {
+    int type;
+    huffman_table *table;
+    uint16_t *norm;
+    uint32_t ref;
+    uint64_t bits;
+    bool shared;
+    bool incompressible;
+} block_plan;
+
+struct block_job {
+    const huffman_table *model;
+    const unsigned char *data;
+    const block_options *options;
+    size_t count;
+
+    /* Encoding */
+    block_range *ranges;
+    block_plan *plans;
+    bit_buffer **codes;
+
+    /* Decoding */
+    unsigned char *out;
+    block_info *blocks;
+    int *err;
+};
+
+static size_t split_counted(const unsigned char *data, size_t n, const huffman_table *model,
+                            block_range **blocks, uint64_t **counts);
+static void plan_blocks(block_job *job, const uint64_t *counts);
+static double estimate_bits(const uint64_t *counts, const huffman_table *model);
+static bool covers(const huffman_table *table, const uint64_t *counts);
+static uint64_t code_bits(const uint64_t *counts, const huffman_table *table);
+static bool looks_incompressible(const unsigned char *data, size_t n);
+static size_t start_header(unsigned char *header, int type, const unsigned char *data,
+                           size_t n, const block_options *options);
+static void append_stored(const unsigned char *data, size_t n,
+                          const block_options *options, bit_buffer *b);
+static void append_block(const huffman_table *model, const block_plan *plan,
+                         const unsigned char *data, size_t n,
+                         const block_options *options, bit_buffer *b);
+static void append_ans(const uint16_t *norm, const unsigned char *data, size_t n,
+                       const block_options *options, bit_buffer *b);
+static void append_bwt(const unsigned char *data, size_t n, const block_options *options,
+                       bit_buffer *b);
+static size_t bwt_blocks(size_t n, block_range **blocks);
+static void run_block(void *context, size_t i);
+static void encode_block(block_job *job, size_t i);
+static void decode_block(block_job *job, size_t i);
+
+size_t split_blocks(const unsigned char *data, size_t n, const huffman_table *model,
+                    block_range **blocks) {
+    return split_counted(data, n, model, blocks, NULL);
+}
+
+/*
+ * Does split_blocks, and if counts is not NULL also stores a newly
+ * allocated array of the HUFF_SYMBOLS counts of each block in *counts.
+ */
+static size_t split_counted(const unsigned char *data, size_t n, const huffman_table *model,
+                            block_range **blocks, uint64_t **counts) {
+    size_t capacity = 16;
+    size_t used = 0;
+    *blocks = malloc(capacity * sizeof(block_range));
+    if (counts != NULL) {
+        *counts = malloc(capacity * HUFF_SYMBOLS * sizeof(uint64_t));
+    }
+
+    uint64_t block_counts[HUFF_SYMBOLS] = {0};
+    double block_bits = 0.0;
+    size_t start = 0;
+
+    for (size_t pos = 0; pos < n; pos += BLOCK_CHUNK_SIZE) {
+        size_t len = n - pos < BLOCK_CHUNK_SIZE ? n - pos : BLOCK_CHUNK_SIZE;
+        uint64_t chunk_counts[HUFF_SYMBOLS] = {0};
+        uint64_t joined[HUFF_SYMBOLS];
+
+        count_bytes(data + pos, len, chunk_counts);
+        for (int i = 0; i < HUFF_SYMBOLS; i++) {
+            joined[i] = block_counts[i] + chunk_counts[i];
+        }
+
+        double chunk_bits = estimate_bits(chunk_counts, model);
+        double joined_bits = estimate_bits(joined, model);
+
+        /* Cut if the chunk is cheaper on its own, header included */
+        bool cut = pos > start &&
+                   (block_bits + chunk_bits < joined_bits ||
+                    pos - start + len > BLOCK_MAX_SIZE);
+        if (cut) {
+            if (used == capacity) {
+                capacity *= 2;
+                *blocks = realloc(*blocks, capacity * sizeof(block_range));
+                if (counts != NULL) {
+                    *counts = realloc(*counts, capacity * HUFF_SYMBOLS * sizeof(uint64_t));
+                }
+            }
+            (*blocks)[used].start = start;
+            (*blocks)[used].length = pos - start;
+            if (counts != NULL) {
+                memcpy(*counts + used * HUFF_SYMBOLS, block_counts, sizeof(block_counts));
+            }
+            used++;
+
+            start = pos;
+            memcpy(block_counts, chunk_counts, sizeof(block_counts));
+            block_bits = chunk_bits;
+        } else {
+            memcpy(block_counts, joined, sizeof(block_counts));
+            block_bits = joined_bits;
+        }
+    }
+
+    if (n > start) {
+        if (used == capacity) {
+            *blocks = realloc(*blocks, (capacity + 1) * sizeof(block_range));
+            if (counts != NULL) {
+                *counts = realloc(*counts, (capacity + 1) * HUFF_SYMBOLS * sizeof(uint64_t));
+            }
+        }
+        (*blocks)[used].start = start;
+        (*blocks)[used].length = n - start;
+        if (counts != NULL) {
+            memcpy(*counts + used * HUFF_SYMBOLS, block_counts, sizeof(block_counts));
+        }
+        used++;
+    }
+
+    return used;
+}
+
+void encode_blocks(const huffman_table *model, const unsigned char *data, size_t n,
+                   const block_options *options, bit_buffer *b) {
+    size_t count;
+    block_job *job = encode_blocks_start(model, data, n, options, &count);
+
+    /* The blocks are independent, so they are coded in parallel into
+       buffers of their own and joined in order */
+    block_job_run_all(job, options->threads);
+    encode_blocks_finish(job, b);
+}
+
+int decode_blocks(const huffman_table *model, const unsigned char *data, size_t size,
+                  const unsigned char *sizes, size_t count, unsigned char *out, size_t n,
+                  const block_options *options) {
+    size_t parsed;
+    block_job *job = decode_blocks_start(model, data, size, sizes, count, out, n, &parsed);
+    if (job == NULL) {
+        return -1;
+    }
+
+    block_job_run_all(job, options->threads);
+    return decode_blocks_finish(job);
+}
+
+block_job *encode_blocks_start(const huffman_table *model, const unsigned char *data,
+                               size_t n, const block_options *options, size_t *count) {
+    block_job *job = calloc(1, sizeof(block_job));
+    job->model = model;
+    job->data = data;
+    job->options = options;
+    if (options->bwt) {
+        job->count = bwt_blocks(n, &job->ranges);
+    } else {
+        uint64_t *counts;
+        job->count = split_counted(data, n, model, &job->ranges, &counts);
+        plan_blocks(job, counts);
+        free(counts);
+    }
+    job->codes = malloc((job->count > 0 ? job->count : 1) * sizeof(bit_buffer *));
+
+    *count = job->count;
+    return job;
+}
+
+void encode_blocks_finish(block_job *job, bit_buffer *b) {
+    for (size_t i = 0; i < job->count; i++) {
+        bit_buffer_concat(b, job->codes[i]);
+    }
+    encode_blocks_finish_bytes(job, NULL);
+}
+
+void encode_blocks_finish_bytes(block_job *job, unsigned char *out) {
+    for (size_t i = 0; i < job->count; i++) {
+        /* Every block ends on a byte, so it is copied as it is */
+        if (out != NULL) {
+            int first_bit;
+            const char *bytes = bit_buffer_span(job->codes[i], &first_bit);
+            size_t size = bit_buffer_size(job->codes[i]) / 8;
+            memcpy(out, bytes, size);
+            out += size;
+        }
+        bit_buffer_free(job->codes[i]);
+    }
+
+    if (job->plans != NULL) {
+        for (size_t i = 0; i < job->count; i++) {
+            if (job->plans[i].type == BLOCK_TABLE) {
+                free(job->plans[i].table);
+            }
+            free(job->plans[i].norm);
+        }
+    }
+
+    free(job->plans);
+    free(job->codes);
+    free(job->ranges);
+    free(job);
+}
+
+block_job *decode_blocks_start(const huffman_table *model, const unsigned char *data,
+                               size_t size, const unsigned char *sizes, size_t table_count,
+                               unsigned char *out, size_t n, size_t *count) {
+    block_info *blocks;
+    size_t parsed = parse_blocks(data, size, sizes, table_count, n, &blocks);
+    if (parsed == (size_t)-1) {
+        return NULL;
+    }
+
+    block_job *job = calloc(1, sizeof(block_job));
+    job->model = model;
+    job->data = data;
+    job->out = out;
+    job->blocks = blocks;
+    job->count = parsed;
+    job->err = calloc(parsed > 0 ? parsed : 1, sizeof(int));
+
+    *count = job->count;
+    return job;
+}
+
+int decode_blocks_finish(block_job *job) {
+    int err = 0;
+    for (size_t i = 0; i < job->count; i++) {
+        err |= job->err[i];
+    }
+
+    free_block_tables(job->blocks, job->count);
+    free(job->err);
+    free(job->blocks);
+    free(job);
+    return err;
+}
+
+void block_job_run(block_job *job, size_t i) {
+    if (job->blocks != NULL) {
+        decode_block(job, i);
+    } else {
+        encode_block(job, i);
+    }
+}
+
+void block_job_run_all(block_job *job, int threads) {
+    parallel_for(job->count, threads, run_block, job);
+}
+
+size_t encode_blocks_sizes(const block_job *job, block_size **sizes) {
+    *sizes = malloc((job->count > 0 ? job->count : 1) * sizeof(block_size));
+    for (size_t i = 0; i < job->count; i++) {
+        (*sizes)[i].chars = job->ranges[i].length;
+        (*sizes)[i].bytes = (bit_buffer_size(job->codes[i]) + 7) / 8;
+    }
+    return job->count;
+}
+
+size_t parse_blocks(const unsigned char *data, size_t size, const unsigned char *sizes,
+                    size_t count, size_t n, block_info **blocks) {
+    size_t used = 0;
+    size_t start = 0;
+    size_t done = 0;
+    *blocks = malloc((count > 0 ? count : 1) * sizeof(block_info));
+
+    /* Each block is located from the sizes of the blocks before it, and
+       its header must end where its size says */
+    for (; used < count; used++) {
+        block_info info;
+        uint32_t table_chars = load_le32(sizes + 8 * used);
+        uint32_t table_bytes = load_le32(sizes + 8 * used + 4);
+        if (table_bytes > size - start || table_bytes < 5) {
+            break;
+        }
+        size_t end = start + table_bytes;
+        size_t pos = start;
+        info.type = data[pos] & ~(BLOCK_CHECKSUM | BLOCK_RLE);
+        info.checksum = data[pos] & BLOCK_CHECKSUM;
+        info.rle = data[pos] & BLOCK_RLE;
+        info.chars = load_le32(data + pos + 1);
+        info.out_pos = done;
+        pos += 5;
+        if (info.chars != table_chars) {
+            break;
+        }
+
+        info.crc = 0;
+        if (info.checksum) {
+            if (end - pos < 4) {
+                break;
+            }
+            info.crc = load_le32(data + pos);
+            pos += 4;
+        }
+
+        if (info.type == BLOCK_BWT) {
+            if (end - pos < 4 * BWT_CHAINS) {
+                break;
+            }
+            for (int j = 0; j < BWT_CHAINS; j++) {
+                info.index[j] = load_le32(data + pos + 4 * j);
+            }
+            pos += 4 * BWT_CHAINS;
+        }
+
+        /* Each table is built once here, and shared by the blocks that
+           reuse it */
+        info.table = NULL;
+        info.own_table = false;
+        info.ans = NULL;
+        if (info.type == BLOCK_TABLE || info.type == BLOCK_BWT) {
+            info.table = malloc(sizeof(huffman_table));
+            size_t table_size = huffman_table_read(info.table, data + pos, end - pos);
+            if (table_size == 0) {
+                free(info.table);
+                break;
+            }
+            info.own_table = true;
+            pos += table_size;
+        } else if (info.type == BLOCK_REUSE) {
+            uint32_t ref = end - pos >= 4 ? load_le32(data + pos) : UINT32_MAX;
+            if (ref >= used || (*blocks)[ref].type != BLOCK_TABLE || (*blocks)[ref].rle) {
+                break;
+            }
+            info.table = (*blocks)[ref].table;
+            pos += 4;
+        } else if (info.type == BLOCK_ANS) {
+            info.ans = malloc(sizeof(tans_table));
+            size_t table_size = tans_table_read(info.ans, data + pos, end - pos);
+            if (table_size == 0) {
+                free(info.ans);
+                break;
+            }
+            pos += table_size;
+        } else if (info.type != BLOCK_MODEL && info.type != BLOCK_STORED) {
+            break;
+        }
+        if (info.rle && info.type != BLOCK_TABLE) {
+            free_block_tables(&info, 1);
+            break;
+        }
+
+        if (end - pos < 4 || info.chars > n - done) {
+            free_block_tables(&info, 1);
+            break;
+        }
+        info.bytes = load_le32(data + pos);
+        info.code_pos = pos + 4;
+        pos += 4;
+        if (info.bytes != end - pos ||
+            (info.type == BLOCK_STORED && info.bytes != info.chars)) {
+            free_block_tables(&info, 1);
+            break;
+        }
+        start = end;
+        done += info.chars;
+        (*blocks)[used] = info;
+    }
+
+    if (used < count || done != n) {
+        free_block_tables(*blocks, used);
+        free(*blocks);
+        *blocks = NULL;
+        return (size_t)-1;
+    }
+    return used;
+}
+
+static void run_block(void *context, size_t i) {
+    block_job_run(context, i);
+}
+
+static void encode_block(block_job *job, size_t i) {
+    const unsigned char *data = job->data + job->ranges[i].start;
+    size_t n = job->ranges[i].length;
+    bit_buffer *b = bit_buffer_empty();
+
+    if (job->options->bwt) {
+        append_bwt(data, n, job->options, b);
+    } else {
+        append_block(job->model, &job->plans[i], data, n, job->options, b);
+    }
+    job->codes[i] = b;
+}
+
+static void decode_block(block_job *job, size_t i) {
+    const block_info *info = &job->blocks[i];
+    job->err[i] = decode_block_info(job->model, job->data, info, job->out + info->out_pos);
+}
+
+int decode_block_info(const huffman_table *model, const unsigned char *data,
+                      const block_info *info, unsigned char *out) {
+    const unsigned char *codes = data + info->code_pos;
+    int err = 0;
+
+    const huffman_table *table = info->table != NULL ? info->table : model;
+
+    /* The decoders fold the characters into the checksum a step at a
+       time while the step is still in the L1 cache */
+    uint32_t crc = 0;
+    uint32_t *check = info->checksum ? &crc : NULL;
+
+    if (info->type == BLOCK_STORED) {
+        for (size_t done = 0; done < info->chars; done += CRC32C_STEP) {
+            size_t step = info->chars - done < CRC32C_STEP ? info->chars - done : CRC32C_STEP;
+            memcpy(out + done, codes + done, step);
+            if (check != NULL) {
+                crc = crc32c(crc, out + done, step);
+            }
+        }
+    } else if (info->type == BLOCK_BWT) {
+        unsigned char *last = malloc(info->chars > 0 ? info->chars : 1);
+        err = huffman_decode_zero_runs(table, codes, info->bytes, last, info->chars);
+        if (err == 0) {
+            mtf_decode(last, info->chars);
+            err = bwt_inverse(last, info->chars, info->index, out);
+        }
+        free(last);
+        /* bwt_inverse writes its chains backwards, and the CRC needs the
+           characters in order, so this block is checked in a pass of its
+           own after it, mostly from L2 or memory */
+        if (err == 0 && check != NULL) {
+            crc = crc32c(0, out, info->chars);
+        }
+    } else if (info->type == BLOCK_ANS) {
+        err = tans_decode(info->ans, codes, info->bytes, out, info->chars, check);
+    } else if (info->rle) {
+        err = huffman_decode_rle(table, codes, info->bytes, out, info->chars, check);
+    } else {
+        err = huffman_decode(table, codes, info->bytes, out, info->chars, check);
+    }
+
+    if (err == 0 && info->checksum && crc != info->crc) {
+        err = -1;
+    }
+
+    return err;
+}
+
+void free_block_tables(block_info *blocks, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (blocks[i].own_table) {
+            free(blocks[i].table);
+        }
+        free(blocks[i].ans);
+    }
+}
+
+/* Splits the data into equal blocks of at most BWT_MAX_BLOCK characters */
+static size_t bwt_blocks(size_t n, block_range **blocks) {
+    size_t count = (n + BWT_MAX_BLOCK - 1) / BWT_MAX_BLOCK;
+    *blocks = malloc((count > 0 ? count : 1) * sizeof(block_range));
+
+    for (size_t i = 0; i < count; i++) {
+        (*blocks)[i].start = n / count * i;
+        (*blocks)[i].length = i + 1 < count ? n / count : n - n / count * i;
+    }
+    return count;
+}
+
+/*
+ * Decides in order how each block is coded, from the counts of
+ * split_counted. Each block takes whichever is cheapest of the model
+ * table, the table of one of the last BLOCK_REUSE_TABLES blocks that
+ * stored one, a new table of its own and being stored as it is. With
+ * the ans option tans.h is one more candidate. All Huffman costs are
+ * exact, and a new table is only built when the entropy of the block
+ * says it might win.
+ */
+static void plan_blocks(block_job *job, const uint64_t *counts) {
+    size_t recent[BLOCK_REUSE_TABLES];
+    int recent_count = 0;
+    job->plans = calloc(job->count > 0 ? job->count : 1, sizeof(block_plan));
+
+    for (size_t i = 0; i < job->count; i++) {
+        block_plan *plan = &job->plans[i];
+        const uint64_t *block_counts = counts + i * HUFF_SYMBOLS;
+        size_t n = job->ranges[i].length;
+
+        plan->type = BLOCK_STORED;
+        plan->bits = (uint64_t)n * 8;
+        if (looks_incompressible(job->data + job->ranges[i].start, n)) {
+            plan->incompressible = true;
+            continue;
+        }
+
+        uint64_t model_bits = code_bits(block_counts, job->model);
+        if (model_bits < plan->bits && covers(job->model, block_counts)) {
+            plan->type = BLOCK_MODEL;
+            plan->bits = model_bits;
+        }
+        for (int k = 0; k < recent_count; k++) {
+            const block_plan *other = &job->plans[recent[k]];
+            uint64_t bits = code_bits(block_counts, other->table) + 32;
+            if (bits < plan->bits && covers(other->table, block_counts)) {
+                plan->type = BLOCK_REUSE;
+                plan->table = other->table;
+                plan->ref = recent[k];
+                plan->bits = bits;
+            }
+        }
+        if (job->options->ans) {
+            uint16_t *norm = malloc(TANS_SYMBOLS * sizeof(uint16_t));
+            uint64_t bits = UINT64_MAX;
+            if (tans_normalize(block_counts, norm)) {
+                bits = tans_code_bits(norm, block_counts) + tans_table_size(norm) * 8;
+            }
+            if (bits < plan->bits) {
+                plan->type = BLOCK_ANS;
+                plan->norm = norm;
+                plan->bits = bits;
+            } else {
+                free(norm);
+            }
+        }
+
+        /* The codes of a table of its own take at least the entropy,
+           and the table at least its bitmap and lengths */
+        double sum = 0.0;
+        int symbols = 0;
+        for (int s = 0; s < HUFF_SYMBOLS; s++) {
+            if (block_counts[s] > 0) {
+                sum += block_counts[s] * log2((double)block_counts[s]);
+                symbols++;
+            }
+        }
+        double entropy = symbols > 1 ? n * log2((double)n) - sum : 0.0;
+        double least = entropy + HUFF_TABLE_BITMAP_BYTES * 8 + symbols * HUFF_LENGTH_BITS;
+        if (least >= plan->bits) {
+            if (plan->type == BLOCK_REUSE) {
+                job->plans[plan->ref].shared = true;
+            }
+            continue;
+        }
+
+        huffman_table *own = huffman_table_from_counts(block_counts);
+        uint64_t own_bits = code_bits(block_counts, own) + huffman_table_size(own) * 8;
+        if (own_bits >= plan->bits) {
+            free(own);
+            if (plan->type == BLOCK_REUSE) {
+                job->plans[plan->ref].shared = true;
+            }
+            continue;
+        }
+
+        plan->type = BLOCK_TABLE;
+        plan->table = own;
+        plan->bits = own_bits;
+        free(plan->norm);
+        plan->norm = NULL;
+        memmove(recent + 1, recent, (BLOCK_REUSE_TABLES - 1) * sizeof(size_t));
+        recent[0] = i;
+        if (recent_count < BLOCK_REUSE_TABLES) {
+            recent_count++;
+        }
+    }
+}
+
+/*
+ * Estimates the bits needed for a block with the given counts. The
+ * model table cost is exact, unless the model has no code for one of
+ * the characters and can not be used. For a table of its own the
+ * entropy is used as the cost of the codes, which is at most one bit
+ * per character too low and usually much closer.
+ */
+static double estimate_bits(const uint64_t *counts, const huffman_table *model) {
+    uint64_t total = 0;
+    uint64_t model_bits = 0;
+    bool covered = true;
+    double sum = 0.0;
+    int symbols = 0;
+
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        if (counts[i] > 0) {
+            total += counts[i];
+            model_bits += counts[i] * model->length[i];
+            covered = covered && model->length[i] > 0;
+            sum += counts[i] * log2((double)counts[i]);
+            symbols++;
+        }
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    double own_bits = symbols == 1 ? (double)total : total * log2((double)total) - sum;
+    own_bits += HUFF_TABLE_BITMAP_BYTES * 8 + symbols * HUFF_LENGTH_BITS;
+
+    double bits = covered && model_bits < own_bits ? (double)model_bits : own_bits;
+    if (bits > total * 8.0) {
+        bits = total * 8.0;
+    }
+    return bits + BLOCK_HEADER_BYTES * 8;
+}
+
+/* Returns true if the table has a code for every symbol in counts */
+static bool covers(const huffman_table *table, const uint64_t *counts) {
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        if (counts[i] > 0 && table->length[i] == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns the exact number of code bits for the counts */
+static uint64_t code_bits(const uint64_t *counts, const huffman_table *table) {
+    uint64_t bits = 0;
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        bits += counts[i] * table->length[i];
+    }
+    return bits;
+}
+
+static void append_block(const huffman_table *model, const block_plan *plan,
+                         const unsigned char *data, size_t n,
+                         const block_options *options, bit_buffer *b) {
+    /* Run-length coding is tried against the plan, unless later blocks
+       need the table of the plan */
+    uint16_t *tokens = NULL;
+    size_t token_count = 0;
+    huffman_table *rle = NULL;
+    uint64_t rle_bits = UINT64_MAX;
+    if (options->rle && !plan->shared && !plan->incompressible) {
+        tokens = malloc(n * sizeof(uint16_t));
+        token_count = rle_encode(data, n, tokens);
+        if (token_count < n) {
+            uint64_t rle_counts[HUFF_SYMBOLS] = {0};
+            for (size_t i = 0; i < token_count; i++) {
+                rle_counts[tokens[i]]++;
+            }
+            rle = huffman_table_from_counts(rle_counts);
+            rle_bits = code_bits(rle_counts, rle) + huffman_table_size(rle) * 8;
+        }
+    }
+
+    if (plan->type == BLOCK_STORED && rle_bits >= n * 8) {
+        append_stored(data, n, options, b);
+    } else if (plan->type == BLOCK_ANS && rle_bits >= plan->bits) {
+        append_ans(plan->norm, data, n, options, b);
+    } else {
+        unsigned char header[BLOCK_HEADER_BYTES + 4 + HUFF_TABLE_MAX_BYTES];
+        const huffman_table *table = plan->table;
+        size_t header_size;
+        uint64_t bits;
+
+        if (rle_bits < plan->bits) {
+            table = rle;
+            header_size = start_header(header, BLOCK_TABLE | BLOCK_RLE, data, n, options);
+            header_size += huffman_table_write(rle, header + header_size);
+            bits = rle_bits - huffman_table_size(rle) * 8;
+        } else if (plan->type == BLOCK_TABLE) {
+            header_size = start_header(header, BLOCK_TABLE, data, n, options);
+            header_size += huffman_table_write(table, header + header_size);
+            bits = plan->bits - huffman_table_size(table) * 8;
+        } else if (plan->type == BLOCK_REUSE) {
+            header_size = start_header(header, BLOCK_REUSE, data, n, options);
+            store_le32(header + header_size, plan->ref);
+            header_size += 4;
+            bits = plan->bits - 32;
+        } else {
+            table = model;
+            header_size = start_header(header, BLOCK_MODEL, data, n, options);
+            bits = plan->bits;
+        }
+        store_le32(header + header_size, (bits + 7) / 8);
+        header_size += 4;
+        bit_buffer_append_bytes(b, (const char *)header, header_size);
+
+        if (table == rle) {
+            huffman_encode_symbols(rle, tokens, token_count, b);
+        } else {
+            huffman_encode(table, data, n, b);
+        }
+        while (bit_buffer_size(b) % 8 != 0) {
+            bit_buffer_insert_bit(b, 0);
+        }
+    }
+
+    free(tokens);
+    free(rle);
+}
+
+static void append_ans(const uint16_t *norm, const unsigned char *data, size_t n,
+                       const block_options *options, bit_buffer *b) {
+    tans_table *table = malloc(sizeof(tans_table));
+    tans_table_from_norm(table, norm);
+    size_t size;
+    unsigned char *codes = tans_encode(table, data, n, &size);
+    free(table);
+
+    unsigned char header[BLOCK_HEADER_BYTES + 4 + TANS_TABLE_MAX_BYTES];
+    size_t header_size = start_header(header, BLOCK_ANS, data, n, options);
+    header_size += tans_table_write(norm, header + header_size);
+    store_le32(header + header_size, size);
+    header_size += 4;
+
+    bit_buffer_append_bytes(b, (const char *)header, header_size);
+    bit_buffer_append_bytes(b, (const char *)codes, size);
+    free(codes);
+}
+
+static void append_bwt(const unsigned char *data, size_t n, const block_options *options,
+                       bit_buffer *b) {
+    unsigned char *last = malloc(n);
+    uint16_t *tokens = malloc(n * sizeof(uint16_t));
+    uint32_t index[BWT_CHAINS];
+
+    if (looks_incompressible(data, n) || last == NULL || tokens == NULL ||
+        bwt_forward(data, n, last, index) != 0) {
+        free(last);
+        free(tokens);
+        append_stored(data, n, options, b);
+        return;
+    }
+
+    mtf_encode(last, n);
+    size_t token_count = zero_run_encode(last, n, tokens);
+    free(last);
+
+    uint64_t counts[HUFF_SYMBOLS] = {0};
+    for (size_t i = 0; i < token_count; i++) {
+        counts[tokens[i]]++;
+    }
+    huffman_table *table = huffman_table_from_counts(counts);
+    uint64_t bits = code_bits(counts, table);
+
+    if (bits + (huffman_table_size(table) + 4 * BWT_CHAINS) * 8 >= n * 8) {
+        append_stored(data, n, options, b);
+    } else {
+        unsigned char header[BLOCK_HEADER_BYTES + 4 + 4 * BWT_CHAINS + HUFF_TABLE_MAX_BYTES];
+        size_t header_size = start_header(header, BLOCK_BWT, data, n, options);
+        for (int j = 0; j < BWT_CHAINS; j++) {
+            store_le32(header + header_size, index[j]);
+            header_size += 4;
+        }
+        header_size += huffman_table_write(table, header + header_size);
+        store_le32(header + header_size, (bits + 7) / 8);
+        header_size += 4;
+
+        bit_buffer_append_bytes(b, (const char *)header, header_size);
+        huffman_encode_symbols(table, tokens, token_count, b);
+        while (bit_buffer_size(b) % 8 != 0) {
+            bit_buffer_insert_bit(b, 0);
+        }
+    }
+
+    free(table);
+    free(tokens);
+}
+
+static void append_stored(const unsigned char *data, size_t n,
+                          const block_options *options, bit_buffer *b) {
+    unsigned char header[BLOCK_HEADER_BYTES + 4];
+    size_t header_size = start_header(header, BLOCK_STORED, data, n, options);
+    store_le32(header + header_size, n);
+    header_size += 4;
+
+    bit_buffer_append_bytes(b, (const char *)header, header_size);
+    bit_buffer_append_bytes(b, (const char *)data, n);
+}
+
+/* Writes the type, the number of characters and the checksum, and
+   returns the number of bytes written */
+static size_t start_header(unsigned char *header, int type, const unsigned char *data,
+                           size_t n, const block_options *options) {
+    header[0] = type | (options->checksum ? BLOCK_CHECKSUM : 0);
+    store_le32(header + 1, n);
+    if (!options->checksum) {
+        return 5;
+    }
+    store_le32(header + 5, crc32c(0, data, n));
+    return 9;
+}
+
+/*
+ * Estimates the entropy from a few windows spread over the block, so
+ * that compressed data can be stored without counting the whole block
+ * and building a table. The Miller-Madow correction makes up for the
+ * underestimate of entropy from a small sample.
+ */
+static bool looks_incompressible(const unsigned char *data, size_t n) {
+    const size_t sample = BLOCK_SAMPLE_WINDOWS * BLOCK_SAMPLE_WINDOW_SIZE;
+    uint64_t counts[HUFF_SYMBOLS] = {0};
+
+    if (n < sample) {
+        return false;
+    }
+
+    size_t stride = n / BLOCK_SAMPLE_WINDOWS;
+    for (int i = 0; i < BLOCK_SAMPLE_WINDOWS; i++) {
+        count_bytes(data + i * stride, BLOCK_SAMPLE_WINDOW_SIZE, counts);
+    }
+
+    double sum = 0.0;
+    int symbols = 0;
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        if (counts[i] > 0) {
+            sum += counts[i] * log2((double)counts[i]);
+            symbols++;
+        }
+    }
+
+    double entropy = log2((double)sample) - sum / sample;
+    entropy += (symbols - 1) / (2.0 * sample * log(2.0));
+    return entropy >= BLOCK_STORED_ENTROPY;
+}
@@ -0,0 +1,229 @@
+#ifndef HUFFMAN_BLOCK
+#define HUFFMAN_BLOCK
+
+#include <stddef.h>
+#include <stdint.h>
+#include "huffman_table.h"
+#include "bit_buffer.h"
+#include "bwt.h"
+#include "tans.h"
+
+/*
+ * Splitting of the data into blocks with their own code tables.
+ *
+ * Each block is coded either with the model table from FILE0, with a
+ * table of its own that is stored in front of the codes, or with the
+ * table of an earlier block when the statistics have not changed enough
+ * for a new table to pay off. Blocks that would not get smaller, such
+ * as compressed or random data, are stored as they are. Blocks with
+ * long runs of a character can be run-length coded with rle.h before
+ * the Huffman coding. With the bwt option the data is instead cut into
+ * blocks of at most BWT_MAX_BLOCK characters that go through the
+ * transforms of bwt.h. With the ans option a block may instead be
+ * coded with tans.h when that takes fewer bits than any Huffman code.
+ * A block is
+ *
+ *   u8   type        BLOCK_MODEL, BLOCK_TABLE, BLOCK_STORED, BLOCK_BWT,
+ *                    BLOCK_REUSE or BLOCK_ANS, plus
+ *                    BLOCK_CHECKSUM if the block has a checksum and
+ *                    BLOCK_RLE if a BLOCK_TABLE codes rle.h symbols
+ *   u32  characters  number of characters in the block
+ *   u32  checksum    only with BLOCK_CHECKSUM, CRC-32C of the characters
+ *   u32  index[8]    only for BLOCK_BWT, the rows of bwt_forward
+ *        table       only for BLOCK_TABLE and BLOCK_BWT, see
+ *                    huffman_table_write
+ *        ans table   only for BLOCK_ANS, see tans_table_write
+ *   u32  block       only for BLOCK_REUSE, the index of the earlier
+ *                    BLOCK_TABLE without BLOCK_RLE whose table codes
+ *                    this block
+ *   u32  size        number of code bytes, or characters if stored
+ *        codes       padded with 0 bits to a whole byte
+ *
+ * with all integers little-endian.
+ */
+
+#define BLOCK_MODEL 0
+#define BLOCK_TABLE 1
+#define BLOCK_STORED 2
+#define BLOCK_BWT 3
+#define BLOCK_REUSE 4
+#define BLOCK_ANS 5
+#define BLOCK_RLE 0x40
+#define BLOCK_CHECKSUM 0x80
+
+/* Size of the block header without the checksum and the table */
+#define BLOCK_HEADER_BYTES 9
+
+/* The data is analysed in chunks of this size, and blocks are cut at
+   chunk boundaries */
+#define BLOCK_CHUNK_SIZE (16 * 1024)
+#define BLOCK_MAX_SIZE (1024 * 1024)
+
+/* The number of most recent tables a block may reuse */
+#define BLOCK_REUSE_TABLES 4
+
+/*
+ * checksum  Add a CRC-32C of the characters to every block.
+ * rle       Try run-length coding for every block.
+ * bwt       Use the Burrows-Wheeler transform for every block.
+ * ans       Code blocks with tans.h where that is smaller.
+ * threads   The number of threads that code blocks, 0 for one per
+ *           processor.
+ * store_model  Store the model table in the header of the encoded
+ *              file, see container.h, so it decodes without FILE0.
+ * legacy    Decode files from before container.h, which hold the number
+ *           of characters as a u64 followed by the codes of the model
+ *           table, see huffman_decode_speculative.
+ */
+typedef struct {
+    bool checksum;
+    bool rle;
+    bool bwt;
+    bool ans;
+    int threads;
+    bool store_model;
+    bool legacy;
+} block_options;
+
+typedef struct {
+    size_t start;
+    size_t length;
+} block_range;
+
+/* The number of characters and of bytes, header included, of a coded
+   block */
+typedef struct {
+    uint32_t chars;
+    uint32_t bytes;
+} block_size;
+
+/*
+ * Splits the n characters in data into blocks where the character
+ * statistics change enough that a new table pays for its header. The
+ * cost of each chunk is estimated from its histogram, as the cheapest
+ * of the codes of the model table, the entropy of the chunk plus the
+ * size of its table and storing it as it is. Stores a newly allocated
+ * array of the blocks in *blocks and returns the number of blocks. The
+ * user is responsible for deallocating the array with free.
+ */
+size_t split_blocks(const unsigned char *data, size_t n, const huffman_table *model,
+                    block_range **blocks);
+
+/* A sample with an estimated entropy of at least this many bits per
+   character is stored without building a table */
+#define BLOCK_STORED_ENTROPY 7.9
+#define BLOCK_SAMPLE_WINDOWS 16
+#define BLOCK_SAMPLE_WINDOW_SIZE 256
+
+/*
+ * Appends the n characters in data to the bit buffer as blocks. Each
+ * block gets the table that gives the fewest bits, or is stored if no
+ * table makes it smaller. The blocks are coded in parallel.
+ */
+void encode_blocks(const huffman_table *model, const unsigned char *data, size_t n,
+                   const block_options *options, bit_buffer *b);
+
+/*
+ * Decodes n characters from the size bytes of the count blocks in data
+ * into out, with the block table sizes, see parse_blocks. The checksum
+ * of each block that has one is verified. Returns 0 on success and -1
+ * if the blocks are invalid or a checksum differs.
+ */
+int decode_blocks(const huffman_table *model, const unsigned char *data, size_t size,
+                  const unsigned char *sizes, size_t count, unsigned char *out, size_t n,
+                  const block_options *options);
+
+/*
+ * The steps of encode_blocks and decode_blocks, for callers that
+ * schedule the blocks of several inputs themselves. A start function
+ * splits or parses the blocks and stores their number in *count,
+ * block_job_run codes block i, and may run on any thread once for
+ * every i in [0, *count), and the finish function collects the result
+ * and frees the job. decode_blocks_start returns NULL if the blocks are
+ * invalid, and decode_blocks_finish returns 0 on success and -1 if a
+ * block could not be decoded. The data, and out for a decode, must stay
+ * valid until the job is finished.
+ */
+typedef struct block_job block_job;
+
+block_job *encode_blocks_start(const huffman_table *model, const unsigned char *data,
+                               size_t n, const block_options *options, size_t *count);
+void encode_blocks_finish(block_job *job, bit_buffer *b);
+/* Like encode_blocks_finish, but copies the blocks to out, which must
+   have room for the bytes of encode_blocks_sizes */
+void encode_blocks_finish_bytes(block_job *job, unsigned char *out);
+block_job *decode_blocks_start(const huffman_table *model, const unsigned char *data,
+                               size_t size, const unsigned char *sizes, size_t table_count,
+                               unsigned char *out, size_t n, size_t *count);
+int decode_blocks_finish(block_job *job);
+void block_job_run(block_job *job, size_t i);
+
+/*
+ * Runs all blocks of the job on up to threads threads, see
+ * parallel_for.
+ */
+void block_job_run_all(block_job *job, int threads);
+
+/*
+ * Stores a newly allocated array of the size of each block of an
+ * encode job whose blocks have all run in *sizes, and returns the
+ * number of blocks. The user is responsible for deallocating the array
+ * with free.
+ */
+size_t encode_blocks_sizes(const block_job *job, block_size **sizes);
+
+/*
+ * A block as read from its header, for callers that go through the
+ * blocks one by one. Positions are relative to the start of the
+ * blocks.
+ *
+ * type      BLOCK_MODEL, BLOCK_TABLE, BLOCK_STORED, BLOCK_BWT,
+ *           BLOCK_REUSE or BLOCK_ANS, without the flags.
+ * crc       The checksum of the characters, if checksum is set.
+ * index     The rows of bwt_forward of a BLOCK_BWT.
+ * chars     The number of characters, and out_pos the number of
+ *           characters of the blocks before it.
+ * table     The table of the codes, NULL for the model table. Blocks
+ *           that reuse a table share it, and own_table is only set in
+ *           the block that stores it.
+ * ans       The table of a BLOCK_ANS.
+ * code_pos  The position of the codes, and bytes their number.
+ */
+typedef struct {
+    int type;
+    bool checksum;
+    bool rle;
+    uint32_t crc;
+    uint32_t index[BWT_CHAINS];
+    size_t chars;
+    size_t out_pos;
+    huffman_table *table;
+    bool own_table;
+    tans_table *ans;
+    size_t code_pos;
+    size_t bytes;
+} block_info;
+
+/*
+ * Reads the headers of the count blocks in the size bytes of data that
+ * make up n characters and stores a newly allocated array of them in
+ * *blocks. sizes is the block table of container.h, count entries of
+ * the u32 characters and u32 bytes of a block, from which each block is
+ * located. Returns count, or (size_t)-1 if a header is invalid or
+ * differs from its entry. The user is responsible for deallocating the
+ * tables with free_block_tables and the array with free.
+ */
+size_t parse_blocks(const unsigned char *data, size_t size, const unsigned char *sizes,
+                    size_t count, size_t n, block_info **blocks);
+
+/*
+ * Decodes the block of info, parsed from data, into out, which has room
+ * for its characters, and verifies its checksum. Returns 0 on success
+ * and -1 if the codes are invalid or the checksum differs.
+ */
+int decode_block_info(const huffman_table *model, const unsigned char *data,
+                      const block_info *info, unsigned char *out);
+
+void free_block_tables(block_info *blocks, size_t count);
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * A small client for huffman -serve, for testing and for measuring the
+ * round trip time of requests. Built with make.
+ *
+ * USAGE:
+ * huffman_client SOCK -encode|-decode FILE0 FILE1 FILE2 [REPEAT]
+ * huffman_client SOCK -stats
+ *
+ * Sends FILE1 to be encoded or decoded with the model of FILE0 and
+ * stores the answer in FILE2. With REPEAT the request is sent REPEAT
+ * times on the same connection and the mean round trip is printed.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "byte_order.h"
+#include "huffman_codec.h"
+#include "server.h"
+
+static int connect_socket(const char *path);
+static int write_all(int fd, const void *data, size_t size);
+static int read_all(int fd, void *data, size_t size);
+static unsigned char *request(int fd, int op, const char *model, const unsigned char *data,
+                              size_t size, int *status, size_t *answer_size);
+static double now(void);
+
+int main(int argc, const char *argv[]) {
+    if (argc == 3 && strcmp(argv[2], "-stats") == 0) {
+        int fd = connect_socket(argv[1]);
+        if (fd < 0) {
+            fprintf(stderr, "Could not connect to: %s\n", argv[1]);
+            return 1;
+        }
+        int status;
+        size_t size;
+        unsigned char *answer = request(fd, SERVE_STATS, "", NULL, 0, &status, &size);
+        close(fd);
+        if (answer == NULL) {
+            fprintf(stderr, "No answer from the server\n");
+            return 1;
+        }
+        fwrite(answer, 1, size, stdout);
+        free(answer);
+        return 0;
+    }
+
+    if (argc < 6 || (strcmp(argv[2], "-encode") != 0 && strcmp(argv[2], "-decode") != 0)) {
+        printf("USAGE:\n%s SOCK -encode|-decode FILE0 FILE1 FILE2 [REPEAT]\n", argv[0]);
+        printf("%s SOCK -stats\n", argv[0]);
+        return 1;
+    }
+    int op = strcmp(argv[2], "-encode") == 0 ? SERVE_ENCODE : SERVE_DECODE;
+    int repeat = argc > 6 ? atoi(argv[6]) : 1;
+    if (repeat < 1) {
+        repeat = 1;
+    }
+
+    /* The server opens FILE0 itself, from its own working directory */
+    char model[PATH_MAX];
+    if (realpath(argv[3], model) == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", argv[3]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[4], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", argv[4]);
+        return 1;
+    }
+    size_t size;
+    unsigned char *data = read_file(in, &size);
+    fclose(in);
+
+    int fd = connect_socket(argv[1]);
+    if (data == NULL || fd < 0) {
+        fprintf(stderr, "Could not connect to: %s\n", argv[1]);
+        free(data);
+        return 1;
+    }
+
+    unsigned char *answer = NULL;
+    size_t answer_size = 0;
+    int status = SERVE_ERROR;
+    double start = now();
+    for (int i = 0; i < repeat; i++) {
+        free(answer);
+        answer = request(fd, op, model, data, size, &status, &answer_size);
+        if (answer == NULL) {
+            break;
+        }
+    }
+    double elapsed = now() - start;
+    close(fd);
+    free(data);
+
+    if (answer == NULL || status != SERVE_OK) {
+        fprintf(stderr, "The request failed: %.*s\n", answer != NULL ? (int)answer_size : 0,
+                answer != NULL ? (const char *)answer : "");
+        free(answer);
+        return 1;
+    }
+    if (repeat > 1) {
+        printf("%d requests, mean round trip %.3f ms\n", repeat, elapsed / repeat * 1e3);
+    }
+
+    FILE *out = fopen(argv[5], "wb");
+    int err = out == NULL || fwrite(answer, 1, answer_size, out) != answer_size;
+    if (out != NULL && fclose(out) != 0) {
+        err = 1;
+    }
+    if (err) {
+        fprintf(stderr, "Could not write the file: %s\n", argv[5]);
+    }
+    free(answer);
+    return err;
+}
+
+static int connect_socket(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static int write_all(int fd, const void *data, size_t size) {
+    const unsigned char *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *data, size_t size) {
+    unsigned char *p = data;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/* Sends one request and returns the data of the answer, or NULL if the
+   connection fails */
+static unsigned char *request(int fd, int op, const char *model, const unsigned char *data,
+                              size_t size, int *status, size_t *answer_size) {
+    unsigned char header[SERVE_REQUEST_HEADER];
+    size_t model_length = strlen(model);
+    header[0] = op;
+    store_le32(header + 1, model_length);
+    store_le64(header + 5, size);
+
+    if (write_all(fd, header, sizeof(header)) != 0 ||
+        write_all(fd, model, model_length) != 0 ||
+        write_all(fd, data, size) != 0) {
+        return NULL;
+    }
+
+    unsigned char answer_header[SERVE_ANSWER_HEADER];
+    if (read_all(fd, answer_header, sizeof(answer_header)) != 0) {
+        return NULL;
+    }
+    *status = answer_header[0];
+    *answer_size = load_le64(answer_header + 1);
+
+    unsigned char *answer = malloc(*answer_size > 0 ? *answer_size : 1);
+    if (answer != NULL && read_all(fd, answer, *answer_size) != 0) {
+        free(answer);
+        return NULL;
+    }
+    return answer;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
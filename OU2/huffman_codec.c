@@ -0,0 +1,411 @@
+#include "huffman_codec.h"
+#include "huffman_block.h"
+#include "rle.h"
+#include "byte_order.h"
+#include "bit_reader.h"
+#include "crc32c.h"
+#include "file_map.h"
+#include "huffman_stream.h"
+#include "huffman_speculative.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define READ_CHUNK (64 * 1024)
+#define ENCODE_CHUNK 4096
+
+static inline void encode_codes(const huffman_table *table, const unsigned char *chars,
+                                const uint16_t *symbols, size_t n, bit_buffer *b);
+static inline int decode_runs(const huffman_table *table, const unsigned char *data,
+                              size_t size, unsigned char *out, size_t n, bool zeros,
+                              uint32_t *crc);
+static size_t encoded_size(const huffman_table *table, const block_size *sizes, size_t count,
+                           const block_options *options);
+static void write_encoded(const huffman_table *table, block_job *job, size_t n,
+                          const block_size *sizes, size_t count,
+                          const block_options *options, unsigned char *out);
+static int decode_legacy(FILE *process_file_p, FILE *out_file_p, const huffman_table *table,
+                         const block_options *options);
+
+void huffman_encode(const huffman_table *table, const unsigned char *data,
+                    size_t n, bit_buffer *b) {
+    encode_codes(table, data, NULL, n, b);
+}
+
+void huffman_encode_symbols(const huffman_table *table, const uint16_t *symbols,
+                            size_t n, bit_buffer *b) {
+    encode_codes(table, NULL, symbols, n, b);
+}
+
+int huffman_decode(const huffman_table *table, const unsigned char *data,
+                   size_t size, unsigned char *out, size_t n, uint32_t *crc) {
+    uint64_t acc = 0;
+    int bits = 0;
+    size_t pos = 0;
+    size_t i = 0;
+    size_t checked = 0;
+
+    /* While 8 bytes are left a refill is one load with no bounds
+       checks, and leaves at least 56 bits, which hold two codes */
+    while (n - i >= 2 && size - pos >= 8) {
+        bit_refill(data, size, &pos, &acc, &bits);
+
+        int len;
+        int symbol = huffman_table_decode(table, acc, &len);
+        if (symbol < 0) {
+            return -1;
+        }
+        out[i++] = symbol;
+        acc <<= len;
+        bits -= len;
+
+        symbol = huffman_table_decode(table, acc, &len);
+        if (symbol < 0) {
+            return -1;
+        }
+        out[i++] = symbol;
+        acc <<= len;
+        bits -= len;
+        crc32c_step(crc, out, &checked, i, false);
+    }
+
+    /* The last bytes, where the codes may run out */
+    for (; i < n; i++) {
+        bit_refill(data, size, &pos, &acc, &bits);
+
+        int len;
+        int symbol = huffman_table_decode(table, acc, &len);
+        if (symbol < 0 || len > bits) {
+            return -1;
+        }
+        out[i] = symbol;
+        acc <<= len;
+        bits -= len;
+    }
+
+    crc32c_step(crc, out, &checked, n, true);
+    return 0;
+}
+
+int huffman_decode_rle(const huffman_table *table, const unsigned char *data,
+                       size_t size, unsigned char *out, size_t n, uint32_t *crc) {
+    return decode_runs(table, data, size, out, n, false, crc);
+}
+
+int huffman_decode_zero_runs(const huffman_table *table, const unsigned char *data,
+                             size_t size, unsigned char *out, size_t n) {
+    return decode_runs(table, data, size, out, n, true, NULL);
+}
+
+unsigned char *encode_buffer(const huffman_table *table, const unsigned char *data,
+                            size_t n, const block_options *options, size_t *size) {
+    size_t count;
+    block_job *job = encode_blocks_start(table, data, n, options, &count);
+    block_job_run_all(job, options->threads);
+
+    return encode_buffer_finish(table, job, n, options, size);
+}
+
+unsigned char *encode_buffer_finish(const huffman_table *table, block_job *job, size_t n,
+                                    const block_options *options, size_t *size) {
+    block_size *sizes;
+    size_t count = encode_blocks_sizes(job, &sizes);
+    *size = encoded_size(table, sizes, count, options);
+
+    unsigned char *codes = malloc(*size);
+    write_encoded(table, job, n, sizes, count, options, codes);
+    free(sizes);
+
+    return codes;
+}
+
+unsigned char *decode_buffer(const huffman_table *table, const unsigned char *data,
+                             size_t size, const block_options *options, size_t *n) {
+    container *c = malloc(sizeof(container));
+    if (container_read(c, data, size, table) != 0) {
+        free(c);
+        return NULL;
+    }
+
+    /* The header has been checked against the block table, so the
+       output is allocated once at its final size */
+    *n = c->characters;
+    unsigned char *out = malloc(*n > 0 ? *n : 1);
+    if (out != NULL && decode_blocks(c->model, c->blocks, c->size, c->sizes, c->count, out, *n,
+                                     options) != 0) {
+        free(out);
+        out = NULL;
+    }
+
+    free(c);
+    return out;
+}
+
+int encode_file(FILE *process_file_p, FILE *out_file_p, const huffman_table *table,
+                const block_options *options) {
+    size_t n;
+    unsigned char *data = read_file(process_file_p, &n);
+    if (data == NULL) {
+        return -1;
+    }
+
+    size_t count;
+    block_job *job = encode_blocks_start(table, data, n, options, &count);
+    block_job_run_all(job, options->threads);
+    free(data);
+
+    return encode_file_finish(out_file_p, table, job, n, options);
+}
+
+int encode_file_finish(FILE *out_file_p, const huffman_table *table, block_job *job,
+                       size_t n, const block_options *options) {
+    /* The sizes of all blocks are known before anything is written, so
+       the output is mapped at its exact size and the blocks are copied
+       into it once */
+    block_size *sizes;
+    size_t count = encode_blocks_sizes(job, &sizes);
+    size_t size = encoded_size(table, sizes, count, options);
+    unsigned char *map = file_map_output(out_file_p, size);
+    unsigned char *codes = map != NULL ? map : malloc(size);
+    write_encoded(table, job, n, sizes, count, options, codes);
+    free(sizes);
+
+    int err;
+    if (map != NULL) {
+        err = file_unmap_output(out_file_p, map, size, 0);
+    } else {
+        err = fwrite(codes, 1, size, out_file_p) == size ? 0 : -1;
+        free(codes);
+    }
+
+    return err;
+}
+
+int decode_file(FILE *process_file_p, FILE *out_file_p, const huffman_table *table,
+                const block_options *options) {
+    if (options->legacy) {
+        return decode_legacy(process_file_p, out_file_p, table, options);
+    }
+
+    /* A pipe is decoded as it arrives, in bounded memory */
+    if (!file_is_regular(process_file_p)) {
+        int err = stream_decode_file(process_file_p, out_file_p, table);
+        if (err) {
+            file_discard_output(out_file_p);
+        }
+        return err;
+    }
+
+    size_t size;
+    unsigned char *data = read_file(process_file_p, &size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    container *c = malloc(sizeof(container));
+    if (container_read(c, data, size, table) != 0) {
+        free(c);
+        free(data);
+        return -1;
+    }
+
+    /* Decoded straight into the page cache when the output is a file */
+    size_t n = c->characters;
+    unsigned char *map = file_map_output(out_file_p, n);
+    unsigned char *out = map != NULL ? map : malloc(n > 0 ? n : 1);
+    int err = -1;
+    if (out != NULL) {
+        err = decode_blocks(c->model, c->blocks, c->size, c->sizes, c->count, out, n, options);
+    }
+
+    if (map != NULL) {
+        if (file_unmap_output(out_file_p, map, n, err) != 0) {
+            err = -1;
+        }
+    } else {
+        if (err == 0 && fwrite(out, 1, n, out_file_p) != n) {
+            err = -1;
+        }
+        free(out);
+    }
+
+    free(c);
+    free(data);
+    return err;
+}
+
+unsigned char *read_file(FILE *fp, size_t *size) {
+    size_t capacity = READ_CHUNK;
+    size_t used = 0;
+    unsigned char *data = malloc(capacity);
+
+    while (data != NULL) {
+        used += fread(data + used, 1, capacity - used, fp);
+        if (used < capacity) {
+            break;
+        }
+        capacity *= 2;
+        unsigned char *larger = realloc(data, capacity);
+        if (larger == NULL) {
+            free(data);
+            return NULL;
+        }
+        data = larger;
+    }
+
+    if (data != NULL && ferror(fp)) {
+        free(data);
+        return NULL;
+    }
+
+    *size = used;
+    return data;
+}
+
+/*
+ * Appends the codes of the n characters in chars, or if chars is NULL
+ * of the n symbols in symbols, to the bit buffer. Inlined with one of
+ * them NULL, so each caller gets a loop for its own element type.
+ */
+static inline void encode_codes(const huffman_table *table, const unsigned char *chars,
+                                const uint16_t *symbols, size_t n, bit_buffer *b) {
+    uint64_t acc = 0;
+    int bits = 0;
+    char chunk[ENCODE_CHUNK];
+    int used = 0;
+
+    /* Whole bytes are collected in chunk and appended to the bit
+       buffer in bulk */
+    for (size_t i = 0; i < n; i++) {
+        int symbol = chars != NULL ? chars[i] : symbols[i];
+        int len = table->length[symbol];
+        acc = acc << len | table->code[symbol];
+        bits += len;
+        while (bits >= 8) {
+            bits -= 8;
+            chunk[used++] = (char)(acc >> bits);
+        }
+        if (used > ENCODE_CHUNK - 8) {
+            bit_buffer_append_bytes(b, chunk, used);
+            used = 0;
+        }
+    }
+    if (used > 0) {
+        bit_buffer_append_bytes(b, chunk, used);
+    }
+
+    for (int bit = bits - 1; bit >= 0; bit--) {
+        bit_buffer_insert_bit(b, (acc >> bit) & 1);
+    }
+}
+
+/*
+ * Decodes characters and the RLE_RUNA and RLE_RUNB digits of run
+ * lengths from the size bytes of codes in data into the n characters of
+ * out. A run repeats the character before it, or with zeros is a run of
+ * 0 characters, which may also start the output. Unless crc is NULL the
+ * CRC-32C of the characters is continued in *crc. Returns 0 on success
+ * and -1 if the codes are invalid or too few.
+ */
+static inline int decode_runs(const huffman_table *table, const unsigned char *data,
+                              size_t size, unsigned char *out, size_t n, bool zeros,
+                              uint32_t *crc) {
+    uint64_t acc = 0;
+    int bits = 0;
+    size_t pos = 0;
+    size_t i = 0;
+    size_t checked = 0;
+    int digit = 0;
+
+    while (i < n) {
+        crc32c_step(crc, out, &checked, i, false);
+        bit_refill(data, size, &pos, &acc, &bits);
+
+        int len;
+        int symbol = huffman_table_decode(table, acc, &len);
+        if (symbol < 0 || len > bits) {
+            return -1;
+        }
+        acc <<= len;
+        bits -= len;
+
+        if (symbol < RLE_RUNA) {
+            out[i++] = symbol;
+            digit = 0;
+            continue;
+        }
+
+        /* Each digit of the run length adds its repeats at once */
+        if ((!zeros && i == 0) || digit >= 32) {
+            return -1;
+        }
+        size_t repeats = (size_t)(symbol == RLE_RUNA ? 1 : 2) << digit++;
+        if (repeats > n - i) {
+            return -1;
+        }
+        memset(out + i, zeros ? 0 : out[i - 1], repeats);
+        i += repeats;
+    }
+
+    crc32c_step(crc, out, &checked, n, true);
+    return 0;
+}
+
+/* Returns the size of the encoded file with the blocks of sizes */
+static size_t encoded_size(const huffman_table *table, const block_size *sizes, size_t count,
+                           const block_options *options) {
+    size_t size = container_header_size(table, count, options->store_model);
+    for (size_t i = 0; i < count; i++) {
+        size += sizes[i].bytes;
+    }
+    return size;
+}
+
+/* Writes the header and the blocks of a finished encode job to out, and
+   frees the job */
+static void write_encoded(const huffman_table *table, block_job *job, size_t n,
+                          const block_size *sizes, size_t count,
+                          const block_options *options, unsigned char *out) {
+    size_t header_size = container_write(out, table, n, sizes, count, options->store_model);
+    encode_blocks_finish_bytes(job, out + header_size);
+}
+
+/*
+ * Decodes a file from before container.h: the number of characters as
+ * a u64, followed by the codes of the model table with no blocks, and
+ * so with no index to split the work on. The codes are decoded
+ * speculatively on all threads instead.
+ */
+static int decode_legacy(FILE *process_file_p, FILE *out_file_p, const huffman_table *table,
+                         const block_options *options) {
+    size_t size;
+    unsigned char *data = read_file(process_file_p, &size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    /* Every code has at least one bit */
+    if (size < 8 || load_le64(data) > (uint64_t)(size - 8) * 8) {
+        free(data);
+        return -1;
+    }
+    size_t n = load_le64(data);
+
+    unsigned char *map = file_map_output(out_file_p, n);
+    unsigned char *out = map != NULL ? map : malloc(n > 0 ? n : 1);
+    int err = out != NULL ? huffman_decode_speculative(table, data + 8, size - 8, out, n,
+                                                       options->threads) : -1;
+
+    if (map != NULL) {
+        if (file_unmap_output(out_file_p, map, n, err) != 0) {
+            err = -1;
+        }
+    } else {
+        if (err == 0 && fwrite(out, 1, n, out_file_p) != n) {
+            err = -1;
+        }
+        free(out);
+    }
+
+    free(data);
+    return err;
+}
@@ -0,0 +1,112 @@
+#ifndef HUFFMAN_CODEC
+#define HUFFMAN_CODEC
+
+#include <stdio.h>
+#include <stddef.h>
+#include "huffman_table.h"
+#include "bit_buffer.h"
+#include "huffman_block.h"
+#include "container.h"
+
+/*
+ * Encoding and decoding of data with a huffman_table.
+ *
+ * The encoded file starts with the header described in container.h,
+ * followed by the blocks described in huffman_block.h.
+ */
+
+/*
+ * Appends the codes of the n characters in data to the bit buffer.
+ */
+void huffman_encode(const huffman_table *table, const unsigned char *data,
+                    size_t n, bit_buffer *b);
+
+/*
+ * Decodes n characters from the size bytes of codes in data into out.
+ * Unless crc is NULL the CRC-32C of the characters is continued in
+ * *crc, a step at a time as they are decoded, see crc32c_step. Returns
+ * 0 on success and -1 if the codes are invalid or too few.
+ */
+int huffman_decode(const huffman_table *table, const unsigned char *data,
+                   size_t size, unsigned char *out, size_t n, uint32_t *crc);
+
+/*
+ * Appends the codes of the n symbols to the bit buffer. Unlike
+ * huffman_encode the symbols may be any of the HUFF_SYMBOLS symbols.
+ */
+void huffman_encode_symbols(const huffman_table *table, const uint16_t *symbols,
+                            size_t n, bit_buffer *b);
+
+/*
+ * Decodes symbols coded with rle_encode from the size bytes of codes in
+ * data, and writes the n characters they expand to into out. Unless crc
+ * is NULL their CRC-32C is continued in *crc, as with huffman_decode.
+ * Returns 0 on success and -1 if the codes are invalid or too few.
+ */
+int huffman_decode_rle(const huffman_table *table, const unsigned char *data,
+                       size_t size, unsigned char *out, size_t n, uint32_t *crc);
+
+/*
+ * Decodes symbols coded with zero_run_encode from the size bytes of
+ * codes in data, and writes the n move-to-front indices they expand to
+ * into out. Returns 0 on success and -1 if the codes are invalid or too
+ * few.
+ */
+int huffman_decode_zero_runs(const huffman_table *table, const unsigned char *data,
+                             size_t size, unsigned char *out, size_t n);
+
+/*
+ * Encodes the n characters in data in the format above. Stores the
+ * size of the result in *size. The user is responsible for
+ * deallocating the result with free.
+ */
+unsigned char *encode_buffer(const huffman_table *table, const unsigned char *data,
+                            size_t n, const block_options *options, size_t *size);
+
+/*
+ * Builds the encoded file of the n characters coded by an encode job
+ * of encode_blocks_start whose blocks have all run, and frees the job.
+ * Stores the size of the result in *size. The user is responsible for
+ * deallocating the result with free.
+ */
+unsigned char *encode_buffer_finish(const huffman_table *table, block_job *job, size_t n,
+                                    const block_options *options, size_t *size);
+
+/*
+ * Decodes the size bytes in data, encoded by encode_buffer. Stores the
+ * number of characters in *n. Returns NULL if the data is invalid or
+ * was encoded with another model. The user is responsible for
+ * deallocating the result with free.
+ */
+unsigned char *decode_buffer(const huffman_table *table, const unsigned char *data,
+                             size_t size, const block_options *options, size_t *n);
+
+/*
+ * Encodes or decodes the rest of process_file_p into out_file_p, with
+ * the block options described in huffman_block.h. A process_file_p
+ * that is not a regular file, such as a pipe, is decoded with
+ * stream_decode_file.
+ */
+int encode_file(FILE *process_file_p, FILE *out_file_p, const huffman_table *table,
+                const block_options *options);
+int decode_file(FILE *process_file_p, FILE *out_file_p, const huffman_table *table,
+                const block_options *options);
+
+/*
+ * Writes the encoded file of the n characters coded by an encode job of
+ * encode_blocks_start whose blocks have all run to out_file_p, and
+ * frees the job.
+ *
+ * These functions write a regular out_file_p through a mapping, see
+ * file_map.h, so it should be opened with "w+b".
+ */
+int encode_file_finish(FILE *out_file_p, const huffman_table *table, block_job *job,
+                       size_t n, const block_options *options);
+
+/*
+ * Reads the rest of the file into memory. The user is responsible for
+ * deallocating the returned array. Returns NULL on read errors.
+ */
+unsigned char *read_file(FILE *fp, size_t *size);
+
+#endif
@@ -0,0 +1,467 @@
+#define _GNU_SOURCE
+
+#include "huffman_search.h"
+#include "huffman_block.h"
+#include "container.h"
+#include "bit_reader.h"
+#include "parallel.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * What the search found in one block.
+ *
+ * matches     The offsets of the matches inside the block, count of
+ *             them.
+ * head        The first characters of the block, at most m - 1 of them,
+ *             head_len.
+ * tail        The last characters, as many, once tail_known. Huffman
+ *             blocks only get them when a match across their end is
+ *             possible.
+ * err         The block is invalid.
+ */
+typedef struct {
+    uint64_t *matches;
+    size_t count;
+    size_t capacity;
+    unsigned char *head;
+    size_t head_len;
+    unsigned char *tail;
+    size_t tail_len;
+    bool tail_known;
+    int err;
+} block_result;
+
+typedef struct {
+    const huffman_table *model;
+    const unsigned char *data;
+    const block_info *blocks;
+    size_t count;
+    const unsigned char *pattern;
+    size_t m;
+    block_result *results;
+} search_job;
+
+/* Characters coded with a table, length bits most significant first */
+typedef struct {
+    unsigned char *bytes;
+    size_t size;
+    uint64_t length;
+} pattern_code;
+
+/* Codes shorter than this do not have two whole bytes at every bit
+   offset, and are so common that decoding the block is as fast */
+#define SEARCH_MIN_CODE_BITS 23
+
+/* Reads the codes of a block one at a time, keeping the bit position */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t byte;
+    uint64_t acc;
+    int bits;
+    uint64_t pos;
+} code_reader;
+
+static void search_block(void *context, size_t i);
+static void search_chars(const search_job *job, const block_info *info,
+                         const unsigned char *chars, block_result *r);
+static bool search_codes(const search_job *job, const block_info *info, block_result *r);
+static int cross_matches(const search_job *job, size_t i, search_found found, void *context,
+                         int64_t *total);
+static bool tail_possible(const search_job *job, const block_info *info, size_t k);
+static int read_tail(const search_job *job, const block_info *info, block_result *r);
+static bool code_pattern(const huffman_table *table, const unsigned char *pattern, size_t m,
+                         pattern_code *code);
+static size_t find_codes(const unsigned char *codes, size_t size, const pattern_code *code,
+                         uint64_t **found);
+static bool bits_equal(const unsigned char *data, size_t size, uint64_t pos,
+                       const pattern_code *code);
+static void add_match(block_result *r, uint64_t offset);
+static void add_position(uint64_t **positions, size_t *count, size_t *capacity, uint64_t pos);
+static const huffman_table *block_table(const search_job *job, const block_info *info);
+static void reader_init(code_reader *rd, const unsigned char *data, size_t size);
+static inline int reader_next(code_reader *rd, const huffman_table *table);
+
+int64_t huffman_search(const huffman_table *model, const unsigned char *data, size_t size,
+                       const unsigned char *pattern, size_t m, int threads,
+                       search_found found, void *context) {
+    container *c = malloc(sizeof(container));
+    if (m == 0 || container_read(c, data, size, model) != 0) {
+        free(c);
+        return -1;
+    }
+    block_info *blocks;
+    size_t count = parse_blocks(c->blocks, c->size, c->sizes, c->count, c->characters,
+                                &blocks);
+    if (count == (size_t)-1) {
+        free(c);
+        return -1;
+    }
+
+    search_job job = {c->model, c->blocks, blocks, count, pattern, m,
+                      calloc(count > 0 ? count : 1, sizeof(block_result))};
+    parallel_for(count, threads, search_block, &job);
+
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (job.results[i].err != 0) {
+            total = -1;
+        }
+    }
+
+    /* The matches across the end of a block come after those inside it
+       and before those of the next block */
+    for (size_t i = 0; i < count && total >= 0; i++) {
+        const block_result *r = &job.results[i];
+        for (size_t j = 0; j < r->count; j++) {
+            found(context, r->matches[j]);
+        }
+        total += r->count;
+        if (cross_matches(&job, i, found, context, &total) != 0) {
+            total = -1;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(job.results[i].matches);
+        free(job.results[i].head);
+        free(job.results[i].tail);
+    }
+    free(job.results);
+    free_block_tables(blocks, count);
+    free(blocks);
+    free(c);
+    return total;
+}
+
+static void search_block(void *context, size_t i) {
+    const search_job *job = context;
+    const block_info *info = &job->blocks[i];
+    block_result *r = &job->results[i];
+    size_t keep = job->m - 1 < info->chars ? job->m - 1 : info->chars;
+    r->head = malloc(keep > 0 ? keep : 1);
+    r->tail = malloc(keep > 0 ? keep : 1);
+
+    bool searched = false;
+    if (info->type == BLOCK_STORED) {
+        search_chars(job, info, job->data + info->code_pos, r);
+        searched = true;
+    } else if (!info->rle && (info->type == BLOCK_MODEL || info->type == BLOCK_TABLE ||
+                              info->type == BLOCK_REUSE)) {
+        searched = search_codes(job, info, r);
+    }
+
+    if (!searched) {
+        unsigned char *chars = malloc(info->chars > 0 ? info->chars : 1);
+        if (chars == NULL || decode_block_info(job->model, job->data, info, chars) != 0) {
+            r->err = -1;
+        } else {
+            search_chars(job, info, chars, r);
+        }
+        free(chars);
+    }
+}
+
+/* Searches the characters of a block that are at hand */
+static void search_chars(const search_job *job, const block_info *info,
+                         const unsigned char *chars, block_result *r) {
+    const unsigned char *p = chars;
+    const unsigned char *end = chars + info->chars;
+    while ((size_t)(end - p) >= job->m &&
+           (p = memmem(p, end - p, job->pattern, job->m)) != NULL) {
+        add_match(r, info->out_pos + (p - chars));
+        p++;
+    }
+
+    size_t keep = job->m - 1 < info->chars ? job->m - 1 : info->chars;
+    memcpy(r->head, chars, keep);
+    memcpy(r->tail, end - keep, keep);
+    r->head_len = keep;
+    r->tail_len = keep;
+    r->tail_known = true;
+}
+
+/*
+ * Searches the codes of a Huffman block for the codes of the pattern,
+ * and keeps the places that are at the start of a code. Returns false
+ * if the code of the pattern is too short to tell places apart, and the
+ * block is better decoded.
+ */
+static bool search_codes(const search_job *job, const block_info *info, block_result *r) {
+    const huffman_table *table = block_table(job, info);
+    const unsigned char *codes = job->data + info->code_pos;
+    code_reader rd;
+
+    pattern_code code;
+    bool coded = info->chars >= job->m && code_pattern(table, job->pattern, job->m, &code);
+    if (coded && code.length < SEARCH_MIN_CODE_BITS) {
+        free(code.bytes);
+        return false;
+    }
+
+    reader_init(&rd, codes, info->bytes);
+    size_t keep = job->m - 1 < info->chars ? job->m - 1 : info->chars;
+    for (size_t k = 0; k < keep; k++) {
+        int symbol = reader_next(&rd, table);
+        if (symbol < 0) {
+            r->err = -1;
+            if (coded) {
+                free(code.bytes);
+            }
+            return true;
+        }
+        r->head[k] = symbol;
+    }
+    r->head_len = keep;
+    if (!coded) {
+        return true;
+    }
+
+    uint64_t *candidates;
+    size_t count = find_codes(codes, info->bytes, &code, &candidates);
+    free(code.bytes);
+
+    /* One walk over the codes up to the last candidate */
+    reader_init(&rd, codes, info->bytes);
+    size_t index = 0;
+    for (size_t j = 0; j < count; j++) {
+        while (rd.pos < candidates[j] && index < info->chars) {
+            if (reader_next(&rd, table) < 0) {
+                r->err = -1;
+                break;
+            }
+            index++;
+        }
+        if (r->err != 0 || index + job->m > info->chars) {
+            break;
+        }
+        if (rd.pos == candidates[j]) {
+            add_match(r, info->out_pos + index);
+        }
+    }
+    free(candidates);
+    return true;
+}
+
+/*
+ * Reports the matches that start in block i and end in the blocks
+ * after it, in order. Returns -1 if the block is invalid.
+ */
+static int cross_matches(const search_job *job, size_t i, search_found found, void *context,
+                         int64_t *total) {
+    const block_info *info = &job->blocks[i];
+    block_result *r = &job->results[i];
+    size_t m = job->m;
+    if (m < 2 || info->chars == 0) {
+        return 0;
+    }
+
+    /* The characters after the block, which may take the heads of
+       several short blocks */
+    unsigned char *next = malloc(m - 1);
+    size_t next_len = 0;
+    for (size_t j = i + 1; j < job->count && next_len < m - 1; j++) {
+        size_t take = job->results[j].head_len;
+        take = take < m - 1 - next_len ? take : m - 1 - next_len;
+        memcpy(next + next_len, job->results[j].head, take);
+        next_len += take;
+    }
+
+    /* A match with k characters in this block, from the earliest */
+    int err = 0;
+    size_t most = m - 1 < info->chars ? m - 1 : info->chars;
+    for (size_t k = most; k >= 1 && err == 0; k--) {
+        if (m - k > next_len || memcmp(next, job->pattern + k, m - k) != 0) {
+            continue;
+        }
+        if (!r->tail_known) {
+            if (!tail_possible(job, info, k)) {
+                continue;
+            }
+            err = read_tail(job, info, r);
+        }
+        if (err == 0 && memcmp(r->tail + r->tail_len - k, job->pattern, k) == 0) {
+            found(context, info->out_pos + info->chars - k);
+            (*total)++;
+        }
+    }
+
+    free(next);
+    return err;
+}
+
+/*
+ * Returns whether the codes of a Huffman block may end with the first k
+ * characters of the pattern, from its last bits. The last code ends in
+ * the last byte, followed by 0 bits of padding.
+ */
+static bool tail_possible(const search_job *job, const block_info *info, size_t k) {
+    const unsigned char *codes = job->data + info->code_pos;
+    uint64_t bits = (uint64_t)info->bytes * 8;
+    pattern_code code;
+    if (!code_pattern(block_table(job, info), job->pattern, k, &code)) {
+        return false;
+    }
+
+    bool possible = false;
+    for (int pad = 0; pad < 8 && !possible && code.length + pad <= bits; pad++) {
+        uint64_t end = bits - pad;
+        if (pad > 0 && bit_peek(codes, info->bytes, end) >> (64 - pad) != 0) {
+            break;
+        }
+        possible = bits_equal(codes, info->bytes, end - code.length, &code);
+    }
+    free(code.bytes);
+    return possible;
+}
+
+/* Walks all codes of a Huffman block to get its last characters */
+static int read_tail(const search_job *job, const block_info *info, block_result *r) {
+    const huffman_table *table = block_table(job, info);
+    size_t keep = job->m - 1 < info->chars ? job->m - 1 : info->chars;
+    code_reader rd;
+
+    reader_init(&rd, job->data + info->code_pos, info->bytes);
+    for (size_t index = 0; index < info->chars; index++) {
+        int symbol = reader_next(&rd, table);
+        if (symbol < 0) {
+            return -1;
+        }
+        if (index + keep >= info->chars) {
+            r->tail[index + keep - info->chars] = symbol;
+        }
+    }
+    r->tail_len = keep;
+    r->tail_known = true;
+    return 0;
+}
+
+/* Codes the m characters with the table. Returns false if one of them
+   has no code. The user is responsible for deallocating code->bytes. */
+static bool code_pattern(const huffman_table *table, const unsigned char *pattern, size_t m,
+                         pattern_code *code) {
+    for (size_t i = 0; i < m; i++) {
+        if (table->length[pattern[i]] == 0) {
+            return false;
+        }
+    }
+
+    /* With room for the 8 bytes that bit_peek reads past the end */
+    code->size = (m * HUFF_MAX_CODE_LEN + 7) / 8 + 8;
+    code->bytes = calloc(code->size, 1);
+    code->length = 0;
+    for (size_t i = 0; i < m; i++) {
+        int length = table->length[pattern[i]];
+        uint32_t bits = table->code[pattern[i]];
+        for (int k = length - 1; k >= 0; k--, code->length++) {
+            if ((bits >> k) & 1) {
+                code->bytes[code->length / 8] |= 0x80 >> (code->length % 8);
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Stores a newly allocated array of the bit positions in codes where
+ * the code bits occur in *found, in order, and returns their number.
+ * The code starts at one of 8 bit offsets in a byte, and for each the
+ * first two whole bytes of the code at that offset are a key in a
+ * table of 65536 entries. One pass over the byte pairs of the codes
+ * then finds the few places to check bit by bit.
+ */
+static size_t find_codes(const unsigned char *codes, size_t size, const pattern_code *code,
+                         uint64_t **found) {
+    uint64_t bits = (uint64_t)size * 8;
+    size_t count = 0;
+    size_t capacity = 16;
+    *found = malloc(capacity * sizeof(uint64_t));
+    if (code->length > bits || size < 2) {
+        return 0;
+    }
+
+    unsigned char *shifts = calloc(1 << 16, 1);
+    for (int s = 0; s < 8; s++) {
+        uint64_t first = (8 - s) % 8;
+        shifts[bit_peek(code->bytes, code->size, first) >> 48] |= 1 << s;
+    }
+
+    for (size_t b = 0; b + 1 < size; b++) {
+        unsigned mask = shifts[codes[b] << 8 | codes[b + 1]];
+        if (mask == 0) {
+            continue;
+        }
+        /* In order of position, from 7 bits before the byte to it */
+        for (int t = 1; t <= 8; t++) {
+            int s = t % 8;
+            uint64_t first = (8 - s) % 8;
+            uint64_t at = (uint64_t)b * 8;
+            if ((mask >> s) & 1 && at >= first && at - first + code->length <= bits &&
+                bits_equal(codes, size, at - first, code)) {
+                add_position(found, &count, &capacity, at - first);
+            }
+        }
+    }
+
+    free(shifts);
+    return count;
+}
+
+/* Returns whether the code bits occur at bit pos of data */
+static bool bits_equal(const unsigned char *data, size_t size, uint64_t pos,
+                       const pattern_code *code) {
+    for (uint64_t off = 0; off < code->length; off += 32) {
+        int width = code->length - off < 32 ? code->length - off : 32;
+        if (bit_peek(data, size, pos + off) >> (64 - width) !=
+            bit_peek(code->bytes, code->size, off) >> (64 - width)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void add_match(block_result *r, uint64_t offset) {
+    if (r->capacity == 0) {
+        r->capacity = 16;
+        r->matches = malloc(r->capacity * sizeof(uint64_t));
+    }
+    add_position(&r->matches, &r->count, &r->capacity, offset);
+}
+
+static void add_position(uint64_t **positions, size_t *count, size_t *capacity, uint64_t pos) {
+    if (*count == *capacity) {
+        *capacity *= 2;
+        *positions = realloc(*positions, *capacity * sizeof(uint64_t));
+    }
+    (*positions)[(*count)++] = pos;
+}
+
+static const huffman_table *block_table(const search_job *job, const block_info *info) {
+    return info->table != NULL ? info->table : job->model;
+}
+
+static void reader_init(code_reader *rd, const unsigned char *data, size_t size) {
+    rd->data = data;
+    rd->size = size;
+    rd->byte = 0;
+    rd->acc = 0;
+    rd->bits = 0;
+    rd->pos = 0;
+}
+
+/* Returns the next character, or -1 if the code is invalid or the
+   codes end */
+static inline int reader_next(code_reader *rd, const huffman_table *table) {
+    bit_refill(rd->data, rd->size, &rd->byte, &rd->acc, &rd->bits);
+    int length;
+    int symbol = huffman_table_decode(table, rd->acc, &length);
+    if (symbol < 0 || symbol > 255 || length > rd->bits) {
+        return -1;
+    }
+    rd->acc <<= length;
+    rd->bits -= length;
+    rd->pos += length;
+    return symbol;
+}
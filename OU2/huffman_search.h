@@ -0,0 +1,45 @@
+#ifndef HUFFMAN_SEARCH
+#define HUFFMAN_SEARCH
+
+#include <stddef.h>
+#include <stdint.h>
+#include "huffman_table.h"
+
+/*
+ * Search for a string in an encoded file without decoding it.
+ *
+ * In a block coded with a Huffman table, without BLOCK_RLE, the string
+ * can only occur where the codes of its characters under that table
+ * occur in the bits, so the pattern is coded with the table of each
+ * block and the codes are searched for it at every bit offset. A block
+ * whose table has no code for a character of the pattern can not hold
+ * it and is not read at all. Each place where the bits match is a
+ * match if it is at the start of a code, which is checked by walking
+ * the codes of the block up to it, without writing any characters.
+ * Stored blocks are searched as they are, and the blocks that are
+ * coded in other ways are decoded one at a time and searched.
+ *
+ * Matches may span blocks. They are found from the first characters of
+ * the following blocks, and the last characters of a Huffman block are
+ * only decoded when its last bits match the rest of the pattern.
+ *
+ * The checksums of blocks are only verified for the blocks that are
+ * decoded.
+ */
+
+/* Called with the offset in the decoded file of each match */
+typedef void (*search_found)(void *context, uint64_t offset);
+
+/*
+ * Searches the size bytes of an encoded file in data for the m > 0
+ * characters of pattern, and calls found for each match in order of
+ * offset, overlapping ones included. model is the table the file was
+ * encoded with, or NULL if it stores its model. The blocks are searched
+ * on up to threads threads, 0 for one per processor. Returns the number
+ * of matches, or -1 if the file is invalid.
+ */
+int64_t huffman_search(const huffman_table *model, const unsigned char *data, size_t size,
+                       const unsigned char *pattern, size_t m, int threads,
+                       search_found found, void *context);
+
+#endif
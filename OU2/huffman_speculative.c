@@ -0,0 +1,215 @@
+#include "huffman_speculative.h"
+#include "bit_reader.h"
+#include "parallel.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A part of the codes, decoded from its first bit.
+ *
+ * start    The first bit of the part.
+ * stop     The first bit of the next part, or the end of the codes.
+ * end      The bit after the last code decoded, at or after stop unless
+ *          the decoding ran into an invalid code.
+ * symbols  The characters decoded, count of them. The first part is
+ *          decoded straight into the output.
+ */
+typedef struct {
+    uint64_t start;
+    uint64_t stop;
+    uint64_t end;
+    unsigned char *symbols;
+    size_t count;
+} part;
+
+typedef struct {
+    const huffman_table *table;
+    const unsigned char *data;
+    size_t size;
+    unsigned char *out;
+    size_t n;
+    int min_length;
+    part *parts;
+} speculative_job;
+
+static void decode_part(void *context, size_t i);
+static size_t decode_range(const speculative_job *job, uint64_t *pos, uint64_t stop,
+                           unsigned char *out, size_t capacity);
+static inline int decode_at(const speculative_job *job, uint64_t pos, int *length);
+
+int huffman_decode_speculative(const huffman_table *table, const unsigned char *data,
+                               size_t size, unsigned char *out, size_t n, int threads) {
+    speculative_job job = {table, data, size, out, n, 0, NULL};
+    for (int len = 1; len <= table->max_length && job.min_length == 0; len++) {
+        if (table->count[len] > 0) {
+            job.min_length = len;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (job.min_length == 0) {
+        return -1;
+    }
+
+    if (threads <= 0) {
+        threads = parallel_processors();
+    }
+    size_t count = size / SPECULATIVE_MIN_PART;
+    if (count > (size_t)threads) {
+        count = threads;
+    }
+    if (count == 0) {
+        count = 1;
+    }
+
+    uint64_t bits = (uint64_t)size * 8;
+    job.parts = calloc(count, sizeof(part));
+    for (size_t i = 0; i < count; i++) {
+        job.parts[i].start = bits / count * i;
+        job.parts[i].stop = i + 1 < count ? bits / count * (i + 1) : bits;
+    }
+
+    parallel_for(count, threads, decode_part, &job);
+
+    /* The first part is true from its start, and each following one is
+       joined where the true codes meet its codes */
+    size_t done = job.parts[0].count;
+    uint64_t pos = job.parts[0].end;
+    int err = 0;
+    for (size_t i = 1; i < count && done < n && err == 0; i++) {
+        const part *p = &job.parts[i];
+        uint64_t q = p->start;
+        size_t skipped = 0;
+        int length = 0;
+
+        while (pos != q && done < n) {
+            if (q < pos && q < p->end) {
+                decode_at(&job, q, &length);
+                q += length;
+                skipped++;
+            } else if (q < pos) {
+                break;
+            } else {
+                int symbol = decode_at(&job, pos, &length);
+                if (symbol < 0) {
+                    err = -1;
+                    break;
+                }
+                out[done++] = symbol;
+                pos += length;
+            }
+        }
+        if (err != 0 || done == n) {
+            break;
+        }
+
+        if (pos == q) {
+            size_t take = p->count - skipped;
+            if (take > n - done) {
+                take = n - done;
+            }
+            memcpy(out + done, p->symbols + skipped, take);
+            done += take;
+            pos = p->end;
+        } else {
+            /* The part never met the true codes, so it is decoded again */
+            done += decode_range(&job, &pos, p->stop, out + done, n - done);
+        }
+    }
+
+    /* The rest, where a part ended early on what turned out to be an
+       invalid code or the codes end */
+    if (err == 0 && done < n) {
+        done += decode_range(&job, &pos, bits, out + done, n - done);
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        free(job.parts[i].symbols);
+    }
+    free(job.parts);
+    return err == 0 && done == n ? 0 : -1;
+}
+
+static void decode_part(void *context, size_t i) {
+    speculative_job *job = context;
+    part *p = &job->parts[i];
+    unsigned char *out;
+    size_t capacity;
+
+    if (i == 0) {
+        out = job->out;
+        capacity = job->n;
+    } else {
+        /* No code is shorter than min_length */
+        capacity = (p->stop - p->start) / job->min_length + 1;
+        if (capacity > job->n) {
+            capacity = job->n;
+        }
+        out = p->symbols = malloc(capacity);
+        if (out == NULL) {
+            p->end = p->start;
+            return;
+        }
+    }
+
+    p->end = p->start;
+    p->count = decode_range(job, &p->end, p->stop, out, capacity);
+}
+
+/*
+ * Decodes codes from the bit *pos until it reaches stop, the codes are
+ * invalid or capacity characters are written to out. Stores the bit
+ * after the last code in *pos and returns the number of characters.
+ */
+static size_t decode_range(const speculative_job *job, uint64_t *pos, uint64_t stop,
+                           unsigned char *out, size_t capacity) {
+    const unsigned char *data = job->data;
+    size_t size = job->size;
+    uint64_t p = *pos;
+    size_t count = 0;
+    if (p >= stop) {
+        return 0;
+    }
+
+    /* The accumulator starts at the byte of the first bit, whose bits
+       before it are shifted out */
+    size_t byte = p >> 3;
+    uint64_t acc = 0;
+    int bits = 0;
+    bit_refill(data, size, &byte, &acc, &bits);
+    acc <<= p & 7;
+    bits -= p & 7;
+
+    /* A refill leaves at least 56 bits, which hold two codes, as in
+       huffman_decode */
+    while (p < stop && count < capacity) {
+        bit_refill(data, size, &byte, &acc, &bits);
+        for (int k = 0; k < 2 && p < stop && count < capacity; k++) {
+            int length;
+            int symbol = huffman_table_decode(job->table, acc, &length);
+            if (symbol < 0 || symbol > 255 || length > bits) {
+                *pos = p;
+                return count;
+            }
+            out[count++] = symbol;
+            acc <<= length;
+            bits -= length;
+            p += length;
+        }
+    }
+
+    *pos = p;
+    return count;
+}
+
+/* Decodes the code at bit pos. Returns -1 if it is invalid or does not
+   end within the codes. */
+static inline int decode_at(const speculative_job *job, uint64_t pos, int *length) {
+    int symbol = huffman_table_decode(job->table, bit_peek(job->data, job->size, pos), length);
+    if (symbol < 0 || symbol > 255 || pos + *length > (uint64_t)job->size * 8) {
+        return -1;
+    }
+    return symbol;
+}
@@ -0,0 +1,37 @@
+#ifndef HUFFMAN_SPECULATIVE
+#define HUFFMAN_SPECULATIVE
+
+#include <stddef.h>
+#include "huffman_table.h"
+
+/*
+ * Parallel decoding of one long run of codes that has no index of
+ * where codes start, such as the files from before container.h.
+ *
+ * The codes are cut into parts at evenly spaced bits, and every part is
+ * decoded on its own thread as if a code started at its first bit. A
+ * Huffman code synchronizes itself: a decoder that starts inside a code
+ * reads garbage for a few codes, but soon ends a code where the true
+ * decoding ends one too, and from there on the two agree. The parts are
+ * then joined in order. The true decoding of the end of each part goes
+ * on into the next one only until it meets a code boundary of that
+ * part, and the characters of the part from there on are kept. A part
+ * where the two never meet is decoded again from the true boundary, so
+ * the result is always that of huffman_decode, only the speed depends
+ * on how soon the code synchronizes.
+ */
+
+/* Parts are at least this many bytes of codes, since a thread costs
+   more than it gains on less */
+#define SPECULATIVE_MIN_PART (256 * 1024)
+
+/*
+ * Decodes n characters from the size bytes of codes in data into out,
+ * as huffman_decode does, on up to threads threads, 0 for one per
+ * processor. Returns 0 on success and -1 if the codes are invalid or
+ * too few.
+ */
+int huffman_decode_speculative(const huffman_table *table, const unsigned char *data,
+                               size_t size, unsigned char *out, size_t n, int threads);
+
+#endif
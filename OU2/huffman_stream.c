@@ -0,0 +1,752 @@
+#include "huffman_stream.h"
+#include "huffman_block.h"
+#include "container.h"
+#include "byte_order.h"
+#include "crc32c.h"
+#include "rle.h"
+#include "bwt.h"
+#include "tans.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Where the decoder is in the file, in the order of the fields */
+enum {
+    S_HEADER,
+    S_MODEL,
+    S_BLOCK_TABLE,
+    S_BLOCK,
+    S_CRC,
+    S_INDEX,
+    S_TABLE,
+    S_REF,
+    S_ANS_TABLE,
+    S_SIZE,
+    S_STORED,
+    S_CODES,
+    S_SKIP,
+    S_BWT_OUT,
+    S_BLOCK_END,
+    S_END,
+    S_ERROR
+};
+
+/* The stage holds the longest of the header fields, a table */
+#define STAGE_BYTES (TANS_TABLE_MAX_BYTES > HUFF_TABLE_MAX_BYTES ? TANS_TABLE_MAX_BYTES \
+                                                                 : HUFF_TABLE_MAX_BYTES)
+
+/* A table that a later BLOCK_REUSE may refer to, kept as its code
+   lengths and rebuilt when it is used */
+typedef struct {
+    uint32_t block;
+    bool rle;
+    unsigned char length[HUFF_SYMBOLS];
+} recent_table;
+
+/*
+ * stage        A header field that arrives in pieces, staged bytes of it.
+ * seen         The bytes of the file used so far.
+ * blocks_start The value of seen at the first block, and block_start
+ *              at the current one.
+ * table_crc    The CRC-32C of the block table, and blocks_crc that of
+ *              the sizes of the blocks that have been decoded, which
+ *              must be the same at the end.
+ * done         The characters of the blocks before the current one.
+ *
+ * The current block:
+ * chars        The characters left to decode.
+ * code_bytes   The code bytes left to read into acc.
+ * acc, bits    The bit accumulator, whose bits most significant first
+ *              are the next codes, and how many of them are valid.
+ * digit, run   The next digit of a run length, and the repeats of the
+ *              last digit that did not fit in the output yet.
+ * ans          The table of a BLOCK_ANS, allocated at the first one.
+ * ans_state    The states of its decoder, once ans_started.
+ */
+struct stream_decoder {
+    int state;
+    const huffman_table *model;
+    huffman_table stored_model;
+
+    unsigned char stage[STAGE_BYTES];
+    size_t staged;
+
+    uint64_t characters;
+    uint64_t block_bytes;
+    uint32_t count;
+    uint32_t model_id;
+    uint64_t skip;
+    uint64_t seen;
+    uint64_t blocks_start;
+    uint64_t block_start;
+    uint32_t table_crc;
+    uint32_t blocks_crc;
+    uint64_t done;
+    uint32_t index;
+
+    int type;
+    bool checksum;
+    bool rle;
+    uint32_t crc;
+    uint32_t expected_crc;
+    uint32_t bwt_index[BWT_CHAINS];
+    const huffman_table *table;
+    huffman_table block_table;
+    size_t block_chars;
+    size_t chars;
+    uint32_t code_bytes;
+
+    uint64_t acc;
+    int bits;
+    int digit;
+    size_t run;
+    unsigned char run_char;
+    bool has_last;
+
+    tans_table *ans;
+    uint32_t ans_state[TANS_STATES];
+    bool ans_started;
+
+    recent_table recent[BLOCK_REUSE_TABLES];
+    int recent_count;
+
+    unsigned char *bwt_last;
+    unsigned char *bwt_out;
+    size_t bwt_pos;
+};
+
+static bool step(stream_decoder *d, const unsigned char **in, const unsigned char *in_end,
+                 unsigned char **out, unsigned char *out_end);
+static bool start_block(stream_decoder *d);
+static int field_after_crc(const stream_decoder *d);
+static bool start_codes(stream_decoder *d);
+static int decode_codes(stream_decoder *d, const unsigned char **in,
+                        const unsigned char *in_end, unsigned char **out,
+                        unsigned char *out_end);
+static int decode_ans(stream_decoder *d, const unsigned char **in,
+                      const unsigned char *in_end, unsigned char **out,
+                      unsigned char *out_end);
+static inline void fill_acc(const unsigned char **p, const unsigned char *in_end,
+                            uint64_t *acc, int *bits, uint32_t *code_bytes);
+static bool stage_bytes(stream_decoder *d, const unsigned char **in,
+                        const unsigned char *in_end, size_t n);
+static int stage_table(stream_decoder *d, const unsigned char **in,
+                       const unsigned char *in_end, huffman_table *table);
+static void remember_table(stream_decoder *d);
+static bool fail(stream_decoder *d);
+
+stream_decoder *stream_decoder_new(const huffman_table *model) {
+    stream_decoder *d = calloc(1, sizeof(stream_decoder));
+    if (d != NULL) {
+        d->state = S_HEADER;
+        d->model = model;
+    }
+    return d;
+}
+
+void stream_decoder_free(stream_decoder *d) {
+    if (d != NULL) {
+        free(d->bwt_last);
+        free(d->bwt_out);
+        free(d->ans);
+        free(d);
+    }
+}
+
+int stream_decode(stream_decoder *d, const unsigned char *in, size_t in_size,
+                  size_t *consumed, unsigned char *out, size_t out_size, size_t *produced) {
+    const unsigned char *p = in;
+    unsigned char *o = out;
+
+    for (;;) {
+        const unsigned char *before = p;
+        bool more = step(d, &p, in + in_size, &o, out + out_size);
+        d->seen += p - before;
+        if (!more) {
+            break;
+        }
+    }
+
+    *consumed = p - in;
+    *produced = o - out;
+    return d->state == S_ERROR ? STREAM_ERROR : d->state == S_END ? STREAM_END : STREAM_MORE;
+}
+
+int stream_decode_file(FILE *process_file_p, FILE *out_file_p, const huffman_table *model) {
+    stream_decoder *d = stream_decoder_new(model);
+    unsigned char *in = malloc(STREAM_CHUNK);
+    unsigned char *out = malloc(STREAM_CHUNK);
+    if (d == NULL || in == NULL || out == NULL) {
+        stream_decoder_free(d);
+        free(in);
+        free(out);
+        return -1;
+    }
+
+    size_t n = 0;
+    size_t pos = 0;
+    bool eof = false;
+    int result;
+    int err = 0;
+    for (;;) {
+        if (pos == n && !eof) {
+            n = fread(in, 1, STREAM_CHUNK, process_file_p);
+            pos = 0;
+            eof = n < STREAM_CHUNK;
+        }
+
+        size_t consumed, produced;
+        result = stream_decode(d, in + pos, n - pos, &consumed, out, STREAM_CHUNK, &produced);
+        pos += consumed;
+        if (produced > 0 && fwrite(out, 1, produced, out_file_p) != produced) {
+            err = -1;
+        }
+        if (result != STREAM_MORE || err) {
+            break;
+        }
+        /* Out of input, and not just out of room */
+        if (pos == n && eof && produced < STREAM_CHUNK) {
+            result = STREAM_ERROR;
+            break;
+        }
+    }
+
+    if (result != STREAM_END || pos < n || ferror(process_file_p) ||
+        (!eof && fgetc(process_file_p) != EOF)) {
+        err = -1;
+    }
+
+    stream_decoder_free(d);
+    free(in);
+    free(out);
+    return err;
+}
+
+/* Takes the next step of the state machine. Returns false when it can
+   not go on without more input or more room for output, or when the
+   file has ended or is invalid. */
+static bool step(stream_decoder *d, const unsigned char **in, const unsigned char *in_end,
+                 unsigned char **out, unsigned char *out_end) {
+    const unsigned char *s = d->stage;
+    int r;
+    size_t n;
+
+    switch (d->state) {
+    case S_HEADER:
+        if (!stage_bytes(d, in, in_end, CONTAINER_HEADER_BYTES)) {
+            return false;
+        }
+        d->staged = 0;
+        if (memcmp(s, CONTAINER_MAGIC, 4) != 0 || s[4] != CONTAINER_VERSION ||
+            (s[5] & ~CONTAINER_MODEL_TABLE) != 0 || load_le64(s + 14) % 8 != 0) {
+            return fail(d);
+        }
+        d->characters = load_le64(s + 6);
+        d->block_bytes = load_le64(s + 14) / 8;
+        d->count = load_le32(s + 22);
+        d->model_id = load_le32(s + 26);
+        d->skip = 8 * (uint64_t)d->count;
+        if (s[5] & CONTAINER_MODEL_TABLE) {
+            d->state = S_MODEL;
+        } else if (d->model == NULL || container_model_id(d->model) != d->model_id) {
+            return fail(d);
+        } else {
+            d->state = S_BLOCK_TABLE;
+        }
+        return true;
+
+    case S_MODEL:
+        if ((r = stage_table(d, in, in_end, &d->stored_model)) <= 0) {
+            return r < 0 ? fail(d) : false;
+        }
+        d->model = &d->stored_model;
+        if (container_model_id(d->model) != d->model_id) {
+            return fail(d);
+        }
+        d->state = S_BLOCK_TABLE;
+        return true;
+
+    case S_BLOCK_TABLE:
+        /* The blocks describe themselves, so the table is not kept, and
+           only its CRC is checked against the blocks at the end */
+        if (d->skip > 0) {
+            n = (uint64_t)(in_end - *in) < d->skip ? (size_t)(in_end - *in) : d->skip;
+            d->table_crc = crc32c(d->table_crc, *in, n);
+            *in += n;
+            d->skip -= n;
+            return d->skip == 0;
+        }
+        d->blocks_start = d->seen;
+        d->block_start = d->seen;
+        d->state = S_BLOCK;
+        return true;
+
+    case S_BLOCK:
+        if (d->done == d->characters) {
+            if (d->index != d->count || d->seen - d->blocks_start != d->block_bytes ||
+                d->blocks_crc != d->table_crc) {
+                return fail(d);
+            }
+            d->state = S_END;
+            return false;
+        }
+        if (d->index == d->count || !stage_bytes(d, in, in_end, 5)) {
+            return d->index == d->count ? fail(d) : false;
+        }
+        d->staged = 0;
+        return start_block(d);
+
+    case S_CRC:
+        if (!stage_bytes(d, in, in_end, 4)) {
+            return false;
+        }
+        d->staged = 0;
+        d->expected_crc = load_le32(s);
+        d->state = field_after_crc(d);
+        return true;
+
+    case S_INDEX:
+        if (!stage_bytes(d, in, in_end, 4 * BWT_CHAINS)) {
+            return false;
+        }
+        d->staged = 0;
+        for (int j = 0; j < BWT_CHAINS; j++) {
+            d->bwt_index[j] = load_le32(s + 4 * j);
+        }
+        d->state = S_TABLE;
+        return true;
+
+    case S_TABLE:
+        if ((r = stage_table(d, in, in_end, &d->block_table)) <= 0) {
+            return r < 0 ? fail(d) : false;
+        }
+        if (d->type == BLOCK_TABLE) {
+            remember_table(d);
+        }
+        d->table = &d->block_table;
+        d->state = S_SIZE;
+        return true;
+
+    case S_REF:
+        if (!stage_bytes(d, in, in_end, 4)) {
+            return false;
+        }
+        d->staged = 0;
+        for (int k = 0; k < d->recent_count; k++) {
+            const recent_table *t = &d->recent[k];
+            if (t->block == load_le32(s) && !t->rle) {
+                huffman_table_from_lengths(&d->block_table, t->length);
+                d->table = &d->block_table;
+                d->state = S_SIZE;
+                return true;
+            }
+        }
+        return fail(d);
+
+    case S_ANS_TABLE:
+        if (d->ans == NULL && (d->ans = malloc(sizeof(tans_table))) == NULL) {
+            return fail(d);
+        }
+        if (!stage_bytes(d, in, in_end, TANS_TABLE_BITMAP_BYTES) ||
+            !stage_bytes(d, in, in_end, tans_table_stored_size(s))) {
+            return false;
+        }
+        n = d->staged;
+        d->staged = 0;
+        if (tans_table_read(d->ans, s, n) != n) {
+            return fail(d);
+        }
+        d->state = S_SIZE;
+        return true;
+
+    case S_SIZE:
+        if (!stage_bytes(d, in, in_end, 4)) {
+            return false;
+        }
+        d->staged = 0;
+        d->code_bytes = load_le32(s);
+        return start_codes(d);
+
+    case S_STORED:
+        n = d->chars;
+        n = (size_t)(in_end - *in) < n ? (size_t)(in_end - *in) : n;
+        n = (size_t)(out_end - *out) < n ? (size_t)(out_end - *out) : n;
+        memcpy(*out, *in, n);
+        if (d->checksum) {
+            d->crc = crc32c(d->crc, *out, n);
+        }
+        *in += n;
+        *out += n;
+        d->chars -= n;
+        if (d->chars == 0) {
+            d->state = S_BLOCK_END;
+        }
+        return n > 0 || d->chars == 0;
+
+    case S_CODES: {
+        const unsigned char *in_before = *in;
+        unsigned char *start;
+        unsigned char *end;
+        if (d->type == BLOCK_BWT) {
+            start = d->bwt_last + d->bwt_pos;
+            end = d->bwt_last + d->block_chars;
+        } else {
+            start = *out;
+            end = out_end;
+        }
+        unsigned char *pos = start;
+        r = d->type == BLOCK_ANS ? decode_ans(d, in, in_end, &pos, end)
+                                 : decode_codes(d, in, in_end, &pos, end);
+        if (r != 0) {
+            return fail(d);
+        }
+
+        if (d->type == BLOCK_BWT) {
+            d->bwt_pos = pos - d->bwt_last;
+        } else {
+            if (d->checksum) {
+                d->crc = crc32c(d->crc, start, pos - start);
+            }
+            *out = pos;
+        }
+        if (d->chars > 0) {
+            return pos != start || *in != in_before;
+        }
+
+        if (d->type == BLOCK_BWT) {
+            mtf_decode(d->bwt_last, d->block_chars);
+            d->bwt_out = malloc(d->block_chars > 0 ? d->block_chars : 1);
+            if (d->bwt_out == NULL ||
+                bwt_inverse(d->bwt_last, d->block_chars, d->bwt_index, d->bwt_out) != 0) {
+                return fail(d);
+            }
+            free(d->bwt_last);
+            d->bwt_last = NULL;
+            d->bwt_pos = 0;
+        }
+        d->state = S_SKIP;
+        return true;
+    }
+
+    case S_SKIP:
+        /* The padding of the last code byte has been read, but a
+           corrupt block may have bytes left over */
+        n = (size_t)(in_end - *in) < d->code_bytes ? (size_t)(in_end - *in) : d->code_bytes;
+        *in += n;
+        d->code_bytes -= n;
+        if (d->code_bytes > 0) {
+            return n > 0;
+        }
+        d->state = d->type == BLOCK_BWT ? S_BWT_OUT : S_BLOCK_END;
+        return true;
+
+    case S_BWT_OUT:
+        n = d->block_chars - d->bwt_pos;
+        n = (size_t)(out_end - *out) < n ? (size_t)(out_end - *out) : n;
+        memcpy(*out, d->bwt_out + d->bwt_pos, n);
+        if (d->checksum) {
+            d->crc = crc32c(d->crc, *out, n);
+        }
+        *out += n;
+        d->bwt_pos += n;
+        if (d->bwt_pos < d->block_chars) {
+            return n > 0;
+        }
+        free(d->bwt_out);
+        d->bwt_out = NULL;
+        d->state = S_BLOCK_END;
+        return true;
+
+    case S_BLOCK_END: {
+        if (d->checksum && d->crc != d->expected_crc) {
+            return fail(d);
+        }
+        unsigned char entry[8];
+        store_le32(entry, d->block_chars);
+        store_le32(entry + 4, d->seen - d->block_start);
+        d->blocks_crc = crc32c(d->blocks_crc, entry, sizeof(entry));
+        d->block_start = d->seen;
+        d->done += d->block_chars;
+        d->index++;
+        d->state = S_BLOCK;
+        return true;
+    }
+    }
+
+    return false;
+}
+
+/* Reads the type and the characters of a block from the stage */
+static bool start_block(stream_decoder *d) {
+    d->type = d->stage[0] & ~(BLOCK_CHECKSUM | BLOCK_RLE);
+    d->checksum = d->stage[0] & BLOCK_CHECKSUM;
+    d->rle = d->stage[0] & BLOCK_RLE;
+    d->block_chars = load_le32(d->stage + 1);
+    d->chars = d->block_chars;
+    d->crc = 0;
+
+    if (d->type != BLOCK_MODEL && d->type != BLOCK_TABLE && d->type != BLOCK_STORED &&
+        d->type != BLOCK_BWT && d->type != BLOCK_REUSE && d->type != BLOCK_ANS) {
+        return fail(d);
+    }
+    if ((d->rle && d->type != BLOCK_TABLE) || d->block_chars > d->characters - d->done ||
+        (d->type == BLOCK_BWT && d->block_chars > BWT_MAX_BLOCK)) {
+        return fail(d);
+    }
+
+    d->table = d->model;
+    d->state = d->checksum ? S_CRC : field_after_crc(d);
+    return true;
+}
+
+/* Returns the state of the field of the current block that follows the
+   checksum */
+static int field_after_crc(const stream_decoder *d) {
+    switch (d->type) {
+    case BLOCK_BWT:
+        return S_INDEX;
+    case BLOCK_TABLE:
+        return S_TABLE;
+    case BLOCK_REUSE:
+        return S_REF;
+    case BLOCK_ANS:
+        return S_ANS_TABLE;
+    default:
+        return S_SIZE;
+    }
+}
+
+/* Sets up the decoding of the codes once their size is known */
+static bool start_codes(stream_decoder *d) {
+    if (d->type == BLOCK_STORED) {
+        if (d->code_bytes != d->block_chars) {
+            return fail(d);
+        }
+        d->state = S_STORED;
+        return true;
+    }
+
+    d->acc = 0;
+    d->bits = 0;
+    d->digit = 0;
+    d->run = 0;
+    d->has_last = false;
+    d->ans_started = false;
+    if (d->type == BLOCK_BWT) {
+        d->bwt_last = malloc(d->block_chars > 0 ? d->block_chars : 1);
+        d->bwt_pos = 0;
+        if (d->bwt_last == NULL) {
+            return fail(d);
+        }
+    }
+    d->state = S_CODES;
+    return true;
+}
+
+/*
+ * Decodes the codes of the current block into out until the block is
+ * done, the input ends or out is full. Plain blocks code characters,
+ * BLOCK_RLE blocks run lengths of the last character and BLOCK_BWT
+ * blocks runs of zeros, see rle.h. Returns -1 if the codes are invalid.
+ */
+static int decode_codes(stream_decoder *d, const unsigned char **in,
+                        const unsigned char *in_end, unsigned char **out,
+                        unsigned char *out_end) {
+    const huffman_table *table = d->table;
+    const unsigned char *p = *in;
+    unsigned char *o = *out;
+    uint64_t acc = d->acc;
+    int bits = d->bits;
+    size_t chars = d->chars;
+    uint32_t code_bytes = d->code_bytes;
+    bool runs = d->rle || d->type == BLOCK_BWT;
+    int err = 0;
+
+    while (chars > 0) {
+        if (d->run > 0) {
+            size_t n = (size_t)(out_end - o) < d->run ? (size_t)(out_end - o) : d->run;
+            memset(o, d->run_char, n);
+            o += n;
+            chars -= n;
+            d->run -= n;
+            if (d->run > 0) {
+                break;
+            }
+            continue;
+        }
+        if (o == out_end) {
+            break;
+        }
+
+        fill_acc(&p, in_end, &acc, &bits, &code_bytes);
+
+        int len;
+        int symbol = huffman_table_decode(table, acc, &len);
+        if (symbol < 0 || len > bits) {
+            /* With fewer bits than the longest code, the rest of the
+               code may come with the next chunk */
+            if (code_bytes == 0 || bits > 56) {
+                err = -1;
+            }
+            break;
+        }
+        acc <<= len;
+        bits -= len;
+
+        if (symbol < RLE_RUNA) {
+            *o++ = symbol;
+            chars--;
+            d->run_char = symbol;
+            d->has_last = true;
+            d->digit = 0;
+            continue;
+        }
+
+        /* Each digit of the run length adds its repeats at once */
+        if (!runs || (d->rle && !d->has_last) || d->digit >= 32) {
+            err = -1;
+            break;
+        }
+        if (d->type == BLOCK_BWT) {
+            d->run_char = 0;
+        }
+        d->run = (size_t)(symbol == RLE_RUNA ? 1 : 2) << d->digit++;
+        if (d->run > chars) {
+            err = -1;
+            break;
+        }
+    }
+
+    *in = p;
+    *out = o;
+    d->acc = acc;
+    d->bits = bits;
+    d->chars = chars;
+    d->code_bytes = code_bytes;
+    return err;
+}
+
+/*
+ * Decodes the codes of the current BLOCK_ANS into out until the block
+ * is done, the input ends or out is full. The states come first, and
+ * are only read once all their bits are there. Returns -1 if the codes
+ * are invalid.
+ */
+static int decode_ans(stream_decoder *d, const unsigned char **in,
+                      const unsigned char *in_end, unsigned char **out,
+                      unsigned char *out_end) {
+    const tans_entry *decode = d->ans->decode;
+    const unsigned char *p = *in;
+    unsigned char *o = *out;
+    uint64_t acc = d->acc;
+    int bits = d->bits;
+    size_t chars = d->chars;
+    uint32_t code_bytes = d->code_bytes;
+    int err = 0;
+
+    while (chars > 0 && o < out_end) {
+        fill_acc(&p, in_end, &acc, &bits, &code_bytes);
+
+        if (!d->ans_started) {
+            if (bits < TANS_STATES * TANS_TABLE_LOG) {
+                if (code_bytes == 0) {
+                    err = -1;
+                }
+                break;
+            }
+            for (int k = 0; k < TANS_STATES; k++) {
+                d->ans_state[k] = acc >> (64 - TANS_TABLE_LOG);
+                acc <<= TANS_TABLE_LOG;
+                bits -= TANS_TABLE_LOG;
+            }
+            d->ans_started = true;
+        }
+
+        uint32_t *state = &d->ans_state[(d->block_chars - chars) % TANS_STATES];
+        tans_entry e = decode[*state];
+        if (e.bits > bits) {
+            if (code_bytes == 0) {
+                err = -1;
+            }
+            break;
+        }
+        *o++ = e.symbol;
+        chars--;
+        *state = e.new_state + (uint32_t)((acc >> 32) >> (32 - e.bits));
+        acc <<= e.bits;
+        bits -= e.bits;
+    }
+
+    *in = p;
+    *out = o;
+    d->acc = acc;
+    d->bits = bits;
+    d->chars = chars;
+    d->code_bytes = code_bytes;
+    return err;
+}
+
+/* Moves code bytes of the current block from the input into acc until
+   it holds more than 56 bits. Only the bytes of this block go into acc.
+   Whole words where they are there, as bit_refill of bit_reader.h
+   does. */
+static inline void fill_acc(const unsigned char **p, const unsigned char *in_end,
+                            uint64_t *acc, int *bits, uint32_t *code_bytes) {
+    size_t avail = (size_t)(in_end - *p) < *code_bytes ? (size_t)(in_end - *p) : *code_bytes;
+    if (*bits <= 56 && avail >= 8) {
+        *acc |= load_be64(*p) >> *bits;
+        int take = (63 - *bits) >> 3;
+        *p += take;
+        *code_bytes -= take;
+        *bits += take * 8;
+    }
+    while (*bits <= 56 && *code_bytes > 0 && *p < in_end) {
+        *acc |= (uint64_t)*(*p)++ << (56 - *bits);
+        *bits += 8;
+        (*code_bytes)--;
+    }
+}
+
+/* Adds input to the stage until it holds n bytes. Returns true when it
+   does. */
+static bool stage_bytes(stream_decoder *d, const unsigned char **in,
+                        const unsigned char *in_end, size_t n) {
+    if (d->staged < n) {
+        size_t take = n - d->staged;
+        take = (size_t)(in_end - *in) < take ? (size_t)(in_end - *in) : take;
+        memcpy(d->stage + d->staged, *in, take);
+        *in += take;
+        d->staged += take;
+    }
+    return d->staged >= n;
+}
+
+/* Stages a stored table, whose size follows from its bitmap, and
+   builds it. Returns 1 when it is built, 0 if it needs more input and
+   -1 if the table is invalid. */
+static int stage_table(stream_decoder *d, const unsigned char **in,
+                       const unsigned char *in_end, huffman_table *table) {
+    if (!stage_bytes(d, in, in_end, HUFF_TABLE_BITMAP_BYTES) ||
+        !stage_bytes(d, in, in_end, huffman_table_stored_size(d->stage))) {
+        return 0;
+    }
+    size_t size = d->staged;
+    d->staged = 0;
+    return huffman_table_read(table, d->stage, size) == size ? 1 : -1;
+}
+
+/* Keeps the table of the current BLOCK_TABLE in place of the oldest
+   one */
+static void remember_table(stream_decoder *d) {
+    if (d->recent_count < BLOCK_REUSE_TABLES) {
+        d->recent_count++;
+    }
+    memmove(d->recent + 1, d->recent, (d->recent_count - 1) * sizeof(recent_table));
+    d->recent[0].block = d->index;
+    d->recent[0].rle = d->rle;
+    memcpy(d->recent[0].length, d->block_table.length, HUFF_SYMBOLS);
+}
+
+static bool fail(stream_decoder *d) {
+    d->state = S_ERROR;
+    return false;
+}
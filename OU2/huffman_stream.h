@@ -0,0 +1,65 @@
+#ifndef HUFFMAN_STREAM
+#define HUFFMAN_STREAM
+
+#include <stdio.h>
+#include <stddef.h>
+#include "huffman_table.h"
+
+/*
+ * A decoder for encoded files that the caller feeds input chunks of
+ * any size and pulls the result from into output buffers of any size.
+ * The whole file never has to be in memory, and neither does the whole
+ * result.
+ *
+ * The decoder can stop wherever a chunk ends, even inside a header or
+ * a code. Its state is what it needs to resume: the bit accumulator and
+ * the number of pending bits in it, the position in the current block
+ * and its table, and for a BLOCK_ANS the states of tans.h. It also
+ * keeps the code lengths of the last BLOCK_REUSE_TABLES tables, which
+ * are all that the encoder lets a BLOCK_REUSE block refer to. A
+ * BLOCK_BWT block can only be inverted as a whole, so the characters of
+ * such a block are buffered, at most BWT_MAX_BLOCK twice over. Blocks
+ * are decoded in order on the calling thread.
+ */
+
+#define STREAM_ERROR -1
+#define STREAM_MORE 0
+#define STREAM_END 1
+
+/* The size of the chunks of stream_decode_file */
+#define STREAM_CHUNK (64 * 1024)
+
+typedef struct stream_decoder stream_decoder;
+
+/*
+ * Creates a decoder for files encoded with model. model may be NULL if
+ * the files store their model table. The model must stay valid until
+ * the decoder is freed.
+ */
+stream_decoder *stream_decoder_new(const huffman_table *model);
+
+void stream_decoder_free(stream_decoder *d);
+
+/*
+ * Decodes the in_size bytes of in into out, which has room for out_size
+ * bytes. Stores the number of bytes used from in in *consumed and the
+ * number written to out in *produced.
+ *
+ * Returns STREAM_MORE when the decoder needs more input or more room
+ * in out. All of in is used unless out is full. Returns STREAM_END when
+ * the whole file has been decoded and checked. The input after the end
+ * of the file is not used. Returns STREAM_ERROR if the file is invalid
+ * or a checksum differs. After that the decoder can only be freed.
+ */
+int stream_decode(stream_decoder *d, const unsigned char *in, size_t in_size,
+                  size_t *consumed, unsigned char *out, size_t out_size, size_t *produced);
+
+/*
+ * Decodes the rest of process_file_p into out_file_p in chunks of
+ * STREAM_CHUNK bytes. Returns 0 on success and -1 if the file is
+ * invalid, ends early, is followed by more data, or can not be
+ * written.
+ */
+int stream_decode_file(FILE *process_file_p, FILE *out_file_p, const huffman_table *model);
+
+#endif
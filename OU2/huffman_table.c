@@ -0,0 +1,231 @@
+#include "huffman_table.h"
+#include <string.h>
+
+static void collect_lengths(const trie_node *node, int depth, int *length);
+static void limit_lengths(unsigned char *length, const int *depth);
+
+huffman_table *build_huffman_table(const trie_node *root) {
+    int depth[HUFF_SYMBOLS] = {0};
+    unsigned char length[HUFF_SYMBOLS] = {0};
+
+    if (root != NULL && root->left == NULL && root->right == NULL) {
+        /* A single symbol still needs one bit per occurrence */
+        depth[root->key] = 1;
+    } else {
+        collect_lengths(root, 0, depth);
+    }
+    limit_lengths(length, depth);
+
+    huffman_table *table = malloc(sizeof(huffman_table));
+    if (!huffman_table_from_lengths(table, length)) {
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+bool huffman_table_from_lengths(huffman_table *table, const unsigned char *length) {
+    memset(table, 0, sizeof(*table));
+    memcpy(table->length, length, HUFF_SYMBOLS);
+
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        if (length[i] > HUFF_MAX_CODE_LEN) {
+            return false;
+        }
+        if (length[i] > 0) {
+            table->count[length[i]]++;
+            if (length[i] > table->max_length) {
+                table->max_length = length[i];
+            }
+        }
+    }
+
+    /* Check the Kraft inequality so that the codes below fit */
+    uint32_t kraft = 0;
+    for (int len = 1; len <= HUFF_MAX_CODE_LEN; len++) {
+        kraft += (uint32_t)table->count[len] << (HUFF_MAX_CODE_LEN - len);
+    }
+    if (kraft > (1u << HUFF_MAX_CODE_LEN)) {
+        return false;
+    }
+
+    uint32_t code = 0;
+    uint16_t index = 0;
+    for (int len = 1; len <= HUFF_MAX_CODE_LEN; len++) {
+        code = (code + (len > 1 ? table->count[len - 1] : 0)) << (len > 1 ? 1 : 0);
+        table->first_code[len] = code;
+        table->first_index[len] = index;
+        index += table->count[len];
+    }
+
+    uint32_t next_code[HUFF_MAX_CODE_LEN + 1];
+    uint16_t next_index[HUFF_MAX_CODE_LEN + 1];
+    memcpy(next_code, table->first_code, sizeof(next_code));
+    memcpy(next_index, table->first_index, sizeof(next_index));
+
+    for (int symbol = 0; symbol < HUFF_SYMBOLS; symbol++) {
+        int len = length[symbol];
+        if (len == 0) {
+            continue;
+        }
+        table->code[symbol] = next_code[len]++;
+        table->sorted[next_index[len]++] = symbol;
+
+        if (len <= HUFF_LOOKUP_BITS) {
+            int shift = HUFF_LOOKUP_BITS - len;
+            uint32_t first = table->code[symbol] << shift;
+            uint16_t entry = len << HUFF_LOOKUP_SYMBOL_BITS | symbol;
+            for (uint32_t i = 0; i < (1u << shift); i++) {
+                table->lookup[first + i] = entry;
+            }
+        }
+    }
+
+    return true;
+}
+
+huffman_table *huffman_table_from_counts(const uint64_t *counts) {
+    charFrequency frequency[HUFF_SYMBOLS];
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        frequency[i].character = i;
+        frequency[i].frequency = counts[i];
+    }
+
+    trie_pq *pq = process_used_frequency(frequency, HUFF_SYMBOLS);
+    trie_node *root = build_huffman_trie(pq);
+    trie_pq_kill(pq);
+
+    huffman_table *table = build_huffman_table(root);
+    free_huffman_trie(root);
+
+    return table;
+}
+
+size_t huffman_table_size(const huffman_table *table) {
+    int symbols = 0;
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        symbols += table->length[i] > 0;
+    }
+    return HUFF_TABLE_BITMAP_BYTES + (symbols * HUFF_LENGTH_BITS + 7) / 8;
+}
+
+size_t huffman_table_stored_size(const unsigned char *bitmap) {
+    int symbols = 0;
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        symbols += bitmap[i / 8] >> (7 - i % 8) & 1;
+    }
+    return HUFF_TABLE_BITMAP_BYTES + (symbols * HUFF_LENGTH_BITS + 7) / 8;
+}
+
+size_t huffman_table_write(const huffman_table *table, unsigned char *out) {
+    memset(out, 0, HUFF_TABLE_MAX_BYTES);
+
+    size_t bit = HUFF_TABLE_BITMAP_BYTES * 8;
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        if (table->length[i] == 0) {
+            continue;
+        }
+        out[i / 8] |= 0x80 >> (i % 8);
+        for (int j = HUFF_LENGTH_BITS - 1; j >= 0; j--, bit++) {
+            if (table->length[i] >> j & 1) {
+                out[bit / 8] |= 0x80 >> (bit % 8);
+            }
+        }
+    }
+
+    return (bit + 7) / 8;
+}
+
+size_t huffman_table_read(huffman_table *table, const unsigned char *in, size_t size) {
+    unsigned char length[HUFF_SYMBOLS] = {0};
+
+    if (size < HUFF_TABLE_BITMAP_BYTES) {
+        return 0;
+    }
+
+    size_t bit = HUFF_TABLE_BITMAP_BYTES * 8;
+    for (int i = 0; i < HUFF_SYMBOLS; i++) {
+        if (!(in[i / 8] & 0x80 >> (i % 8))) {
+            continue;
+        }
+        if (bit + HUFF_LENGTH_BITS > size * 8) {
+            return 0;
+        }
+        for (int j = 0; j < HUFF_LENGTH_BITS; j++, bit++) {
+            length[i] = length[i] << 1 | (in[bit / 8] >> (7 - bit % 8) & 1);
+        }
+        if (length[i] == 0) {
+            return 0;
+        }
+    }
+
+    if (!huffman_table_from_lengths(table, length)) {
+        return 0;
+    }
+    return (bit + 7) / 8;
+}
+
+/* Stores the depth of each leaf in the trie as the code length of its
+   key. */
+static void collect_lengths(const trie_node *node, int depth, int *length) {
+    if (node == NULL) {
+        return;
+    }
+    if (node->left == NULL && node->right == NULL) {
+        length[node->key] = depth;
+        return;
+    }
+    collect_lengths(node->left, depth + 1, length);
+    collect_lengths(node->right, depth + 1, length);
+}
+
+/*
+ * Converts trie depths to code lengths of at most HUFF_MAX_CODE_LEN.
+ * Too long codes are cut to the maximum length, and then codes are
+ * moved down one level at a time until the Kraft sum is 1 again. The
+ * symbols keep their order, so frequent symbols keep the short codes.
+ */
+static void limit_lengths(unsigned char *length, const int *depth) {
+    int count[HUFF_SYMBOLS + 1] = {0};
+    int order[HUFF_SYMBOLS];
+    int symbols = 0;
+
+    /* Order the symbols by depth, then by symbol */
+    for (int d = 1; d <= HUFF_SYMBOLS; d++) {
+        for (int i = 0; i < HUFF_SYMBOLS; i++) {
+            if (depth[i] == d) {
+                order[symbols++] = i;
+                count[d]++;
+            }
+        }
+    }
+
+    for (int d = HUFF_MAX_CODE_LEN + 1; d <= HUFF_SYMBOLS; d++) {
+        count[HUFF_MAX_CODE_LEN] += count[d];
+        count[d] = 0;
+    }
+
+    uint32_t kraft = 0;
+    for (int d = 1; d <= HUFF_MAX_CODE_LEN; d++) {
+        kraft += (uint32_t)count[d] << (HUFF_MAX_CODE_LEN - d);
+    }
+    while (kraft > (1u << HUFF_MAX_CODE_LEN)) {
+        count[HUFF_MAX_CODE_LEN]--;
+        for (int d = HUFF_MAX_CODE_LEN - 1; d > 0; d--) {
+            if (count[d] > 0) {
+                count[d]--;
+                count[d + 1] += 2;
+                break;
+            }
+        }
+        kraft--;
+    }
+
+    int next = 0;
+    for (int d = 1; d <= HUFF_MAX_CODE_LEN; d++) {
+        for (int i = 0; i < count[d]; i++) {
+            length[order[next++]] = d;
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef HUFFMAN_TABLE
+#define HUFFMAN_TABLE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "huffman_trie.h"
+
+/*
+ * Code and decode tables for a canonical Huffman code.
+ *
+ * The code is fully described by the code length of each symbol.
+ * Codes are assigned in order of (length, symbol), so a table can be
+ * rebuilt from the lengths alone. Codes are written most significant
+ * bit first, the same bit order as the bit_buffer.
+ */
+
+/* The 256 characters and the two run symbols of rle.h */
+#define HUFF_SYMBOLS 258
+#define HUFF_MAX_CODE_LEN 20
+#define HUFF_LOOKUP_BITS 11
+
+/* A stored table is a bitmap of the symbols that have a code, followed
+   by the code length of each of them in HUFF_LENGTH_BITS bits */
+#define HUFF_LENGTH_BITS 5
+#define HUFF_TABLE_BITMAP_BYTES ((HUFF_SYMBOLS + 7) / 8)
+#define HUFF_TABLE_MAX_BYTES (HUFF_TABLE_BITMAP_BYTES + \
+                              (HUFF_SYMBOLS * HUFF_LENGTH_BITS + 7) / 8)
+
+/* A lookup entry holds the code length in the high bits and the symbol
+   in the low bits. 0 means that the code is longer than
+   HUFF_LOOKUP_BITS. */
+#define HUFF_LOOKUP_SYMBOL_BITS 9
+#define HUFF_LOOKUP_SYMBOL(entry) ((entry) & ((1 << HUFF_LOOKUP_SYMBOL_BITS) - 1))
+#define HUFF_LOOKUP_LENGTH(entry) ((entry) >> HUFF_LOOKUP_SYMBOL_BITS)
+
+/*
+ * length        The code length of each symbol in bits.
+ * code          The code of each symbol, right aligned.
+ * max_length    The longest code length.
+ * lookup        Decode table indexed by the next HUFF_LOOKUP_BITS bits.
+ * first_code    The first canonical code of each length.
+ * first_index   The index in sorted of the first symbol of each length.
+ * count         The number of symbols of each length.
+ * sorted        The symbols ordered by (length, symbol).
+ */
+typedef struct {
+    unsigned char length[HUFF_SYMBOLS];
+    uint32_t code[HUFF_SYMBOLS];
+    int max_length;
+    uint16_t lookup[1 << HUFF_LOOKUP_BITS];
+    uint32_t first_code[HUFF_MAX_CODE_LEN + 1];
+    uint16_t first_index[HUFF_MAX_CODE_LEN + 1];
+    uint16_t count[HUFF_MAX_CODE_LEN + 1];
+    uint16_t sorted[HUFF_SYMBOLS];
+} huffman_table;
+
+/*
+ * Builds the tables from a Huffman trie. Codes longer than
+ * HUFF_MAX_CODE_LEN are shortened. The user is responsible for
+ * deallocating the table with free.
+ */
+huffman_table *build_huffman_table(const trie_node *root);
+
+/*
+ * Builds the tables from code lengths. Returns false if the lengths do
+ * not describe a valid prefix code.
+ */
+bool huffman_table_from_lengths(huffman_table *table, const unsigned char *length);
+
+/*
+ * Builds a table with codes only for the symbols with a count above 0.
+ * counts must have HUFF_SYMBOLS elements.
+ * The user is responsible for deallocating the table with free.
+ */
+huffman_table *huffman_table_from_counts(const uint64_t *counts);
+
+/*
+ * Returns the number of bytes huffman_table_write uses for the table.
+ */
+size_t huffman_table_size(const huffman_table *table);
+
+/*
+ * Returns the number of bytes of a stored table from its bitmap, the
+ * first HUFF_TABLE_BITMAP_BYTES bytes, so that a reader knows how much
+ * to read before huffman_table_read.
+ */
+size_t huffman_table_stored_size(const unsigned char *bitmap);
+
+/*
+ * Stores the code lengths of the table in out, which must have room for
+ * HUFF_TABLE_MAX_BYTES bytes. Returns the number of bytes written.
+ */
+size_t huffman_table_write(const huffman_table *table, unsigned char *out);
+
+/*
+ * Rebuilds a table stored by huffman_table_write from the size bytes in
+ * in. Returns the number of bytes read, or 0 if the table is invalid.
+ */
+size_t huffman_table_read(huffman_table *table, const unsigned char *in, size_t size);
+
+/*
+ * Decodes one symbol from the bits in acc, where the next bit is the
+ * most significant bit. Stores the code length in *length. Returns -1
+ * if the bits are not a valid code.
+ */
+static inline int huffman_table_decode(const huffman_table *table, uint64_t acc,
+                                       int *length) {
+    uint16_t entry = table->lookup[acc >> (64 - HUFF_LOOKUP_BITS)];
+    if (entry != 0) {
+        *length = HUFF_LOOKUP_LENGTH(entry);
+        return HUFF_LOOKUP_SYMBOL(entry);
+    }
+
+    for (int len = HUFF_LOOKUP_BITS + 1; len <= table->max_length; len++) {
+        uint32_t offset = (uint32_t)(acc >> (64 - len)) - table->first_code[len];
+        if (offset < table->count[len]) {
+            *length = len;
+            return table->sorted[table->first_index[len] + offset];
+        }
+    }
+
+    return -1;
+}
+
+#endif
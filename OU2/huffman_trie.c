@@ -1,49 +1,84 @@
 #include "huffman_trie.h"
 
-pqueue *process_frequency(charFrequency *frequency) {
+static trie_pq *make_leaves(charFrequency *frequency, int symbols, bool include_unused);
 
-    pqueue *pq = pqueue_empty(cmp_key);
+trie_pq *process_frequency(charFrequency *frequency) {
 
-    for (int i = 0; i < 256; i++) {
-        if (frequency[i].frequency > 0) {
-            trie_node *new_node = malloc(sizeof(trie_node));
-            new_node->weight = frequency[i].frequency;
-            new_node->key = frequency[i].character;
-            new_node->left = NULL;
-            new_node->right = NULL;
-
-            //printf("Inserted node: Key: %c, Weight: %d\n", new_node->key, new_node->weight);
-
-            pqueue_insert(pq, new_node);
-            trie_node *test = malloc(sizeof(trie_node));
-            
-        }
-    }
+    /* Characters that do not occur in FILE0 are added with weight 0, so
+       every character in FILE1 gets a code. They end up in one subtree
+       at the bottom of the trie, which costs at most one extra bit for
+       the rarest characters that do occur. */
+    return make_leaves(frequency, 256, true);
+}
 
-     return pq;
+trie_pq *process_used_frequency(charFrequency *frequency, int symbols) {
+    return make_leaves(frequency, symbols, false);
 }
 
+static trie_pq *make_leaves(charFrequency *frequency, int symbols, bool include_unused) {
 
+    trie_pq_item items[symbols];
+    int n = 0;
 
-int cmp_key (void *nodeIn1, void *nodeIn2) {
+    for (int i = 0; i < symbols; i++) {
+        if (frequency[i].frequency == 0 && !include_unused) {
+            continue;
+        }
 
-	trie_node *node1 = nodeIn1;
-	trie_node *node2 = nodeIn2;
+        trie_node *new_node = malloc(sizeof(trie_node));
+        new_node->weight = frequency[i].frequency;
+        new_node->key = frequency[i].character;
+        new_node->left = NULL;
+        new_node->right = NULL;
 
-	int largest = 0;
+        //printf("Inserted node: Key: %c, Weight: %d\n", new_node->key, new_node->weight);
 
-	if (node1 -> weight > node2 -> weight) {
+        items[n].weight = new_node->weight;
+        items[n].order = n;
+        items[n].node = new_node;
+        n++;
+    }
 
-		largest = 1;
+    return trie_pq_from_array(items, n);
+}
 
-	} else if (node2 -> weight > node1 -> weight) {
+trie_node *build_huffman_trie(trie_pq *pq) {
+    if (trie_pq_is_empty(pq)) {
+        return NULL;
+    }
 
-		largest = -1;
-	}
+    unsigned int order = trie_pq_size(pq);
+    while (trie_pq_size(pq) > 1) {
+        trie_pq_item left = trie_pq_delete_first(pq);
+        trie_pq_item right = trie_pq_first(pq);
+
+        /* The parent takes the place of the second node, which saves
+           a removal */
+        trie_pq_item parent;
+        parent.node = merge_nodes(left.node, right.node);
+        parent.weight = parent.node->weight;
+        parent.order = order++;
+        trie_pq_replace_first(pq, parent);
+    }
 
-	return largest;
+    return trie_pq_delete_first(pq).node;
 }
 
+trie_node *merge_nodes(trie_node *left, trie_node *right) {
+    trie_node *parent = malloc(sizeof(trie_node));
+    parent->weight = left->weight + right->weight;
+    parent->key = 0;
+    parent->left = left;
+    parent->right = right;
 
+    return parent;
+}
 
-
+void free_huffman_trie(trie_node *root) {
+    if (root == NULL) {
+        return;
+    }
+    free_huffman_trie(root->left);
+    free_huffman_trie(root->right);
+    free(root);
+}
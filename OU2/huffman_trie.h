@@ -2,15 +2,35 @@
 #define HUFFMAN_TRIE
 
     #include <stdio.h>
-    #include "pqueue.h"
+    #include "pqueue_def.h"
     #include "calc_frequency.h"
     
     typedef struct trie_node {
-        int weight;
-	    unsigned char key;
+        long long weight;
+	    unsigned short key;
         struct trie_node *left, *right;
     } trie_node;
 
-    pqueue *process_frequency(charFrequency *frequency);
-    int cmp_key (void *nodeIn1, void *nodeIn2);
+    /* The weight is kept next to the node pointer so that comparisons
+       only touch the heap array. order breaks ties, so that nodes of
+       equal weight are merged in the order they were created. */
+    typedef struct {
+        long long weight;
+        unsigned int order;
+        trie_node *node;
+    } trie_pq_item;
+
+    #define weight_less(a, b) ((a)->weight < (b)->weight || \
+                               ((a)->weight == (b)->weight && (a)->order < (b)->order))
+
+    PQUEUE_DEFINE(trie_pq, trie_pq_item, weight_less)
+
+    trie_pq *process_frequency(charFrequency *frequency);
+    /* Like process_frequency for the first symbols elements of
+       frequency, but leaves out characters with frequency 0, which then
+       get no code */
+    trie_pq *process_used_frequency(charFrequency *frequency, int symbols);
+    trie_node *build_huffman_trie(trie_pq *pq);
+    trie_node *merge_nodes(trie_node *left, trie_node *right);
+    void free_huffman_trie(trie_node *root);
 #endif
\ No newline at end of file
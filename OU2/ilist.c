@@ -0,0 +1,153 @@
+/*
+ * A data type representing an intrusive list.
+ *
+ * The list is implemented as a doubly linked list of links embedded in
+ * the elements. The positions work exactly as in list.c, but the list
+ * never allocates memory.
+ *
+ * For more information see the corresponding .h-file.
+ */
+
+#include <assert.h>
+
+#include "ilist.h"
+
+
+/* ---------------------- External functions ---------------------- */
+
+void ilist_init(ilist *const l)
+{
+	assert(l != NULL);
+
+	l->first = NULL;
+	l->end = NULL;
+}
+
+
+bool ilist_is_empty(const ilist *const l)
+{
+	return l->first == NULL;
+}
+
+
+ilist_position ilist_first(ilist *const l)
+{
+	if (l->first == NULL) {
+		return (ilist_position) { &l->first, &l->end };
+	} else {
+		return (ilist_position) { &l->first, &l->first->prev };
+	}
+}
+
+
+ilist_position ilist_end(ilist *const l)
+{
+	if (l->first == NULL) {
+		return (ilist_position) { &l->first, &l->end };
+	} else {
+		return (ilist_position) { &l->end->next, &l->end };
+	}
+}
+
+
+ilist_position ilist_next(ilist *const l, const ilist_position pos)
+{
+	if ((*pos.forward)->next == NULL) {
+		return (ilist_position) { &(*pos.forward)->next, &l->end };
+	} else {
+		return (ilist_position) { &(*pos.forward)->next,
+		                          &(*pos.forward)->next->prev };
+	}
+}
+
+
+ilist_position ilist_previous(ilist *const l, const ilist_position pos)
+{
+	if ((*pos.backward)->prev == NULL) {
+		return (ilist_position) { &l->first, &(*pos.backward)->prev };
+	} else {
+		return (ilist_position) { &(*pos.backward)->prev->next,
+		                          &(*pos.backward)->prev };
+	}
+}
+
+
+bool ilist_is_first(const ilist *const l, const ilist_position pos)
+{
+	assert(l != NULL);
+
+	return *pos.backward == NULL;
+}
+
+
+bool ilist_is_end(const ilist *const l, const ilist_position pos)
+{
+	assert(l != NULL);
+
+	return *pos.forward == NULL;
+}
+
+
+ilist_link *ilist_inspect(const ilist *const l, const ilist_position pos)
+{
+	assert(l != NULL);
+
+	return *pos.forward;
+}
+
+
+ilist_position ilist_insert(ilist *const l, const ilist_position pos,
+                            ilist_link *link)
+{
+	assert(l != NULL);
+	assert(link != NULL);
+
+	link->next = *pos.forward;
+	link->prev = *pos.backward;
+	*pos.forward = link;
+	*pos.backward = link;
+
+	return (ilist_position){pos.forward, &link->prev};
+}
+
+
+ilist_position ilist_insert_range(ilist *const l, const ilist_position pos,
+                                  ilist_link *const links[], const size_t n)
+{
+	assert(l != NULL);
+
+	if (n == 0) {
+		return pos;
+	}
+
+	/* Chain the new links to each other first, then splice the chain
+	   into the list */
+	for (size_t i = 1; i < n; i++) {
+		links[i - 1]->next = links[i];
+		links[i]->prev = links[i - 1];
+	}
+	links[0]->prev = *pos.backward;
+	links[n - 1]->next = *pos.forward;
+	*pos.forward = links[0];
+	*pos.backward = links[n - 1];
+
+	return (ilist_position){pos.forward, &links[0]->prev};
+}
+
+
+ilist_position ilist_remove(ilist *const l, ilist_position pos)
+{
+	ilist_link *link = *pos.forward;
+	*pos.forward = link->next;
+	if (*pos.forward) {
+		pos.backward = &(*pos.forward)->prev;
+	} else {
+		pos.backward = &l->end;
+	}
+	*pos.backward = link->prev;
+
+	link->next = NULL;
+	link->prev = NULL;
+
+	return pos;
+}
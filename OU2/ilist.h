@@ -0,0 +1,198 @@
+/**
+ * @defgroup ilist_h Intrusive list
+ *
+ * @brief A data type representing an intrusive list.
+ *
+ * The data type represent a doubly linked list where the links are
+ * embedded in the elements themselves. The user puts an ilist_link
+ * in its own struct and gets the struct back from a link with
+ * ILIST_ENTRY. The list never allocates or deallocates any memory, the
+ * elements are owned by the user.
+ *
+ * Positions work the same way as in list.h: a position refers to the
+ * element it points at, and inserting at a position puts the new
+ * element immediately before it.
+ *
+ * @{
+ */
+
+#ifndef ILIST_H
+#define ILIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief          The links to embed in a list element.
+ *
+ * @elem next      A pointer to the next link or NULL.
+ * @elem prev      A pointer to the previous link or NULL.
+ */
+typedef struct ilist_link
+{
+	struct ilist_link *next;
+	struct ilist_link *prev;
+} ilist_link;
+
+/**
+ * @brief          A structure holding an intrusive list. It can be
+ *                 embedded in other structs, initialize it with
+ *                 ilist_init.
+ *
+ * @elem first     A pointer to the first link in the list or NULL.
+ * @elem end       A pointer to the last link in the list or NULL.
+ */
+typedef struct ilist
+{
+	ilist_link *first;
+	ilist_link *end;
+} ilist;
+
+/**
+ * @brief          A structure used to represent a position in a list.
+ *
+ * @elem forward   A pointer to the next link or NULL.
+ * @elem backward  A pointer to the previous link or NULL.
+ */
+typedef struct ilist_position
+{
+	ilist_link **forward;
+	ilist_link **backward;
+} ilist_position;
+
+/**
+ * @brief          Get the struct of type type that embeds the link in
+ *                 its member member.
+ */
+#define ILIST_ENTRY(link, type, member) \
+	((type *)((char *)(link) - offsetof(type, member)))
+
+/**
+ * @brief          Initialize an empty list.
+ *
+ * @param l        The list.
+ * @return         -
+ */
+void ilist_init(ilist *const l);
+
+/**
+ * @brief          Check if the list is empty or not.
+ *
+ * @param l        The list to check.
+ * @return         True if the list is empty, otherwise false.
+ */
+bool ilist_is_empty(const ilist *const l);
+
+/**
+ * @brief          Returns the position of the first link in the list.
+ *
+ * @param l        The list.
+ * @return         The position of the first link in the list.
+ */
+ilist_position ilist_first(ilist *const l);
+
+/**
+ * @brief          Returns the position past the end of the list.
+ *
+ * @param l        The list.
+ * @return         The position after the last link in the list.
+ */
+ilist_position ilist_end(ilist *const l);
+
+/**
+ * @brief          Returns the next position in the list.
+ *
+ * @param l        The list.
+ * @param pos      The position before the call to the function.
+ * @return         The position of the next link in the list.
+ */
+ilist_position ilist_next(ilist *const l, const ilist_position pos);
+
+/**
+ * @brief          Returns the previous position in the list.
+ *
+ * @param l        The list.
+ * @param pos      The position before the call to the function.
+ * @return         The position of the previous link in the list.
+ */
+ilist_position ilist_previous(ilist *const l, const ilist_position pos);
+
+/**
+ * @brief          Check if the position points at the first link in
+ *                 the list.
+ *
+ * @param l        The list.
+ * @param pos      The position to be checked.
+ * @return         True if the position points at the first link in
+ *                 the list, otherwise false.
+ */
+bool ilist_is_first(const ilist *const l, const ilist_position pos);
+
+/**
+ * @brief          Check if the position is past the last link in the
+ *                 list.
+ *
+ * @param l        The list.
+ * @param pos      The position to be checked.
+ * @return         True if the position is the end of the list,
+ *                 otherwise false.
+ */
+bool ilist_is_end(const ilist *const l, const ilist_position pos);
+
+/**
+ * @brief          Get the link at the given position. Use ILIST_ENTRY
+ *                 to get the element.
+ *
+ * @param l        The list.
+ * @param pos      The position to be inspected.
+ * @return         A pointer to the link.
+ */
+ilist_link *ilist_inspect(const ilist *const l, const ilist_position pos);
+
+/**
+ * @brief          Insert an element in the list. The element is
+ *                 inserted immediately before the given position.
+ *
+ * @param l        The list.
+ * @param pos      The position of the link that the new link will be
+ *                 inserted immediately before.
+ * @param link     The link embedded in the element to insert. It must
+ *                 not be in any list.
+ * @return         The position of the new link in the list.
+ */
+ilist_position ilist_insert(ilist *const l, const ilist_position pos,
+                            ilist_link *link);
+
+/**
+ * @brief          Insert n elements in the list, in the order they
+ *                 have in the links array, immediately before the
+ *                 given position. The list is only touched once
+ *                 regardless of n.
+ *
+ * @param l        The list.
+ * @param pos      The position of the link that the new links will
+ *                 be inserted immediately before.
+ * @param links    The links to insert.
+ * @param n        The number of links.
+ * @return         The position of the first new link in the list, or
+ *                 pos if n is 0.
+ */
+ilist_position ilist_insert_range(ilist *const l, const ilist_position pos,
+                                  ilist_link *const links[], const size_t n);
+
+/**
+ * @brief          Remove a link from the list. The element is not
+ *                 deallocated.
+ *
+ * @param l        The list.
+ * @param pos      The position of the link to remove.
+ * @return         The position of the link immediately after the
+ *                 removed link.
+ */
+ilist_position ilist_remove(ilist *const l, ilist_position pos);
+
+#endif
+
+/**
+ * @}
+ */
@@ -163,6 +163,36 @@ list_position list_insert(const list *const l,
 }
 
 
+list_position list_insert_range(const list *const l,
+                                const list_position pos,
+                                void *const values[],
+                                const int n)
+{
+	assert(l != NULL);
+
+	if (n <= 0) {
+		return pos;
+	}
+
+	/* Chain the new nodes to each other first, then splice the chain
+	   into the list */
+	struct node *first = make_node(values[0]);
+	struct node *last = first;
+	for (int i = 1; i < n; i++) {
+		struct node *node = make_node(values[i]);
+		node->prev = last;
+		last->next = node;
+		last = node;
+	}
+	first->prev = *pos.backward;
+	last->next = *pos.forward;
+	*pos.forward = first;
+	*pos.backward = last;
+
+	return (list_position){pos.forward, &first->prev};
+}
+
+
 list_position list_remove(list *const l, list_position pos)
 {
 	struct node *n = *pos.forward;
@@ -152,6 +152,25 @@ list_position list_insert(const list *const l,
                           const list_position pos,
                           void *value);
 
+/**
+ * @brief          Insert n values in the list, in the order they have
+ *                 in the values array, immediately before the given
+ *                 position. The new nodes are linked to each other
+ *                 first and then spliced into the list in one step.
+ *
+ * @param l        The list.
+ * @param pos      The position of the node that the new nodes will be
+ *                 inserted immediately before.
+ * @param values   The values to be inserted.
+ * @param n        The number of values.
+ * @return         The position of the first new node in the list, or
+ *                 pos if n is 0.
+ */
+list_position list_insert_range(const list *const l,
+                                const list_position pos,
+                                void *const values[],
+                                const int n);
+
 /**
  * @brief          Remove a node from the list. The node will be
  *                 killed.
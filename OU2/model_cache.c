@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "model_cache.h"
+#include "byte_order.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MODEL_CACHE_MAGIC "HMDL"
+#define MODEL_CACHE_VERSION 2
+#define MODEL_CACHE_HEADER_SIZE 24
+#define MODEL_CACHE_SUFFIX ".hmc"
+
+typedef struct {
+    char *name;
+    long long size;
+    struct timespec mtime;
+} cache_entry;
+
+static uint64_t hash_bytes(const unsigned char *data, size_t n, uint64_t h);
+static uint64_t mix64(uint64_t x);
+static char *entry_path(const model_cache *cache, uint64_t key);
+static int make_dirs(const char *dir);
+static void evict(const model_cache *cache);
+static int cmp_entry_age(const void *a, const void *b);
+
+uint64_t model_cache_key(FILE *fp, uint64_t salt) {
+    int fd = fileno(fp);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        return 0;
+    }
+
+    uint64_t h = mix64(salt ^ MODEL_CACHE_VERSION);
+    h = mix64(h ^ (uint64_t)st.st_size);
+    h = mix64(h ^ (uint64_t)st.st_mtim.tv_sec);
+    h = mix64(h ^ (uint64_t)st.st_mtim.tv_nsec);
+    h = mix64(h ^ (uint64_t)st.st_ino);
+    h = mix64(h ^ (uint64_t)st.st_dev);
+
+    unsigned char *buffer = malloc(MODEL_CACHE_HASH_BYTES);
+    ssize_t n = pread(fd, buffer, MODEL_CACHE_HASH_BYTES, 0);
+    if (n > 0) {
+        h = hash_bytes(buffer, n, h);
+    }
+    if (st.st_size > MODEL_CACHE_HASH_BYTES) {
+        n = pread(fd, buffer, MODEL_CACHE_HASH_BYTES, st.st_size - MODEL_CACHE_HASH_BYTES);
+        if (n > 0) {
+            h = hash_bytes(buffer, n, h);
+        }
+    }
+    free(buffer);
+
+    /* 0 means no key */
+    return h != 0 ? h : 1;
+}
+
+huffman_table *model_cache_load(const model_cache *cache, uint64_t key) {
+    if (cache->dir == NULL || key == 0) {
+        return NULL;
+    }
+
+    char *path = entry_path(cache, key);
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        free(path);
+        return NULL;
+    }
+
+    /* Only the code lengths are stored, and the table is rebuilt from
+       them, which rejects an entry that is not a valid code */
+    unsigned char header[MODEL_CACHE_HEADER_SIZE];
+    unsigned char length[HUFF_SYMBOLS];
+    huffman_table *table = malloc(sizeof(huffman_table));
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+        memcmp(header, MODEL_CACHE_MAGIC, 4) != 0 ||
+        load_le32(header + 4) != MODEL_CACHE_VERSION ||
+        load_le64(header + 8) != key ||
+        load_le64(header + 16) != HUFF_SYMBOLS ||
+        fread(length, 1, HUFF_SYMBOLS, fp) != HUFF_SYMBOLS ||
+        !huffman_table_from_lengths(table, length)) {
+        free(table);
+        table = NULL;
+    }
+    fclose(fp);
+
+    /* Mark the entry as recently used */
+    if (table != NULL) {
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+    free(path);
+
+    return table;
+}
+
+int model_cache_store(const model_cache *cache, uint64_t key,
+                      const huffman_table *table) {
+    if (cache->dir == NULL || key == 0 || make_dirs(cache->dir) != 0) {
+        return -1;
+    }
+
+    unsigned char header[MODEL_CACHE_HEADER_SIZE];
+    memcpy(header, MODEL_CACHE_MAGIC, 4);
+    store_le32(header + 4, MODEL_CACHE_VERSION);
+    store_le64(header + 8, key);
+    store_le64(header + 16, HUFF_SYMBOLS);
+
+    /* Write to a temporary file first so that concurrent runs never
+       read a half written entry */
+    char *path = entry_path(cache, key);
+    size_t len = strlen(path);
+    char *tmp_path = malloc(len + 32);
+    snprintf(tmp_path, len + 32, "%s.%ld.tmp", path, (long)getpid());
+
+    int err = -1;
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp != NULL) {
+        if (fwrite(header, 1, sizeof(header), fp) == sizeof(header) &&
+            fwrite(table->length, 1, HUFF_SYMBOLS, fp) == HUFF_SYMBOLS) {
+            err = 0;
+        }
+        if (fclose(fp) != 0) {
+            err = -1;
+        }
+        if (err == 0) {
+            err = rename(tmp_path, path);
+        }
+        if (err != 0) {
+            remove(tmp_path);
+        }
+    }
+    free(tmp_path);
+    free(path);
+
+    if (err == 0) {
+        evict(cache);
+    }
+
+    return err;
+}
+
+static uint64_t hash_bytes(const unsigned char *data, size_t n, uint64_t h) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        h = (h ^ load_le64(data + i)) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    for (; i < n; i++) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+
+    return mix64(h ^ n);
+}
+
+/* The finalizer of MurmurHash3 */
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static char *entry_path(const model_cache *cache, uint64_t key) {
+    size_t len = strlen(cache->dir) + 1 + 16 + strlen(MODEL_CACHE_SUFFIX) + 1;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%016llx%s", cache->dir, (unsigned long long)key,
+             MODEL_CACHE_SUFFIX);
+    return path;
+}
+
+/* Creates the directory and its missing parents */
+static int make_dirs(const char *dir) {
+    char *path = strdup(dir);
+    int err = 0;
+
+    for (char *p = path + 1; err == 0; p++) {
+        if (*p == '/' || *p == '\0') {
+            char c = *p;
+            *p = '\0';
+            if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+                err = -1;
+            }
+            *p = c;
+            if (c == '\0') {
+                break;
+            }
+        }
+    }
+
+    free(path);
+    return err;
+}
+
+/* Removes the least recently used entries until the cache is within
+   its limits */
+static void evict(const model_cache *cache) {
+    DIR *dir = opendir(cache->dir);
+    if (dir == NULL) {
+        return;
+    }
+
+    size_t suffix_len = strlen(MODEL_CACHE_SUFFIX);
+    int count = 0;
+    int capacity = 64;
+    cache_entry *entries = malloc(capacity * sizeof(cache_entry));
+    long long total = 0;
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        size_t len = strlen(de->d_name);
+        if (len <= suffix_len || strcmp(de->d_name + len - suffix_len, MODEL_CACHE_SUFFIX) != 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (fstatat(dirfd(dir), de->d_name, &st, 0) != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            entries = realloc(entries, capacity * sizeof(cache_entry));
+        }
+        entries[count].name = strdup(de->d_name);
+        entries[count].size = st.st_size;
+        entries[count].mtime = st.st_mtim;
+        total += st.st_size;
+        count++;
+    }
+
+    qsort(entries, count, sizeof(cache_entry), cmp_entry_age);
+
+    int remaining = count;
+    for (int i = 0; i < count; i++) {
+        if (total > cache->max_bytes || remaining > cache->max_entries) {
+            if (unlinkat(dirfd(dir), entries[i].name, 0) == 0) {
+                total -= entries[i].size;
+                remaining--;
+            }
+        }
+        free(entries[i].name);
+    }
+
+    free(entries);
+    closedir(dir);
+}
+
+/* Orders entries from least to most recently used */
+static int cmp_entry_age(const void *a, const void *b) {
+    const cache_entry *e1 = a;
+    const cache_entry *e2 = b;
+
+    if (e1->mtime.tv_sec != e2->mtime.tv_sec) {
+        return e1->mtime.tv_sec < e2->mtime.tv_sec ? -1 : 1;
+    }
+    if (e1->mtime.tv_nsec != e2->mtime.tv_nsec) {
+        return e1->mtime.tv_nsec < e2->mtime.tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
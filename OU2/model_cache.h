@@ -0,0 +1,55 @@
+#ifndef MODEL_CACHE
+#define MODEL_CACHE
+
+#include <stdio.h>
+#include <stdint.h>
+#include "huffman_table.h"
+
+/*
+ * An on-disk cache of built huffman_tables, so that repeated runs with
+ * the same FILE0 skip the frequency analysis and the trie.
+ *
+ * Entries are keyed by a hash of the size, modification time and inode
+ * of FILE0 together with its first and last MODEL_CACHE_HASH_BYTES
+ * bytes. Each entry is a file named after the key holding the
+ * HUFF_SYMBOLS code lengths of the table, which is rebuilt and checked
+ * when it is loaded. Entries are touched when they are used and the
+ * least recently used entries are removed when the cache grows past
+ * its limits.
+ */
+
+#define MODEL_CACHE_HASH_BYTES (64 * 1024)
+
+/*
+ * dir          The cache directory, or NULL if the cache is disabled.
+ * max_bytes    The maximum total size of all entries.
+ * max_entries  The maximum number of entries.
+ */
+typedef struct {
+    const char *dir;
+    long long max_bytes;
+    int max_entries;
+} model_cache;
+
+/*
+ * Computes the cache key of the file. salt is mixed into the key and
+ * should identify everything besides the file that changes the model.
+ * The file position is not changed. Returns 0 if the file can not be
+ * examined.
+ */
+uint64_t model_cache_key(FILE *fp, uint64_t salt);
+
+/*
+ * Loads the table stored under key. Returns NULL on a cache miss. The
+ * user is responsible for deallocating the table with free.
+ */
+huffman_table *model_cache_load(const model_cache *cache, uint64_t key);
+
+/*
+ * Stores the table under key and evicts old entries if the cache is
+ * over its limits. Returns 0 on success.
+ */
+int model_cache_store(const model_cache *cache, uint64_t key,
+                      const huffman_table *table);
+
+#endif
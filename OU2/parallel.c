@@ -0,0 +1,268 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t count;
+    void (*func)(void *context, size_t i);
+    void *context;
+} work;
+
+typedef struct {
+    task_func func;
+    void *context;
+    size_t i;
+} task;
+
+/* A growing ring of tasks. The owner pushes and pops at the bottom,
+   other workers steal at the top. */
+typedef struct {
+    pthread_mutex_t lock;
+    task *tasks;
+    size_t capacity;
+    size_t top;
+    size_t bottom;
+} deque;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    size_t pending;
+    unsigned long spawned;
+    int sleeping;
+    int threads;
+    task_worker *workers;
+} task_pool;
+
+struct task_worker {
+    task_pool *pool;
+    deque tasks;
+    uint64_t seed;
+};
+
+static void *worker(void *arg);
+static void *task_worker_main(void *arg);
+static bool steal_task(task_worker *w, task *t);
+static void deque_push(deque *d, const task *t);
+static bool deque_pop(deque *d, task *t);
+static bool deque_steal(deque *d, task *t);
+
+void parallel_for(size_t count, int threads, void (*func)(void *context, size_t i),
+                  void *context) {
+    work w;
+    pthread_mutex_init(&w.lock, NULL);
+    w.next = 0;
+    w.count = count;
+    w.func = func;
+    w.context = context;
+
+    if (threads <= 0) {
+        threads = parallel_processors();
+    }
+    if ((size_t)threads > count) {
+        threads = count > 0 ? count : 1;
+    }
+
+    /* The calling thread is one of the workers */
+    pthread_t *ids = malloc((threads - 1) * sizeof(pthread_t) + 1);
+    int started = 0;
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&ids[started], NULL, worker, &w) == 0) {
+            started++;
+        }
+    }
+    worker(&w);
+    for (int i = 0; i < started; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    free(ids);
+    pthread_mutex_destroy(&w.lock);
+}
+
+void parallel_tasks(size_t count, int threads, task_func func, void *context) {
+    task_pool pool;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+    pool.pending = count;
+    pool.spawned = count;
+    pool.sleeping = 0;
+    pool.threads = threads > 0 ? threads : parallel_processors();
+    pool.workers = malloc(pool.threads * sizeof(task_worker));
+
+    for (int i = 0; i < pool.threads; i++) {
+        task_worker *w = &pool.workers[i];
+        w->pool = &pool;
+        w->seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+        pthread_mutex_init(&w->tasks.lock, NULL);
+        w->tasks.capacity = 64;
+        w->tasks.tasks = malloc(w->tasks.capacity * sizeof(task));
+        w->tasks.top = 0;
+        w->tasks.bottom = 0;
+    }
+
+    /* Deal the first tasks out in turn, last first, so that each worker
+       starts with the lowest of its indices */
+    for (size_t i = count; i-- > 0;) {
+        task t = {func, context, i};
+        deque_push(&pool.workers[i % pool.threads].tasks, &t);
+    }
+
+    pthread_t *ids = malloc((pool.threads - 1) * sizeof(pthread_t) + 1);
+    int started = 0;
+    for (int i = 1; i < pool.threads; i++) {
+        if (pthread_create(&ids[started], NULL, task_worker_main, &pool.workers[i]) == 0) {
+            started++;
+        }
+    }
+    /* The tasks of workers that did not start are stolen by the others */
+    task_worker_main(&pool.workers[0]);
+    for (int i = 0; i < started; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    for (int i = 0; i < pool.threads; i++) {
+        pthread_mutex_destroy(&pool.workers[i].tasks.lock);
+        free(pool.workers[i].tasks.tasks);
+    }
+    free(ids);
+    free(pool.workers);
+    pthread_cond_destroy(&pool.wake);
+    pthread_mutex_destroy(&pool.lock);
+}
+
+void parallel_spawn(task_worker *worker, task_func func, void *context, size_t i) {
+    task_pool *pool = worker->pool;
+    task t = {func, context, i};
+
+    /* Counted before it is pushed, so that a thief can not finish it
+       before it is pending */
+    pthread_mutex_lock(&pool->lock);
+    pool->pending++;
+    pool->spawned++;
+    deque_push(&worker->tasks, &t);
+    if (pool->sleeping > 0) {
+        pthread_cond_signal(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int parallel_worker_index(const task_worker *worker) {
+    return (int)(worker - worker->pool->workers);
+}
+
+int parallel_processors(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void *worker(void *arg) {
+    work *w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        size_t i = w->next < w->count ? w->next++ : w->count;
+        pthread_mutex_unlock(&w->lock);
+
+        if (i == w->count) {
+            return NULL;
+        }
+        w->func(w->context, i);
+    }
+}
+
+static void *task_worker_main(void *arg) {
+    task_worker *w = arg;
+    task_pool *pool = w->pool;
+    unsigned long seen = 0;
+
+    for (;;) {
+        task t;
+        if (deque_pop(&w->tasks, &t) || steal_task(w, &t)) {
+            t.func(w, t.context, t.i);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0) {
+                pthread_cond_broadcast(&pool->wake);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        /* Nothing to run or steal. Sleep unless a task was spawned
+           since the last look, or all are done. */
+        pthread_mutex_lock(&pool->lock);
+        if (pool->pending == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        if (pool->spawned == seen) {
+            pool->sleeping++;
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            pool->sleeping--;
+        }
+        seen = pool->spawned;
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/* Tries the other workers once each, from a random one */
+static bool steal_task(task_worker *w, task *t) {
+    task_pool *pool = w->pool;
+    int self = (int)(w - pool->workers);
+
+    w->seed ^= w->seed << 13;
+    w->seed ^= w->seed >> 7;
+    w->seed ^= w->seed << 17;
+    int first = (int)(w->seed % pool->threads);
+
+    for (int k = 0; k < pool->threads; k++) {
+        int victim = (first + k) % pool->threads;
+        if (victim != self && deque_steal(&pool->workers[victim].tasks, t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void deque_push(deque *d, const task *t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom - d->top == d->capacity) {
+        task *larger = malloc(2 * d->capacity * sizeof(task));
+        for (size_t i = d->top; i < d->bottom; i++) {
+            larger[i % (2 * d->capacity)] = d->tasks[i % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = larger;
+        d->capacity *= 2;
+    }
+    d->tasks[d->bottom++ % d->capacity] = *t;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static bool deque_pop(deque *d, task *t) {
+    pthread_mutex_lock(&d->lock);
+    bool found = d->bottom > d->top;
+    if (found) {
+        *t = d->tasks[--d->bottom % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static bool deque_steal(deque *d, task *t) {
+    pthread_mutex_lock(&d->lock);
+    bool found = d->bottom > d->top;
+    if (found) {
+        *t = d->tasks[d->top++ % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
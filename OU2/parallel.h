@@ -0,0 +1,48 @@
+#ifndef PARALLEL
+#define PARALLEL
+
+#include <stddef.h>
+
+/*
+ * Runs func(context, i) for every i in [0, count) on up to threads
+ * threads, including the calling thread. The indices are handed out in
+ * order, one at a time, so work items of different sizes even out.
+ * Returns when all calls have returned.
+ */
+void parallel_for(size_t count, int threads, void (*func)(void *context, size_t i),
+                  void *context);
+
+/*
+ * A worker thread of parallel_tasks. Tasks get the worker that runs
+ * them, so they can spawn more tasks.
+ */
+typedef struct task_worker task_worker;
+typedef void (*task_func)(task_worker *worker, void *context, size_t i);
+
+/*
+ * Runs func(worker, context, i) for every i in [0, count) on up to
+ * threads threads, including the calling thread, and every task that
+ * these spawn. Each thread has a deque of tasks. It runs the task it
+ * spawned last, and when its deque is empty it steals the oldest task
+ * of another thread, so that the large tasks that are spawned first
+ * spread out over the threads. Returns when all tasks have returned.
+ */
+void parallel_tasks(size_t count, int threads, task_func func, void *context);
+
+/*
+ * Adds the task func(worker, context, i) to the deque of the worker.
+ */
+void parallel_spawn(task_worker *worker, task_func func, void *context, size_t i);
+
+/*
+ * Returns the index of the worker in [0, threads) of its parallel_tasks
+ * call, so that tasks can keep per-thread state without locks.
+ */
+int parallel_worker_index(const task_worker *worker);
+
+/*
+ * Returns the number of online processors, at least 1.
+ */
+int parallel_processors(void);
+
+#endif
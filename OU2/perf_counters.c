@@ -0,0 +1,147 @@
+#define _GNU_SOURCE
+
+#include "perf_counters.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+static const char *const names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "branch-misses", "L1D-misses"
+};
+
+/* A read of the group with PERF_FORMAT_GROUP, the values in the order
+   the counters joined it */
+typedef struct {
+    uint64_t count;
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t value[PERF_COUNTER_COUNT];
+} group_read;
+
+static bool read_group(const perf_counters *pc, group_read *r);
+
+int perf_counters_open(perf_counters *pc) {
+    int opened = 0;
+    pc->leader = -1;
+    pc->start_enabled = 0;
+    pc->start_running = 0;
+    pc->error = NULL;
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        pc->fd[i] = -1;
+        pc->slot[i] = -1;
+        pc->start[i] = 0;
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (i) {
+        case PERF_CYCLES:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_BRANCH_MISSES:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        }
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        /* The first counter that opens leads the group, normally the
+           cycles */
+        pc->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, pc->leader, 0);
+        if (pc->fd[i] < 0 && pc->error == NULL) {
+            pc->error = strerror(errno);
+        }
+        if (pc->fd[i] >= 0) {
+            if (pc->leader < 0) {
+                pc->leader = pc->fd[i];
+            }
+            pc->slot[i] = opened;
+        }
+#else
+        pc->error = "not supported on this system";
+#endif
+        opened += pc->fd[i] >= 0;
+    }
+
+    return opened;
+}
+
+void perf_counters_start(perf_counters *pc) {
+    group_read r;
+    bool valid = read_group(pc, &r);
+    pc->start_enabled = valid ? r.enabled : 0;
+    pc->start_running = valid ? r.running : 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        pc->start[i] = valid && pc->slot[i] >= 0 ? r.value[pc->slot[i]] : 0;
+    }
+}
+
+/* The counts are the differences of the raw values, scaled by the
+   share of the measurement the group ran, since the difference of two
+   totals scaled by their own ratios is not the count of the time
+   between them */
+void perf_counters_stop(perf_counters *pc, perf_sample *sample) {
+    group_read r;
+    bool valid = read_group(pc, &r);
+    uint64_t enabled = valid ? r.enabled - pc->start_enabled : 0;
+    uint64_t running = valid ? r.running - pc->start_running : 0;
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        sample->valid[i] = valid && pc->slot[i] >= 0;
+        sample->value[i] = 0;
+        if (!sample->valid[i] || running == 0) {
+            continue;
+        }
+        uint64_t value = r.value[pc->slot[i]];
+        uint64_t delta = value > pc->start[i] ? value - pc->start[i] : 0;
+        if (running < enabled) {
+            delta = (uint64_t)((double)delta * enabled / running);
+        }
+        sample->value[i] = delta;
+    }
+}
+
+void perf_counters_close(perf_counters *pc) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (pc->fd[i] >= 0) {
+            close(pc->fd[i]);
+            pc->fd[i] = -1;
+        }
+        pc->slot[i] = -1;
+    }
+    pc->leader = -1;
+}
+
+const char *perf_counter_name(int counter) {
+    return names[counter];
+}
+
+/* Reads all the counters of the group at once */
+static bool read_group(const perf_counters *pc, group_read *r) {
+    if (pc->leader < 0) {
+        return false;
+    }
+    ssize_t n = read(pc->leader, r, sizeof(*r));
+    return n >= (ssize_t)(3 * sizeof(uint64_t)) &&
+           r->count <= PERF_COUNTER_COUNT &&
+           (size_t)n == (3 + r->count) * sizeof(uint64_t);
+}
@@ -0,0 +1,77 @@
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Hardware performance counters of the calling thread and the threads
+ * it starts, read with perf_event_open. Only user space is counted, so
+ * the default perf_event_paranoid setting of 2 is enough.
+ *
+ * The counters are opened as one group, which the kernel always runs
+ * together, so ratios such as instructions per cycle compare counts of
+ * the same time. Counters that the kernel or the processor does not
+ * offer, or that are not allowed, are left out, and all of them are
+ * left out on other systems than Linux. Counts of threads are added
+ * when the threads exit, so a measurement must join the threads it
+ * starts.
+ */
+
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_BRANCH_MISSES 2
+#define PERF_L1D_MISSES 3
+#define PERF_COUNTER_COUNT 4
+
+/*
+ * fd             The file descriptor of each counter, or -1 if it is
+ *                missing.
+ * leader         The file descriptor of the group, which reads all the
+ *                counters at once, or -1 if none could be opened.
+ * slot           The place of each counter in a read of the group.
+ * start          The raw value of each counter at perf_counters_start.
+ * start_enabled  The time the group had been enabled and running at
+ * start_running  perf_counters_start.
+ * error          Why the first counter that is missing could not be
+ *                opened.
+ */
+typedef struct {
+    int fd[PERF_COUNTER_COUNT];
+    int leader;
+    int slot[PERF_COUNTER_COUNT];
+    uint64_t start[PERF_COUNTER_COUNT];
+    uint64_t start_enabled;
+    uint64_t start_running;
+    const char *error;
+} perf_counters;
+
+/*
+ * value   The count of each counter, scaled up if the group only ran
+ *         for part of the measurement because the kernel shared the
+ *         hardware.
+ * valid   Whether the counter was available.
+ */
+typedef struct {
+    uint64_t value[PERF_COUNTER_COUNT];
+    bool valid[PERF_COUNTER_COUNT];
+} perf_sample;
+
+/*
+ * Opens the counters. Returns the number of counters that could be
+ * opened, 0 if none.
+ */
+int perf_counters_open(perf_counters *pc);
+
+/* Starts a measurement. */
+void perf_counters_start(perf_counters *pc);
+
+/* Stores the counts since perf_counters_start in sample. */
+void perf_counters_stop(perf_counters *pc, perf_sample *sample);
+
+void perf_counters_close(perf_counters *pc);
+
+/* Returns a short name of the counter, such as "cycles". */
+const char *perf_counter_name(int counter);
+
+#endif
@@ -2,9 +2,12 @@
  * A data type representing a priority gueue.
  *
  * The data type represent a priority queue. The priority queue uses
- * a list as the internal representation. Takes a compare function
- * when creating a new priority queue, the compare function is used
- * to determine priority of elements within the priority queue.
+ * a binary min-heap stored in an array as the internal representation.
+ * Each element carries a sequence number, and elements with equal
+ * priority are ordered by it, so they leave the queue in the order
+ * they were inserted. Takes a compare function when creating a new
+ * priority queue, the compare function is used to determine priority
+ * of elements within the priority queue.
  *
  * For more information see the corresponding .h-file.
  *
@@ -19,30 +22,89 @@
  */
 
 #include <stdlib.h>
-#include "list.h"
+#include <string.h>
 #include "pqueue.h"
 #include <assert.h>
 
+/* The initial number of elements in the heap array */
+#define PQUEUE_INITIAL_CAPACITY 16
+
 /* A structure used to represent an element in a priority queue.
  *
- * @elem the_list  A pointer to the internally used list.
+ * @elem value     A pointer to the value of the element.
+ * @elem seq       The insertion sequence number of the element.
+ */
+struct pqueue_entry {
+	void *value;
+	unsigned long seq;
+};
+
+/* A structure used to represent a priority queue.
+ *
+ * @elem heap      The heap array. heap[0] is the first element.
+ * @elem size      The number of elements in the queue.
+ * @elem capacity  The number of elements the heap array can hold.
+ * @elem next_seq  The sequence number of the next inserted element.
  * @elem cmp_func  The function used to decide priority between
  *                 elements in the priority queue.
+ * @elem mfunc     The function for handling dynamically allocated
+ *                 memory.
  */
 struct pqueue {
-	list *the_list;
+	struct pqueue_entry *heap;
+	size_t size;
+	size_t capacity;
+	unsigned long next_seq;
 	pqueue_cmp_func cmp_func;
+	pqueue_mem_func mfunc;
 };
 
 
+/* Declaration of internal functions */
+static bool entry_before(const pqueue *const pq,
+                         const struct pqueue_entry *a,
+                         const struct pqueue_entry *b);
+static void sift_up(pqueue *const pq, size_t i);
+static void sift_down(pqueue *const pq, size_t i);
+static void remove_first(pqueue *const pq);
+static void grow(pqueue *const pq, size_t capacity);
+
+
 pqueue* pqueue_empty(pqueue_cmp_func cmp_func)
 {
 	pqueue* pq = malloc(sizeof *pq);
 	assert(pq);
 
-	pq->the_list = list_empty();
-	assert(pq->the_list);
+	pq->heap = malloc(PQUEUE_INITIAL_CAPACITY * sizeof *pq->heap);
+	assert(pq->heap);
+	pq->size = 0;
+	pq->capacity = PQUEUE_INITIAL_CAPACITY;
+	pq->next_seq = 0;
 	pq->cmp_func = cmp_func;
+	pq->mfunc = NULL;
+
+	return pq;
+}
+
+
+pqueue* pqueue_from_array(void *const values[], size_t n,
+                          pqueue_cmp_func cmp_func)
+{
+	pqueue* pq = pqueue_empty(cmp_func);
+	grow(pq, n);
+
+	for (size_t i = 0; i < n; i++) {
+		pq->heap[i].value = values[i];
+		pq->heap[i].seq = i;
+	}
+	pq->size = n;
+	pq->next_seq = n;
+
+	/* Floyd's heap construction: sift down every inner node, the last
+	   one first */
+	for (size_t i = n / 2; i > 0; i--) {
+		sift_down(pq, i - 1);
+	}
 
 	return pq;
 }
@@ -52,19 +114,22 @@ void pqueue_set_memhandler(const pqueue *const pq,
                            pqueue_mem_func mfunc)
 {
 	assert(pq);
-	assert(pq->the_list);
 
-	list_set_memhandler(pq->the_list, mfunc);
+	/* The queue is always allocated by pqueue_empty, so it is never
+	   actually const */
+	((pqueue *)pq)->mfunc = mfunc;
 }
 
 
 void pqueue_delete_first(pqueue *const pq)
 {
 	assert(pq);
-	assert(pq->the_list);
 
-	if(!list_is_empty(pq->the_list)) {
-		list_remove(pq->the_list, list_first(pq->the_list));
+	if(pq->size > 0) {
+		if (pq->mfunc != NULL) {
+			pq->mfunc(pq->heap[0].value);
+		}
+		remove_first(pq);
 	}
 }
 
@@ -72,51 +137,89 @@ void pqueue_delete_first(pqueue *const pq)
 void pqueue_insert(pqueue *const pq, void *value)
 {
 	assert(pq);
-	assert(pq->the_list);
-
-	if(list_is_empty(pq->the_list)) {
-		list_insert(pq->the_list, list_first(pq->the_list), value);
-	} else {
-		list_position pos = list_first(pq->the_list);
-		while(!list_is_end(pq->the_list, pos)) {
-			if(pq->cmp_func != NULL) {
-				if(pq->cmp_func(value, list_inspect(pq->the_list,
-					                                 pos)) < 0) {
-					list_insert(pq->the_list, pos, value);
-					return;
-				}
-			}
-			pos = list_next(pq->the_list, pos);
-		}
-		list_insert(pq->the_list, pos, value);
+
+	if (pq->size == pq->capacity) {
+		grow(pq, 2 * pq->capacity);
+	}
+
+	pq->heap[pq->size].value = value;
+	pq->heap[pq->size].seq = pq->next_seq++;
+	pq->size++;
+	sift_up(pq, pq->size - 1);
+}
+
+
+size_t pqueue_pop_n(pqueue *const pq, void *values[], size_t n)
+{
+	assert(pq);
+
+	size_t popped = 0;
+	while (popped < n && pq->size > 0) {
+		values[popped++] = pq->heap[0].value;
+		remove_first(pq);
+	}
+
+	return popped;
+}
+
+
+bool pqueue_merge_first_two(pqueue *const pq, pqueue_merge_func merge_func)
+{
+	assert(pq);
+	assert(merge_func);
+
+	if (pq->size < 2) {
+		return false;
 	}
+
+	void *first = pq->heap[0].value;
+	remove_first(pq);
+
+	/* The merged value replaces the second element at the root, which
+	   needs one sift instead of a removal and an insertion */
+	pq->heap[0].value = merge_func(first, pq->heap[0].value);
+	pq->heap[0].seq = pq->next_seq++;
+	sift_down(pq, 0);
+
+	return true;
 }
 
 
 void* pqueue_inspect_first(const pqueue *const pq)
 {
 	assert(pq);
-	assert(pq->the_list);
+	assert(pq->size > 0);
 
-	return list_inspect(pq->the_list, list_first(pq->the_list));
+	return pq->heap[0].value;
 }
 
 
 bool pqueue_is_empty(const pqueue *const pq)
 {
 	assert(pq);
-	assert(pq->the_list);
 
-	return list_is_empty(pq->the_list);
+	return pq->size == 0;
+}
+
+
+size_t pqueue_size(const pqueue *const pq)
+{
+	assert(pq);
+
+	return pq->size;
 }
 
 
 void pqueue_kill(pqueue *pq)
 {
 	assert(pq);
-	assert(pq->the_list);
 
-	list_kill(pq->the_list);
+	if (pq->mfunc != NULL) {
+		for (size_t i = 0; i < pq->size; i++) {
+			pq->mfunc(pq->heap[i].value);
+		}
+	}
+	free(pq->heap);
 	free(pq);
 }
 
@@ -127,13 +230,18 @@ void pqueue_print(const pqueue *const pq,
                   pqueue_print_func print_func)
 {
 	assert(pq);
-	assert(pq->the_list);
 
-	list_position pos = list_first(pq->the_list);
-	while(!list_is_end(pq->the_list, pos)){
-		print_func(list_inspect(pq->the_list, pos));
-		pos = list_next(pq->the_list, pos);
+	/* Print in priority order by emptying a copy of the heap */
+	pqueue copy = *pq;
+	copy.heap = malloc((pq->size > 0 ? pq->size : 1) * sizeof *copy.heap);
+	assert(copy.heap);
+	memcpy(copy.heap, pq->heap, pq->size * sizeof *copy.heap);
+
+	while (copy.size > 0) {
+		print_func(copy.heap[0].value);
+		remove_first(&copy);
 	}
+	free(copy.heap);
 }
 
 void print_func(void *data) {
@@ -142,3 +250,111 @@ void print_func(void *data) {
 }
 
 
+/* ---------------------- Internal functions ---------------------- */
+
+/*
+ * @brief           Checks if entry a should leave the queue before
+ *                  entry b.
+ *
+ * @param pq        The priority queue.
+ * @param a         The first entry.
+ * @param b         The second entry.
+ * @return          True if a has higher priority than b.
+ */
+static bool entry_before(const pqueue *const pq,
+                         const struct pqueue_entry *a,
+                         const struct pqueue_entry *b)
+{
+	if (pq->cmp_func != NULL) {
+		int cmp = pq->cmp_func(a->value, b->value);
+		if (cmp != 0) {
+			return cmp < 0;
+		}
+	}
+
+	return a->seq < b->seq;
+}
+
+
+/*
+ * @brief           Moves the entry at index i up until its parent is
+ *                  before it.
+ *
+ * @param pq        The priority queue.
+ * @param i         The index of the entry.
+ */
+static void sift_up(pqueue *const pq, size_t i)
+{
+	struct pqueue_entry entry = pq->heap[i];
+
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+		if (!entry_before(pq, &entry, &pq->heap[parent])) {
+			break;
+		}
+		pq->heap[i] = pq->heap[parent];
+		i = parent;
+	}
+	pq->heap[i] = entry;
+}
+
+
+/*
+ * @brief           Moves the entry at index i down until it is before
+ *                  both its children.
+ *
+ * @param pq        The priority queue.
+ * @param i         The index of the entry.
+ */
+static void sift_down(pqueue *const pq, size_t i)
+{
+	struct pqueue_entry entry = pq->heap[i];
+
+	while (2 * i + 1 < pq->size) {
+		size_t child = 2 * i + 1;
+		if (child + 1 < pq->size &&
+		    entry_before(pq, &pq->heap[child + 1], &pq->heap[child])) {
+			child++;
+		}
+		if (!entry_before(pq, &pq->heap[child], &entry)) {
+			break;
+		}
+		pq->heap[i] = pq->heap[child];
+		i = child;
+	}
+	pq->heap[i] = entry;
+}
+
+
+/*
+ * @brief           Removes the first entry without calling the memory
+ *                  handler.
+ *
+ * @param pq        The priority queue, which must not be empty.
+ */
+static void remove_first(pqueue *const pq)
+{
+	pq->size--;
+	if (pq->size > 0) {
+		pq->heap[0] = pq->heap[pq->size];
+		sift_down(pq, 0);
+	}
+}
+
+
+/*
+ * @brief           Makes room for at least capacity entries.
+ *
+ * @param pq        The priority queue.
+ * @param capacity  The number of entries needed.
+ */
+static void grow(pqueue *const pq, size_t capacity)
+{
+	if (capacity <= pq->capacity) {
+		return;
+	}
+
+	pq->heap = realloc(pq->heap, capacity * sizeof *pq->heap);
+	assert(pq->heap);
+	pq->capacity = capacity;
+}
@@ -44,6 +44,12 @@ typedef void (*pqueue_mem_func)(void*);
  */
 typedef int (*pqueue_cmp_func)(void*, void*);
 
+/**
+ * @brief             Function that is called for merging two elements
+ *                    into a new element, see pqueue_merge_first_two.
+ */
+typedef void *(*pqueue_merge_func)(void*, void*);
+
 /**
  * @brief             Function used for printing each element in the
  *                    priority queue.
@@ -67,6 +73,23 @@ typedef struct pqueue pqueue;
 pqueue* pqueue_empty(pqueue_cmp_func cmp_func);
 
 
+/**
+ * @brief             Create a new priority queue holding the given
+ *                    values. The queue is built in O(n) time, which is
+ *                    faster than inserting the values one at a time.
+ *                    Values with equal priority leave the queue in the
+ *                    order they have in the array.
+ *
+ * @param values      The values to put in the priority queue.
+ * @param n           The number of values.
+ * @param cmp_func    The compare function used to determine priority
+ *                    within the queue.
+ * @return            The new priority queue.
+ */
+pqueue* pqueue_from_array(void *const values[], size_t n,
+                          pqueue_cmp_func cmp_func);
+
+
 /**
  * @brief             Set the memory handling funciton for the
  *                    priority queue.
@@ -100,6 +123,36 @@ void pqueue_delete_first(pqueue *const pq);
 void pqueue_insert(pqueue *const pq, void* value);
 
 
+/**
+ * @brief             Remove up to n elements from the front of the
+ *                    priority queue and store their values in priority
+ *                    order. The memory handling function is not
+ *                    called, the values are handed over to the caller.
+ *
+ * @param pq          The priority queue.
+ * @param values      The array to store the values in.
+ * @param n           The maximum number of elements to remove.
+ * @return            The number of removed elements.
+ */
+size_t pqueue_pop_n(pqueue *const pq, void *values[], size_t n);
+
+
+/**
+ * @brief             Remove the first two elements and insert the
+ *                    value that merge_func returns for them. The
+ *                    memory handling function is not called for the
+ *                    two removed values. This is the step used to
+ *                    build a Huffman trie.
+ *
+ * @param pq          The priority queue.
+ * @param merge_func  The function creating the merged value, called
+ *                    with the first and the second value.
+ * @return            True if the elements were merged, false if the
+ *                    queue has less than two elements.
+ */
+bool pqueue_merge_first_two(pqueue *const pq, pqueue_merge_func merge_func);
+
+
 /**
  * @brief             Get the value from the front element in the
  *                    priority queue.
@@ -120,6 +173,15 @@ void *pqueue_inspect_first(const pqueue *const pq);
 bool pqueue_is_empty(const pqueue *const pq);
 
 
+/**
+ * @brief             Get the number of elements in the priority queue.
+ *
+ * @param pq          The priority queue.
+ * @return            The number of elements.
+ */
+size_t pqueue_size(const pqueue *const pq);
+
+
 /**
  * @brief             Deallocate resources for the priority queue.
  *
@@ -0,0 +1,174 @@
+/**
+ * @defgroup pqueue_def_h Type specialized priority queue
+ *
+ * @brief A macro generating a priority queue for one element type.
+ *
+ * PQUEUE_DEFINE(name, type, less) defines the type name, a binary
+ * min-heap holding elements of type by value, and static inline
+ * functions name_empty, name_from_array, name_insert, name_first,
+ * name_delete_first, name_replace_first, name_is_empty, name_size and
+ * name_kill. name_delete_first and name_replace_first return the
+ * element that was first. less(a, b) is called with two const type
+ * pointers and must return true if a should leave the queue before b.
+ * It is expanded in place, so it can be a macro or an inline function
+ * and is inlined into the heap operations, unlike the compare function
+ * of pqueue.h.
+ *
+ * The heap does not keep equal elements in insertion order. If a
+ * deterministic order is needed, put a sequence number in the element
+ * and let less compare it on ties.
+ *
+ * Example:
+ *
+ *     #define int_less(a, b) (*(a) < *(b))
+ *     PQUEUE_DEFINE(int_pq, int, int_less)
+ *
+ *     int_pq *pq = int_pq_empty();
+ *     int_pq_insert(pq, 3);
+ *
+ * @{
+ */
+
+#ifndef PQUEUE_DEF_H
+#define PQUEUE_DEF_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PQUEUE_DEF_INITIAL_CAPACITY 16
+
+#define PQUEUE_DEFINE(name, type, less)                                      \
+                                                                             \
+typedef struct name {                                                        \
+	type *heap;                                                          \
+	size_t size;                                                         \
+	size_t capacity;                                                     \
+} name;                                                                      \
+                                                                             \
+static inline void name##_sift_up(name *const pq, size_t i)                  \
+{                                                                            \
+	type elem = pq->heap[i];                                             \
+	while (i > 0) {                                                      \
+		size_t parent = (i - 1) / 2;                                 \
+		if (!(less(&elem, &pq->heap[parent]))) {                     \
+			break;                                               \
+		}                                                            \
+		pq->heap[i] = pq->heap[parent];                              \
+		i = parent;                                                  \
+	}                                                                    \
+	pq->heap[i] = elem;                                                  \
+}                                                                            \
+                                                                             \
+static inline void name##_sift_down(name *const pq, size_t i)                \
+{                                                                            \
+	type elem = pq->heap[i];                                             \
+	size_t half = pq->size / 2;                                          \
+	while (i < half) {                                                   \
+		size_t child = 2 * i + 1;                                    \
+		if (child + 1 < pq->size &&                                  \
+		    less(&pq->heap[child + 1], &pq->heap[child])) {          \
+			child++;                                             \
+		}                                                            \
+		if (!(less(&pq->heap[child], &elem))) {                      \
+			break;                                               \
+		}                                                            \
+		pq->heap[i] = pq->heap[child];                               \
+		i = child;                                                   \
+	}                                                                    \
+	pq->heap[i] = elem;                                                  \
+}                                                                            \
+                                                                             \
+static inline void name##_reserve(name *const pq, size_t capacity)           \
+{                                                                            \
+	if (capacity > pq->capacity) {                                       \
+		pq->heap = realloc(pq->heap, capacity * sizeof(type));       \
+		assert(pq->heap);                                            \
+		pq->capacity = capacity;                                     \
+	}                                                                    \
+}                                                                            \
+                                                                             \
+static inline name *name##_empty(void)                                       \
+{                                                                            \
+	name *pq = malloc(sizeof *pq);                                       \
+	assert(pq);                                                          \
+	pq->heap = NULL;                                                     \
+	pq->size = 0;                                                        \
+	pq->capacity = 0;                                                    \
+	name##_reserve(pq, PQUEUE_DEF_INITIAL_CAPACITY);                     \
+	return pq;                                                           \
+}                                                                            \
+                                                                             \
+static inline name *name##_from_array(const type *values, size_t n)         \
+{                                                                            \
+	name *pq = name##_empty();                                           \
+	name##_reserve(pq, n);                                               \
+	if (n > 0) {                                                         \
+		memcpy(pq->heap, values, n * sizeof(type));                  \
+	}                                                                    \
+	pq->size = n;                                                        \
+	for (size_t i = n / 2; i > 0; i--) {                                 \
+		name##_sift_down(pq, i - 1);                                 \
+	}                                                                    \
+	return pq;                                                           \
+}                                                                            \
+                                                                             \
+static inline void name##_insert(name *const pq, type value)                 \
+{                                                                            \
+	if (pq->size == pq->capacity) {                                      \
+		name##_reserve(pq, 2 * pq->capacity);                        \
+	}                                                                    \
+	pq->heap[pq->size++] = value;                                        \
+	name##_sift_up(pq, pq->size - 1);                                    \
+}                                                                            \
+                                                                             \
+static inline type name##_first(const name *const pq)                        \
+{                                                                            \
+	assert(pq->size > 0);                                                \
+	return pq->heap[0];                                                  \
+}                                                                            \
+                                                                             \
+static inline type name##_delete_first(name *const pq)                       \
+{                                                                            \
+	assert(pq->size > 0);                                                \
+	type first = pq->heap[0];                                            \
+	pq->size--;                                                          \
+	if (pq->size > 0) {                                                  \
+		pq->heap[0] = pq->heap[pq->size];                            \
+		name##_sift_down(pq, 0);                                     \
+	}                                                                    \
+	return first;                                                        \
+}                                                                            \
+                                                                             \
+static inline type name##_replace_first(name *const pq, type value)          \
+{                                                                            \
+	assert(pq->size > 0);                                                \
+	type first = pq->heap[0];                                            \
+	pq->heap[0] = value;                                                 \
+	name##_sift_down(pq, 0);                                             \
+	return first;                                                        \
+}                                                                            \
+                                                                             \
+static inline bool name##_is_empty(const name *const pq)                     \
+{                                                                            \
+	return pq->size == 0;                                                \
+}                                                                            \
+                                                                             \
+static inline size_t name##_size(const name *const pq)                       \
+{                                                                            \
+	return pq->size;                                                     \
+}                                                                            \
+                                                                             \
+static inline void name##_kill(name *pq)                                     \
+{                                                                            \
+	free(pq->heap);                                                      \
+	free(pq);                                                            \
+}
+
+#endif
+
+/**
+ * @}
+ */
@@ -0,0 +1,18 @@
+#include "preset.h"
+#include <string.h>
+#include "presets_data.h"
+
+const huffman_table *preset_find(const char *name) {
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        if (strcmp(presets[i].name, name) == 0) {
+            return presets[i].table;
+        }
+    }
+    return NULL;
+}
+
+void preset_print_names(FILE *fp) {
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        fprintf(fp, "%s%s", i > 0 ? " " : "", presets[i].name);
+    }
+}
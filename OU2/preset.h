@@ -0,0 +1,29 @@
+#ifndef PRESET
+#define PRESET
+
+#include <stdio.h>
+#include "huffman_table.h"
+
+/*
+ * Built-in models, which can be used instead of a FILE0. The tables are
+ * generated by gen_presets when the program is built, from the training
+ * files listed in the Makefile, and compiled in as constants.
+ */
+
+typedef struct {
+    const char *name;
+    const huffman_table *table;
+} preset;
+
+/*
+ * Returns the table of the preset with the given name, or NULL if there
+ * is none.
+ */
+const huffman_table *preset_find(const char *name);
+
+/*
+ * Prints the names of the presets, separated by spaces.
+ */
+void preset_print_names(FILE *fp);
+
+#endif
@@ -0,0 +1,171 @@
+#include "rle.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RLE_X86
+#endif
+
+typedef size_t (*scan_func)(const unsigned char *p, size_t n);
+
+static void select_scanners(void);
+static size_t run_length_scalar(const unsigned char *p, size_t n);
+static size_t next_pair_scalar(const unsigned char *p, size_t n);
+
+static scan_func run_length_impl;
+static scan_func next_pair_impl;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+size_t rle_encode(const unsigned char *data, size_t n, uint16_t *tokens) {
+    size_t used = 0;
+    size_t i = 0;
+
+    while (i < n) {
+        /* Copy the characters up to the next pair as they are */
+        size_t literals = rle_next_pair(data + i, n - i);
+        for (size_t j = 0; j < literals; j++) {
+            tokens[used++] = data[i + j];
+        }
+        i += literals;
+        if (i == n) {
+            break;
+        }
+
+        size_t run = rle_run_length(data + i, n - i);
+        if (run < RLE_MIN_RUN) {
+            for (size_t j = 0; j < run; j++) {
+                tokens[used++] = data[i];
+            }
+        } else {
+            tokens[used++] = data[i];
+            for (size_t repeats = run - 1; repeats > 0; ) {
+                if (repeats & 1) {
+                    tokens[used++] = RLE_RUNA;
+                    repeats = (repeats - 1) / 2;
+                } else {
+                    tokens[used++] = RLE_RUNB;
+                    repeats = (repeats - 2) / 2;
+                }
+            }
+        }
+        i += run;
+    }
+
+    return used;
+}
+
+size_t rle_run_length(const unsigned char *p, size_t n) {
+    pthread_once(&select_once, select_scanners);
+    return run_length_impl(p, n);
+}
+
+size_t rle_next_pair(const unsigned char *p, size_t n) {
+    pthread_once(&select_once, select_scanners);
+    return next_pair_impl(p, n);
+}
+
+#ifdef RLE_X86
+__attribute__((target("avx2")))
+static size_t run_length_avx2(const unsigned char *p, size_t n) {
+    __m256i c = _mm256_set1_epi8((char)p[0]);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        uint32_t differ = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c));
+        if (differ != 0) {
+            return i + __builtin_ctz(differ);
+        }
+    }
+    while (i < n && p[i] == p[0]) {
+        i++;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t next_pair_avx2(const unsigned char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 33 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+        uint32_t equal = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+        if (equal != 0) {
+            return i + __builtin_ctz(equal);
+        }
+    }
+    return i + next_pair_scalar(p + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static size_t run_length_sse2(const unsigned char *p, size_t n) {
+    __m128i c = _mm_set1_epi8((char)p[0]);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        uint32_t differ = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, c)) & 0xffff;
+        if (differ != 0) {
+            return i + __builtin_ctz(differ);
+        }
+    }
+    while (i < n && p[i] == p[0]) {
+        i++;
+    }
+    return i;
+}
+
+__attribute__((target("sse2")))
+static size_t next_pair_sse2(const unsigned char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 17 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + i + 1));
+        uint32_t equal = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+        if (equal != 0) {
+            return i + __builtin_ctz(equal);
+        }
+    }
+    return i + next_pair_scalar(p + i, n - i);
+}
+#endif
+
+static void select_scanners(void) {
+    run_length_impl = run_length_scalar;
+    next_pair_impl = next_pair_scalar;
+#ifdef RLE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        run_length_impl = run_length_avx2;
+        next_pair_impl = next_pair_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        run_length_impl = run_length_sse2;
+        next_pair_impl = next_pair_sse2;
+    }
+#endif
+}
+
+/* Compares eight characters at a time with a word of copies of p[0] */
+static size_t run_length_scalar(const unsigned char *p, size_t n) {
+    uint64_t c = p[0] * 0x0101010101010101ULL;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        if (word != c) {
+            break;
+        }
+    }
+    while (i < n && p[i] == p[0]) {
+        i++;
+    }
+    return i;
+}
+
+static size_t next_pair_scalar(const unsigned char *p, size_t n) {
+    for (size_t i = 0; i + 1 < n; i++) {
+        if (p[i] == p[i + 1]) {
+            return i;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,43 @@
+#ifndef RLE
+#define RLE
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Run-length coding of repeated characters.
+ *
+ * A run of at least RLE_MIN_RUN equal characters is coded as the
+ * character followed by the number of repeats in bijective base 2,
+ * least significant digit first, with the digits RLE_RUNA (1) and
+ * RLE_RUNB (2) as in bzip2. A run of a million zeros thus takes 21
+ * symbols. Other characters are coded as themselves.
+ *
+ * Since the value of a digit only depends on its position, a decoder
+ * can write the repeats of each digit as soon as it sees it.
+ */
+
+#define RLE_RUNA 256
+#define RLE_RUNB 257
+#define RLE_SYMBOLS 258
+#define RLE_MIN_RUN 4
+
+/*
+ * Codes the n characters in data as symbols in tokens, which must have
+ * room for n symbols. Returns the number of symbols.
+ */
+size_t rle_encode(const unsigned char *data, size_t n, uint16_t *tokens);
+
+/*
+ * Returns the number of characters at the start of the n > 0
+ * characters in p that are equal to p[0].
+ */
+size_t rle_run_length(const unsigned char *p, size_t n);
+
+/*
+ * Returns the first index i with p[i] == p[i + 1] among the n
+ * characters in p, or n if there is none.
+ */
+size_t rle_next_pair(const unsigned char *p, size_t n);
+
+#endif
@@ -0,0 +1,183 @@
+#include "sais.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IS_LMS(t, i) ((i) > 0 && (t)[i] && !(t)[(i) - 1])
+
+static int sais_core(const int32_t *s, int32_t *sa, int32_t n, int32_t k);
+static void get_buckets(const int32_t *s, int32_t *bkt, int32_t n, int32_t k, int end);
+static void induce_l(const int32_t *s, int32_t *sa, const unsigned char *t,
+                     int32_t *bkt, int32_t n, int32_t k);
+static void induce_s(const int32_t *s, int32_t *sa, const unsigned char *t,
+                     int32_t *bkt, int32_t n, int32_t k);
+
+int sais(const unsigned char *data, int32_t *sa, int32_t n) {
+    /* The core needs a unique smallest character at the end */
+    int32_t *s = malloc((n + 1) * sizeof(int32_t));
+    if (s == NULL) {
+        return -1;
+    }
+    for (int32_t i = 0; i < n; i++) {
+        s[i] = data[i] + 1;
+    }
+    s[n] = 0;
+
+    int err = sais_core(s, sa, n + 1, 257);
+    free(s);
+
+    /* Drop the sentinel, which always sorts first */
+    if (err == 0) {
+        memmove(sa, sa + 1, n * sizeof(int32_t));
+    }
+    return err;
+}
+
+/*
+ * Sorts the suffixes of s, whose n characters are in [0, k) and whose
+ * last character is a unique 0. Suffixes are S-type if they are smaller
+ * than the next suffix and L-type otherwise. An S-type suffix after an
+ * L-type one is a left-most S-type (LMS) suffix.
+ */
+static int sais_core(const int32_t *s, int32_t *sa, int32_t n, int32_t k) {
+    unsigned char *t = malloc(n);
+    int32_t *bkt = malloc(k * sizeof(int32_t));
+    if (t == NULL || bkt == NULL) {
+        free(t);
+        free(bkt);
+        return -1;
+    }
+
+    t[n - 1] = 1;
+    for (int32_t i = n - 2; i >= 0; i--) {
+        t[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && t[i + 1]);
+    }
+
+    /* Sort the LMS substrings by placing the LMS suffixes at the ends
+       of their buckets and inducing the rest */
+    get_buckets(s, bkt, n, k, 1);
+    for (int32_t i = 0; i < n; i++) {
+        sa[i] = -1;
+    }
+    for (int32_t i = 1; i < n; i++) {
+        if (IS_LMS(t, i)) {
+            sa[--bkt[s[i]]] = i;
+        }
+    }
+    induce_l(s, sa, t, bkt, n, k);
+    induce_s(s, sa, t, bkt, n, k);
+
+    /* Move the sorted LMS substrings to the front */
+    int32_t n1 = 0;
+    for (int32_t i = 0; i < n; i++) {
+        if (IS_LMS(t, sa[i])) {
+            sa[n1++] = sa[i];
+        }
+    }
+
+    /* Name the LMS substrings, equal substrings get the same name. No
+       two LMS positions are adjacent, so pos / 2 is unique. */
+    for (int32_t i = n1; i < n; i++) {
+        sa[i] = -1;
+    }
+    int32_t name = 0;
+    int32_t prev = -1;
+    for (int32_t i = 0; i < n1; i++) {
+        int32_t pos = sa[i];
+        int diff = 0;
+        for (int32_t d = 0; d < n; d++) {
+            if (prev == -1 || s[pos + d] != s[prev + d] || t[pos + d] != t[prev + d]) {
+                diff = 1;
+                break;
+            }
+            if (d > 0 && (IS_LMS(t, pos + d) || IS_LMS(t, prev + d))) {
+                break;
+            }
+        }
+        if (diff) {
+            name++;
+            prev = pos;
+        }
+        sa[n1 + pos / 2] = name - 1;
+    }
+    for (int32_t i = n - 1, j = n - 1; i >= n1; i--) {
+        if (sa[i] >= 0) {
+            sa[j--] = sa[i];
+        }
+    }
+
+    /* Sort the LMS suffixes, recursively if the names are not unique */
+    int32_t *s1 = sa + n - n1;
+    int err = 0;
+    if (name < n1) {
+        err = sais_core(s1, sa, n1, name);
+    } else {
+        for (int32_t i = 0; i < n1; i++) {
+            sa[s1[i]] = i;
+        }
+    }
+    if (err != 0) {
+        free(t);
+        free(bkt);
+        return err;
+    }
+
+    /* Induce the order of all suffixes from the sorted LMS suffixes */
+    get_buckets(s, bkt, n, k, 1);
+    for (int32_t i = 1, j = 0; i < n; i++) {
+        if (IS_LMS(t, i)) {
+            s1[j++] = i;
+        }
+    }
+    for (int32_t i = 0; i < n1; i++) {
+        sa[i] = s1[sa[i]];
+    }
+    for (int32_t i = n1; i < n; i++) {
+        sa[i] = -1;
+    }
+    for (int32_t i = n1 - 1; i >= 0; i--) {
+        int32_t j = sa[i];
+        sa[i] = -1;
+        sa[--bkt[s[j]]] = j;
+    }
+    induce_l(s, sa, t, bkt, n, k);
+    induce_s(s, sa, t, bkt, n, k);
+
+    free(t);
+    free(bkt);
+    return 0;
+}
+
+/* Stores the start, or the end, of the bucket of each character */
+static void get_buckets(const int32_t *s, int32_t *bkt, int32_t n, int32_t k, int end) {
+    memset(bkt, 0, k * sizeof(int32_t));
+    for (int32_t i = 0; i < n; i++) {
+        bkt[s[i]]++;
+    }
+    int32_t sum = 0;
+    for (int32_t c = 0; c < k; c++) {
+        sum += bkt[c];
+        bkt[c] = end ? sum : sum - bkt[c];
+    }
+}
+
+static void induce_l(const int32_t *s, int32_t *sa, const unsigned char *t,
+                     int32_t *bkt, int32_t n, int32_t k) {
+    get_buckets(s, bkt, n, k, 0);
+    for (int32_t i = 0; i < n; i++) {
+        int32_t j = sa[i] - 1;
+        if (j >= 0 && !t[j]) {
+            sa[bkt[s[j]]++] = j;
+        }
+    }
+}
+
+static void induce_s(const int32_t *s, int32_t *sa, const unsigned char *t,
+                     int32_t *bkt, int32_t n, int32_t k) {
+    get_buckets(s, bkt, n, k, 1);
+    for (int32_t i = n - 1; i >= 0; i--) {
+        int32_t j = sa[i] - 1;
+        if (j >= 0 && t[j]) {
+            sa[--bkt[s[j]]] = j;
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef SAIS
+#define SAIS
+
+#include <stdint.h>
+
+/*
+ * Suffix array construction by induced sorting (SA-IS), in linear time.
+ *
+ * G. Nong, S. Zhang and W. H. Chan, "Two Efficient Algorithms for
+ * Linear Time Suffix Array Construction", IEEE Transactions on
+ * Computers, 2011.
+ */
+
+/*
+ * Stores the start positions of the n suffixes of data in sorted order
+ * in sa, which must have room for n + 1 elements. A suffix that is a
+ * prefix of another sorts first. Returns 0 on success and -1 if memory
+ * runs out.
+ */
+int sais(const unsigned char *data, int32_t *sa, int32_t n);
+
+#endif
@@ -0,0 +1,587 @@
+#define _GNU_SOURCE
+
+#include "server.h"
+#include "ilist.h"
+#include "parallel.h"
+#include "byte_order.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+#define READ_SIZE (64 * 1024)
+
+/* The latencies of the last LATENCY_SAMPLES requests are kept for the
+   percentiles */
+#define LATENCY_SAMPLES 65536
+
+/*
+ * A client connection. While a request is handled, no more data is
+ * read from the connection, so in stays unchanged for the worker.
+ */
+typedef struct {
+    int fd;
+    unsigned char *in;
+    size_t in_used;
+    size_t in_capacity;
+    size_t frame;
+    bool busy;
+    bool registered;
+    unsigned char header[SERVE_ANSWER_HEADER];
+    unsigned char *body;
+    size_t body_size;
+    size_t sent;
+    double start;
+} connection;
+
+typedef struct {
+    ilist_link link;
+    connection *conn;
+    int op;
+    char *model;
+    const unsigned char *data;
+    size_t size;
+    int status;
+    unsigned char *answer;
+    size_t answer_size;
+} job;
+
+typedef struct model {
+    char *path;
+    huffman_table *table;
+    struct model *next;
+} model;
+
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;
+    const prog_options *options;
+    block_options blocks;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    ilist queue;
+    ilist done;
+    bool stopping;
+
+    pthread_mutex_t models_lock;
+    model *models;
+
+    uint64_t requests;
+    uint64_t errors;
+    double total_latency;
+    double max_latency;
+    double *latencies;
+} server;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig);
+static double now(void);
+static int open_socket(const char *socket_path);
+static void *worker(void *arg);
+static void handle_job(server *s, job *j);
+static huffman_table *get_model(server *s, const char *path, bool load);
+static void accept_connections(server *s);
+static void read_input(server *s, connection *conn);
+static void try_dispatch(server *s, connection *conn);
+static void finish_jobs(server *s);
+static void start_answer(server *s, connection *conn, int status,
+                         unsigned char *body, size_t size);
+static void flush_answer(server *s, connection *conn);
+static void close_connection(server *s, connection *conn);
+static void watch(server *s, connection *conn, uint32_t events);
+static void record_latency(server *s, double latency);
+static char *format_stats(server *s, size_t *size);
+static int compare_doubles(const void *a, const void *b);
+
+int serve(const char *socket_path, const char *preload[], int count,
+          const prog_options *options) {
+    server s;
+    memset(&s, 0, sizeof(s));
+    s.options = options;
+    s.blocks = options->blocks;
+    /* Parallelism comes from the worker pool, not from each request */
+    s.blocks.threads = 1;
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.ready, NULL);
+    pthread_mutex_init(&s.models_lock, NULL);
+    ilist_init(&s.queue);
+    ilist_init(&s.done);
+    s.latencies = malloc(LATENCY_SAMPLES * sizeof(double));
+
+    /* Under the absolute path, which is how clients name them */
+    for (int i = 0; i < count; i++) {
+        char *path = realpath(preload[i], NULL);
+        if (path == NULL || get_model(&s, path, true) == NULL) {
+            fprintf(stderr, "Could not load the model: %s\n", preload[i]);
+        }
+        free(path);
+    }
+
+    s.listen_fd = open_socket(socket_path);
+    s.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    s.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (s.listen_fd < 0 || s.wake_fd < 0 || s.epoll_fd < 0) {
+        fprintf(stderr, "Could not listen on the socket: %s\n", socket_path);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &s.listen_fd;
+    epoll_ctl(s.epoll_fd, EPOLL_CTL_ADD, s.listen_fd, &ev);
+    ev.data.ptr = &s.wake_fd;
+    epoll_ctl(s.epoll_fd, EPOLL_CTL_ADD, s.wake_fd, &ev);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int threads = options->blocks.threads > 0 ? options->blocks.threads
+                                              : parallel_processors();
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, worker, &s);
+    }
+    fprintf(stderr, "Serving on %s with %d workers\n", socket_path, threads);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (!stop_requested) {
+        int n = epoll_wait(s.epoll_fd, events, MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &s.listen_fd) {
+                accept_connections(&s);
+            } else if (events[i].data.ptr == &s.wake_fd) {
+                finish_jobs(&s);
+            } else {
+                connection *conn = events[i].data.ptr;
+                if (events[i].events & EPOLLOUT) {
+                    flush_answer(&s, conn);
+                } else if (conn->busy) {
+                    /* A hangup while a job runs is seen when the answer
+                       is sent */
+                    epoll_ctl(s.epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+                    conn->registered = false;
+                } else {
+                    read_input(&s, conn);
+                }
+            }
+        }
+    }
+
+    pthread_mutex_lock(&s.lock);
+    s.stopping = true;
+    pthread_cond_broadcast(&s.ready);
+    pthread_mutex_unlock(&s.lock);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    size_t size;
+    char *stats = format_stats(&s, &size);
+    fprintf(stderr, "%s", stats);
+    free(stats);
+
+    /* Open connections and unfinished jobs are dropped with the
+       process */
+    close(s.epoll_fd);
+    close(s.wake_fd);
+    close(s.listen_fd);
+    unlink(socket_path);
+    while (s.models != NULL) {
+        model *next = s.models->next;
+        free(s.models->path);
+        free(s.models->table);
+        free(s.models);
+        s.models = next;
+    }
+    free(s.latencies);
+
+    return 0;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_socket(const char *socket_path) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void *worker(void *arg) {
+    server *s = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (ilist_is_empty(&s->queue) && !s->stopping) {
+            pthread_cond_wait(&s->ready, &s->lock);
+        }
+        if (s->stopping) {
+            pthread_mutex_unlock(&s->lock);
+            return NULL;
+        }
+        ilist_position first = ilist_first(&s->queue);
+        job *j = ILIST_ENTRY(ilist_inspect(&s->queue, first), job, link);
+        ilist_remove(&s->queue, first);
+        pthread_mutex_unlock(&s->lock);
+
+        handle_job(s, j);
+
+        pthread_mutex_lock(&s->lock);
+        ilist_insert(&s->done, ilist_end(&s->done), &j->link);
+        pthread_mutex_unlock(&s->lock);
+
+        uint64_t one = 1;
+        if (write(s->wake_fd, &one, sizeof(one)) < 0) {
+            /* The counter is already non-zero, the loop wakes anyway */
+        }
+    }
+}
+
+static void handle_job(server *s, job *j) {
+    huffman_table *table = get_model(s, j->model, s->options->load_on_demand);
+    const char *error = NULL;
+
+    if (table == NULL) {
+        error = "Could not load the model";
+    } else if (j->op == SERVE_ENCODE) {
+        j->answer = encode_buffer(table, j->data, j->size, &s->blocks, &j->answer_size);
+    } else {
+        j->answer = decode_buffer(table, j->data, j->size, &s->blocks, &j->answer_size);
+        if (j->answer == NULL) {
+            error = "Could not decode the data";
+        }
+    }
+
+    j->status = error == NULL ? SERVE_OK : SERVE_ERROR;
+    if (error != NULL) {
+        j->answer = (unsigned char *)strdup(error);
+        j->answer_size = strlen(error);
+    }
+}
+
+/*
+ * Returns the model for FILE0 at path, and if load is set loads it if
+ * it is not loaded yet. The lock is not held while it loads, so the
+ * workers serving other models are not held up. Two workers may load
+ * the same model at once, and the one that comes second uses the table
+ * of the first.
+ */
+static huffman_table *get_model(server *s, const char *path, bool load) {
+    pthread_mutex_lock(&s->models_lock);
+    model *m = s->models;
+    while (m != NULL && strcmp(m->path, path) != 0) {
+        m = m->next;
+    }
+    pthread_mutex_unlock(&s->models_lock);
+    if (m != NULL || !load) {
+        return m != NULL ? m->table : NULL;
+    }
+
+    /* A model that fails to load is not kept, so it is tried again
+       and never served as NULL */
+    FILE *fp = fopen(path, "r");
+    huffman_table *table = fp != NULL ? load_table(fp, s->options) : NULL;
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    if (table == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&s->models_lock);
+    m = s->models;
+    while (m != NULL && strcmp(m->path, path) != 0) {
+        m = m->next;
+    }
+    if (m == NULL) {
+        m = malloc(sizeof(model));
+        m->path = strdup(path);
+        m->table = table;
+        m->next = s->models;
+        s->models = m;
+    } else {
+        free(table);
+    }
+    pthread_mutex_unlock(&s->models_lock);
+    return m->table;
+}
+
+static void accept_connections(server *s) {
+    for (;;) {
+        int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        connection *conn = calloc(1, sizeof(connection));
+        conn->fd = fd;
+        watch(s, conn, EPOLLIN);
+    }
+}
+
+static void read_input(server *s, connection *conn) {
+    for (;;) {
+        if (conn->in_capacity - conn->in_used < READ_SIZE) {
+            conn->in_capacity = conn->in_capacity * 2 + READ_SIZE;
+            conn->in = realloc(conn->in, conn->in_capacity);
+        }
+
+        ssize_t n = read(conn->fd, conn->in + conn->in_used, conn->in_capacity - conn->in_used);
+        if (n > 0) {
+            conn->in_used += n;
+            /* Stop reading once a whole request is here */
+            if (conn->in_used >= SERVE_REQUEST_HEADER) {
+                size_t frame = SERVE_REQUEST_HEADER + load_le32(conn->in + 1) +
+                               load_le64(conn->in + 5);
+                if (conn->in_used >= frame) {
+                    break;
+                }
+            }
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            close_connection(s, conn);
+            return;
+        }
+    }
+
+    try_dispatch(s, conn);
+}
+
+/* Starts on the next request if it is complete and the connection is
+   free */
+static void try_dispatch(server *s, connection *conn) {
+    if (conn->busy || conn->in_used < SERVE_REQUEST_HEADER) {
+        return;
+    }
+
+    int op = conn->in[0];
+    size_t model_length = load_le32(conn->in + 1);
+    uint64_t size = load_le64(conn->in + 5);
+    if ((op != SERVE_ENCODE && op != SERVE_DECODE && op != SERVE_STATS) ||
+        model_length > SERVE_MAX_MODEL_PATH || size > (uint64_t)SERVE_MAX_DATA) {
+        close_connection(s, conn);
+        return;
+    }
+
+    conn->frame = SERVE_REQUEST_HEADER + model_length + size;
+    if (conn->in_used < conn->frame) {
+        return;
+    }
+
+    conn->busy = true;
+    conn->start = now();
+    watch(s, conn, 0);
+
+    if (op == SERVE_STATS) {
+        size_t stats_size;
+        char *stats = format_stats(s, &stats_size);
+        start_answer(s, conn, SERVE_OK, (unsigned char *)stats, stats_size);
+        return;
+    }
+
+    job *j = calloc(1, sizeof(job));
+    j->conn = conn;
+    j->op = op;
+    j->model = strndup((const char *)conn->in + SERVE_REQUEST_HEADER, model_length);
+    j->data = conn->in + SERVE_REQUEST_HEADER + model_length;
+    j->size = size;
+
+    pthread_mutex_lock(&s->lock);
+    ilist_insert(&s->queue, ilist_end(&s->queue), &j->link);
+    pthread_cond_signal(&s->ready);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void finish_jobs(server *s) {
+    uint64_t count;
+    if (read(s->wake_fd, &count, sizeof(count)) < 0) {
+        /* Nothing to do, the done list is checked anyway */
+    }
+
+    ilist finished;
+    ilist_init(&finished);
+    pthread_mutex_lock(&s->lock);
+    while (!ilist_is_empty(&s->done)) {
+        ilist_position first = ilist_first(&s->done);
+        ilist_link *link = ilist_inspect(&s->done, first);
+        ilist_remove(&s->done, first);
+        ilist_insert(&finished, ilist_end(&finished), link);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    while (!ilist_is_empty(&finished)) {
+        ilist_position first = ilist_first(&finished);
+        job *j = ILIST_ENTRY(ilist_inspect(&finished, first), job, link);
+        ilist_remove(&finished, first);
+
+        if (j->status != SERVE_OK) {
+            s->errors++;
+        }
+        start_answer(s, j->conn, j->status, j->answer, j->answer_size);
+        free(j->model);
+        free(j);
+    }
+}
+
+/* Takes over body and starts sending the answer */
+static void start_answer(server *s, connection *conn, int status,
+                         unsigned char *body, size_t size) {
+    conn->header[0] = status;
+    store_le64(conn->header + 1, size);
+    conn->body = body;
+    conn->body_size = size;
+    conn->sent = 0;
+    flush_answer(s, conn);
+}
+
+static void flush_answer(server *s, connection *conn) {
+    size_t total = SERVE_ANSWER_HEADER + conn->body_size;
+
+    while (conn->sent < total) {
+        struct iovec iov[2];
+        int count = 0;
+        if (conn->sent < SERVE_ANSWER_HEADER) {
+            iov[count].iov_base = conn->header + conn->sent;
+            iov[count].iov_len = SERVE_ANSWER_HEADER - conn->sent;
+            count++;
+        }
+        size_t body_sent = conn->sent > SERVE_ANSWER_HEADER ? conn->sent - SERVE_ANSWER_HEADER : 0;
+        if (body_sent < conn->body_size) {
+            iov[count].iov_base = conn->body + body_sent;
+            iov[count].iov_len = conn->body_size - body_sent;
+            count++;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            watch(s, conn, EPOLLOUT);
+            return;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            conn->busy = false;
+            close_connection(s, conn);
+            return;
+        }
+    }
+
+    record_latency(s, now() - conn->start);
+    free(conn->body);
+    conn->body = NULL;
+    conn->body_size = 0;
+
+    /* Drop the request and go on with the next one, if it is here */
+    memmove(conn->in, conn->in + conn->frame, conn->in_used - conn->frame);
+    conn->in_used -= conn->frame;
+    conn->frame = 0;
+    conn->busy = false;
+    watch(s, conn, EPOLLIN);
+    try_dispatch(s, conn);
+}
+
+/* A busy connection has a job that points into it, so it is only
+   closed once the job is done */
+static void close_connection(server *s, connection *conn) {
+    if (conn->busy) {
+        watch(s, conn, 0);
+        return;
+    }
+    if (conn->registered) {
+        epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    }
+    close(conn->fd);
+    free(conn->in);
+    free(conn->body);
+    free(conn);
+}
+
+static void watch(server *s, connection *conn, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = conn;
+    epoll_ctl(s->epoll_fd, conn->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn->fd, &ev);
+    conn->registered = true;
+}
+
+static void record_latency(server *s, double latency) {
+    s->latencies[s->requests % LATENCY_SAMPLES] = latency;
+    s->requests++;
+    s->total_latency += latency;
+    if (latency > s->max_latency) {
+        s->max_latency = latency;
+    }
+}
+
+static char *format_stats(server *s, size_t *size) {
+    size_t samples = s->requests < LATENCY_SAMPLES ? s->requests : LATENCY_SAMPLES;
+    double *sorted = malloc((samples > 0 ? samples : 1) * sizeof(double));
+    memcpy(sorted, s->latencies, samples * sizeof(double));
+    qsort(sorted, samples, sizeof(double), compare_doubles);
+
+    double p50 = samples > 0 ? sorted[samples / 2] : 0.0;
+    double p99 = samples > 0 ? sorted[samples * 99 / 100] : 0.0;
+    double mean = s->requests > 0 ? s->total_latency / s->requests : 0.0;
+    free(sorted);
+
+    char *text = malloc(256);
+    int n = snprintf(text, 256,
+                     "requests %llu errors %llu latency mean %.3f ms p50 %.3f ms "
+                     "p99 %.3f ms max %.3f ms\n",
+                     (unsigned long long)s->requests, (unsigned long long)s->errors,
+                     mean * 1e3, p50 * 1e3, p99 * 1e3, s->max_latency * 1e3);
+    *size = n < 256 ? n : 255;
+    return text;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,53 @@
+#ifndef SERVER
+#define SERVER
+
+#include "huffman.h"
+
+/*
+ * A long-running server that encodes and decodes data for local
+ * clients over a Unix domain socket, with the models kept in memory.
+ *
+ * A request is
+ *
+ *   u8   op     SERVE_ENCODE, SERVE_DECODE or SERVE_STATS
+ *   u32  model  length of the path of FILE0
+ *   u64  size   length of the data
+ *        the path of FILE0, not 0-terminated
+ *        the data
+ *
+ * and the answer is
+ *
+ *   u8   status SERVE_OK or SERVE_ERROR
+ *   u64  size   length of the data
+ *        the encoded or decoded data, the statistics as text, or an
+ *        error message
+ *
+ * with all integers little-endian. A client may send several requests
+ * on one connection, and gets the answers in the same order.
+ */
+
+#define SERVE_ENCODE 'E'
+#define SERVE_DECODE 'D'
+#define SERVE_STATS 'S'
+
+#define SERVE_OK 0
+#define SERVE_ERROR 1
+
+#define SERVE_REQUEST_HEADER 13
+#define SERVE_ANSWER_HEADER 9
+#define SERVE_MAX_MODEL_PATH 4096
+#define SERVE_MAX_DATA (1LL << 32)
+
+/*
+ * Serves requests on socket_path until SIGINT or SIGTERM. The models in
+ * preload[0..count) are loaded before the first request, and requests
+ * for other models fail, unless options->load_on_demand is set, in
+ * which case they are loaded on first use. Clients name models by their
+ * absolute path. The requests are handled by options->blocks.threads
+ * worker threads. Returns 0 on a clean shutdown and -1 if the socket
+ * could not be set up.
+ */
+int serve(const char *socket_path, const char *preload[], int count,
+          const prog_options *options);
+
+#endif
@@ -0,0 +1,297 @@
+#include "tans.h"
+#include "bit_reader.h"
+#include "crc32c.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int highest_bit(uint32_t x);
+
+bool tans_normalize(const uint64_t *counts, uint16_t *norm) {
+    uint64_t total = 0;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        total += counts[s];
+    }
+    if (total == 0) {
+        return false;
+    }
+
+    int sum = 0;
+    int largest = -1;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        norm[s] = 0;
+        if (counts[s] == 0) {
+            continue;
+        }
+        double scaled = (double)counts[s] * TANS_TABLE_SIZE / total;
+        norm[s] = scaled < 1.0 ? 1 : (uint16_t)(scaled + 0.5);
+        sum += norm[s];
+        if (largest < 0 || norm[s] > norm[largest]) {
+            largest = s;
+        }
+    }
+
+    /* The rounding error goes to the most common character, where it
+       costs the least, unless the rare characters that were rounded up
+       to 1 took more than it has. Then every larger count gives up
+       some, which always works since there are fewer characters than
+       states. */
+    int diff = TANS_TABLE_SIZE - sum;
+    if (norm[largest] + diff >= 1) {
+        norm[largest] += diff;
+        return true;
+    }
+    while (diff < 0) {
+        for (int s = 0; s < TANS_SYMBOLS && diff < 0; s++) {
+            if (norm[s] > 1) {
+                norm[s]--;
+                diff++;
+            }
+        }
+    }
+    return true;
+}
+
+bool tans_table_from_norm(tans_table *table, const uint16_t *norm) {
+    uint32_t cumul[TANS_SYMBOLS + 1];
+    cumul[0] = 0;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        cumul[s + 1] = cumul[s] + norm[s];
+    }
+    if (cumul[TANS_SYMBOLS] != TANS_TABLE_SIZE) {
+        return false;
+    }
+    memcpy(table->norm, norm, sizeof(table->norm));
+
+    /* The states of each character are spread over the table with an
+       odd step, which visits every state once, so that the states of a
+       character are roughly evenly spaced */
+    unsigned char spread[TANS_TABLE_SIZE];
+    const uint32_t step = (TANS_TABLE_SIZE >> 1) + (TANS_TABLE_SIZE >> 3) + 3;
+    uint32_t pos = 0;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        for (int k = 0; k < norm[s]; k++) {
+            spread[pos] = s;
+            pos = (pos + step) & (TANS_TABLE_SIZE - 1);
+        }
+    }
+
+    uint32_t next[TANS_SYMBOLS];
+    memcpy(next, cumul, sizeof(next));
+    for (uint32_t u = 0; u < TANS_TABLE_SIZE; u++) {
+        table->state_table[next[spread[u]]++] = TANS_TABLE_SIZE + u;
+    }
+
+    /* A character with normalized count k writes max_bits or one bit
+       less, max_bits where the state is at least k << max_bits */
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        if (norm[s] == 0) {
+            table->delta_bits[s] = 0;
+            table->delta_find_state[s] = 0;
+        } else if (norm[s] == 1) {
+            table->delta_bits[s] = (TANS_TABLE_LOG << 16) - TANS_TABLE_SIZE;
+            table->delta_find_state[s] = (int32_t)cumul[s] - 1;
+        } else {
+            uint32_t max_bits = TANS_TABLE_LOG - highest_bit(norm[s] - 1);
+            table->delta_bits[s] = (max_bits << 16) - ((uint32_t)norm[s] << max_bits);
+            table->delta_find_state[s] = (int32_t)cumul[s] - norm[s];
+        }
+    }
+
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        next[s] = norm[s];
+    }
+    for (uint32_t u = 0; u < TANS_TABLE_SIZE; u++) {
+        int s = spread[u];
+        uint32_t x = next[s]++;
+        int bits = TANS_TABLE_LOG - highest_bit(x);
+        table->decode[u].symbol = s;
+        table->decode[u].bits = bits;
+        table->decode[u].new_state = (x << bits) - TANS_TABLE_SIZE;
+    }
+    return true;
+}
+
+uint64_t tans_code_bits(const uint16_t *norm, const uint64_t *counts) {
+    double bits = 0.0;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        if (counts[s] > 0) {
+            bits += counts[s] * (TANS_TABLE_LOG - log2((double)norm[s]));
+        }
+    }
+    return (uint64_t)ceil(bits) + TANS_STATES * TANS_TABLE_LOG;
+}
+
+size_t tans_table_size(const uint16_t *norm) {
+    int symbols = 0;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        symbols += norm[s] > 0;
+    }
+    return TANS_TABLE_BITMAP_BYTES + (symbols * TANS_TABLE_LOG + 7) / 8;
+}
+
+size_t tans_table_stored_size(const unsigned char *bitmap) {
+    int symbols = 0;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        symbols += (bitmap[s / 8] >> (7 - s % 8)) & 1;
+    }
+    return TANS_TABLE_BITMAP_BYTES + (symbols * TANS_TABLE_LOG + 7) / 8;
+}
+
+size_t tans_table_write(const uint16_t *norm, unsigned char *out) {
+    memset(out, 0, TANS_TABLE_MAX_BYTES);
+
+    size_t bit = TANS_TABLE_BITMAP_BYTES * 8;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        if (norm[s] == 0) {
+            continue;
+        }
+        out[s / 8] |= 0x80 >> (s % 8);
+        for (int k = TANS_TABLE_LOG - 1; k >= 0; k--, bit++) {
+            if (((norm[s] - 1) >> k) & 1) {
+                out[bit / 8] |= 0x80 >> (bit % 8);
+            }
+        }
+    }
+    return (bit + 7) / 8;
+}
+
+size_t tans_table_read(tans_table *table, const unsigned char *in, size_t size) {
+    if (size < TANS_TABLE_BITMAP_BYTES) {
+        return 0;
+    }
+    size_t stored = tans_table_stored_size(in);
+    if (size < stored) {
+        return 0;
+    }
+
+    uint16_t norm[TANS_SYMBOLS];
+    size_t bit = TANS_TABLE_BITMAP_BYTES * 8;
+    for (int s = 0; s < TANS_SYMBOLS; s++) {
+        norm[s] = 0;
+        if (!((in[s / 8] >> (7 - s % 8)) & 1)) {
+            continue;
+        }
+        uint32_t value = 0;
+        for (int k = 0; k < TANS_TABLE_LOG; k++, bit++) {
+            value = value << 1 | ((in[bit / 8] >> (7 - bit % 8)) & 1);
+        }
+        norm[s] = value + 1;
+    }
+
+    return tans_table_from_norm(table, norm) ? stored : 0;
+}
+
+unsigned char *tans_encode(const tans_table *table, const unsigned char *data, size_t n,
+                           size_t *size) {
+    /* The characters are coded from the last, so the bits of each are
+       kept until the first is done, with the number of bits above the
+       TANS_TABLE_LOG bits of the value */
+    uint16_t *pending = malloc((n > 0 ? n : 1) * sizeof(uint16_t));
+    uint32_t state[TANS_STATES];
+    for (int k = 0; k < TANS_STATES; k++) {
+        state[k] = TANS_TABLE_SIZE;
+    }
+
+    for (size_t i = n; i-- > 0;) {
+        uint32_t *st = &state[i % TANS_STATES];
+        int s = data[i];
+        uint32_t bits = (*st + table->delta_bits[s]) >> 16;
+        pending[i] = (*st & ((1u << bits) - 1)) | bits << TANS_TABLE_LOG;
+        *st = table->state_table[(int32_t)(*st >> bits) + table->delta_find_state[s]];
+    }
+
+    unsigned char *out = malloc(((uint64_t)n * TANS_TABLE_LOG + 7) / 8 +
+                                TANS_STATES * TANS_TABLE_LOG / 8 + 8);
+    size_t pos = 0;
+    uint64_t acc = 0;
+    int acc_bits = 0;
+
+    for (int k = 0; k < TANS_STATES; k++) {
+        acc = acc << TANS_TABLE_LOG | (state[k] - TANS_TABLE_SIZE);
+        acc_bits += TANS_TABLE_LOG;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int bits = pending[i] >> TANS_TABLE_LOG;
+        acc = acc << bits | (pending[i] & (TANS_TABLE_SIZE - 1));
+        acc_bits += bits;
+        while (acc_bits >= 8) {
+            acc_bits -= 8;
+            out[pos++] = acc >> acc_bits;
+        }
+    }
+    while (acc_bits >= 8) {
+        acc_bits -= 8;
+        out[pos++] = acc >> acc_bits;
+    }
+    if (acc_bits > 0) {
+        out[pos++] = acc << (8 - acc_bits);
+    }
+
+    free(pending);
+    *size = pos;
+    return out;
+}
+
+int tans_decode(const tans_table *table, const unsigned char *data, size_t size,
+                unsigned char *out, size_t n, uint32_t *crc) {
+    const tans_entry *decode = table->decode;
+    uint64_t acc = 0;
+    int bits = 0;
+    size_t pos = 0;
+    uint32_t state[TANS_STATES];
+
+    bit_refill(data, size, &pos, &acc, &bits);
+    if (bits < TANS_STATES * TANS_TABLE_LOG) {
+        return -1;
+    }
+    for (int k = 0; k < TANS_STATES; k++) {
+        state[k] = acc >> (64 - TANS_TABLE_LOG);
+        acc <<= TANS_TABLE_LOG;
+        bits -= TANS_TABLE_LOG;
+    }
+
+    /* A character reads at most TANS_TABLE_LOG bits, so while 8 bytes
+       are left a refill holds four of them. The shift by 32 and then
+       by the rest keeps a read of 0 bits defined. */
+    size_t i = 0;
+    size_t checked = 0;
+    while (n - i >= 4 && size - pos >= 8) {
+        bit_refill(data, size, &pos, &acc, &bits);
+        for (int j = 0; j < 4; j++) {
+            uint32_t *st = &state[j % TANS_STATES];
+            tans_entry e = decode[*st];
+            out[i++] = e.symbol;
+            *st = e.new_state + (uint32_t)((acc >> 32) >> (32 - e.bits));
+            acc <<= e.bits;
+            bits -= e.bits;
+        }
+        crc32c_step(crc, out, &checked, i, false);
+    }
+
+    /* The last characters, where the codes may run out */
+    for (; i < n; i++) {
+        bit_refill(data, size, &pos, &acc, &bits);
+        uint32_t *st = &state[i % TANS_STATES];
+        tans_entry e = decode[*st];
+        if (e.bits > bits) {
+            return -1;
+        }
+        out[i] = e.symbol;
+        *st = e.new_state + (uint32_t)((acc >> 32) >> (32 - e.bits));
+        acc <<= e.bits;
+        bits -= e.bits;
+    }
+
+    crc32c_step(crc, out, &checked, n, true);
+    return 0;
+}
+
+/* Returns the index of the highest set bit of x > 0 */
+static int highest_bit(uint32_t x) {
+    int bit = 0;
+    while (x >>= 1) {
+        bit++;
+    }
+    return bit;
+}
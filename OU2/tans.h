@@ -0,0 +1,127 @@
+#ifndef TANS
+#define TANS
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Table-based asymmetric numeral system coding of characters, as in
+ * FSE.
+ *
+ * The counts of the characters are scaled to a normalized count of
+ * each, at least 1 for every character that occurs, that sum to
+ * TANS_TABLE_SIZE. A character with normalized count k then costs
+ * TANS_TABLE_LOG - log2(k) bits, a fraction of a bit where Huffman
+ * codes need a whole one, which matters most for characters that make
+ * up most of the data.
+ *
+ * The coder has TANS_STATES states, and character i is coded with
+ * state i % TANS_STATES, so that the decoding of consecutive characters
+ * does not wait on one state. The characters are coded last to first,
+ * and the bits are written in the order the decoder reads them, most
+ * significant bit first as in the bit_buffer: the final state of each
+ * coder in TANS_TABLE_LOG bits, followed by the bits of each character
+ * from the first.
+ */
+
+#define TANS_TABLE_LOG 12
+#define TANS_TABLE_SIZE (1 << TANS_TABLE_LOG)
+#define TANS_SYMBOLS 256
+#define TANS_STATES 2
+
+/* A stored table is a bitmap of the characters that occur, followed by
+   the normalized count minus 1 of each of them in TANS_TABLE_LOG bits */
+#define TANS_TABLE_BITMAP_BYTES (TANS_SYMBOLS / 8)
+#define TANS_TABLE_MAX_BYTES (TANS_TABLE_BITMAP_BYTES + \
+                              (TANS_SYMBOLS * TANS_TABLE_LOG + 7) / 8)
+
+/*
+ * An entry of the decode table, indexed by the state.
+ *
+ * new_state  The next state, before the bits are added.
+ * symbol     The character of the state.
+ * bits       The number of bits to read and add to new_state.
+ */
+typedef struct {
+    uint16_t new_state;
+    uint8_t symbol;
+    uint8_t bits;
+} tans_entry;
+
+/*
+ * norm              The normalized count of each character.
+ * state_table       The next encoder state, grouped by character.
+ * delta_find_state  Where the states of each character start in
+ *                   state_table, less its normalized count.
+ * delta_bits        Gives the number of bits a character writes from
+ *                   a state, in the high 16 bits of the state plus it.
+ * decode            The decode table.
+ */
+typedef struct {
+    uint16_t norm[TANS_SYMBOLS];
+    uint16_t state_table[TANS_TABLE_SIZE];
+    int32_t delta_find_state[TANS_SYMBOLS];
+    uint32_t delta_bits[TANS_SYMBOLS];
+    tans_entry decode[TANS_TABLE_SIZE];
+} tans_table;
+
+/*
+ * Scales the first TANS_SYMBOLS counts to normalized counts in norm.
+ * Returns false if all counts are 0.
+ */
+bool tans_normalize(const uint64_t *counts, uint16_t *norm);
+
+/*
+ * Builds the tables from normalized counts. Returns false if they do
+ * not sum to TANS_TABLE_SIZE.
+ */
+bool tans_table_from_norm(tans_table *table, const uint16_t *norm);
+
+/*
+ * Returns the number of bits tans_encode uses for characters with the
+ * counts, estimated from the cost of each character. The estimate is
+ * off by a few bits for a whole block.
+ */
+uint64_t tans_code_bits(const uint16_t *norm, const uint64_t *counts);
+
+/* Returns the number of bytes tans_table_write uses for norm. */
+size_t tans_table_size(const uint16_t *norm);
+
+/*
+ * Returns the number of bytes of a stored table from its bitmap, the
+ * first TANS_TABLE_BITMAP_BYTES bytes.
+ */
+size_t tans_table_stored_size(const unsigned char *bitmap);
+
+/*
+ * Stores the normalized counts in out, which must have room for
+ * TANS_TABLE_MAX_BYTES bytes. Returns the number of bytes written.
+ */
+size_t tans_table_write(const uint16_t *norm, unsigned char *out);
+
+/*
+ * Builds a table stored by tans_table_write from the size bytes in in.
+ * Returns the number of bytes read, or 0 if the table is invalid.
+ */
+size_t tans_table_read(tans_table *table, const unsigned char *in, size_t size);
+
+/*
+ * Codes the n characters in data, which must all have a normalized
+ * count above 0, and returns a newly allocated array of the code
+ * bytes, padded with 0 bits. Stores the number of bytes in *size. The
+ * user is responsible for deallocating the array with free.
+ */
+unsigned char *tans_encode(const tans_table *table, const unsigned char *data, size_t n,
+                           size_t *size);
+
+/*
+ * Decodes n characters from the size bytes in data into out. Unless crc
+ * is NULL the CRC-32C of the characters is continued in *crc, a step at
+ * a time as they are decoded, see crc32c_step. Returns 0 on success and
+ * -1 if the codes end early.
+ */
+int tans_decode(const tans_table *table, const unsigned char *data, size_t size,
+                unsigned char *out, size_t n, uint32_t *crc);
+
+#endif
@@ -13,6 +13,23 @@
 #include "bit_buffer.h"
 
 
+/* Inserts the bits of a string of 0s and 1s */
+void insert_bits(bit_buffer *b, const char *bits)
+{
+	for (int i = 0; bits[i] != '\0'; i++) {
+		bit_buffer_insert_bit(b, bits[i] == '1');
+	}
+}
+
+/* Prints the bits without removing them */
+void print_bits(const bit_buffer *b)
+{
+	for (int i = 0; i < bit_buffer_size(b); i++) {
+		printf("%d", bit_buffer_inspect_bit(b, i));
+	}
+	printf("\n");
+}
+
 int main()
 {
 	printf("\nAllocate the first bit buffer\n");
@@ -79,5 +96,51 @@ int main()
 	printf("Free the second bit buffer\n\n");
 	bit_buffer_free(b2);
 
+	printf("\n-------- Hit return to continue... --------\n"); getchar();
+
+	printf("Wrap the string \"bits\" in a third bit buffer without \n");
+	printf("copying it, insert a single 1 and then the bytes of the \n");
+	printf("string \"ok\", which are no longer byte aligned. Remove \n");
+	printf("the first four bytes and the bit, then the last two bytes \n");
+	printf("should read \"ok\"\n");
+	bit_buffer *b3 = bit_buffer_wrap("bits", 4);
+	bit_buffer_insert_bit(b3, true);
+	bit_buffer_append_bytes(b3, "ok", 2);
+
+	char bytes[5] = {0};
+	bit_buffer_read_bytes(b3, bytes, 4);
+	printf("%s %d ", bytes, bit_buffer_remove_bit(b3));
+	bit_buffer_read_bytes(b3, bytes, 2);
+	bytes[2] = '\0';
+	printf("%s\n", bytes);
+	bit_buffer_free(b3);
+
+	printf("\n-------- Hit return to continue... --------\n"); getchar();
+
+	printf("Concatenate a buffer of 11 bits to one of 5 bits, which \n");
+	printf("should give 10110 followed by 01100111010, and leave the \n");
+	printf("second buffer as it was\n");
+	bit_buffer *b4 = bit_buffer_empty();
+	bit_buffer *b5 = bit_buffer_empty();
+	insert_bits(b4, "10110");
+	insert_bits(b5, "01100111010");
+	bit_buffer_concat(b4, b5);
+	print_bits(b4);
+	print_bits(b5);
+
+	printf("\n-------- Hit return to continue... --------\n"); getchar();
+
+	printf("Splice the first 7 bits of the second buffer onto a buffer \n");
+	printf("of 3 bits, which should give 111 followed by 0110011, and \n");
+	printf("leave 1010 in the second buffer\n");
+	bit_buffer *b6 = bit_buffer_empty();
+	insert_bits(b6, "111");
+	bit_buffer_splice(b6, b5, 7);
+	print_bits(b6);
+	print_bits(b5);
+	bit_buffer_free(b4);
+	bit_buffer_free(b5);
+	bit_buffer_free(b6);
+
 	return 0;
 }
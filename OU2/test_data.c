@@ -0,0 +1,69 @@
+#include "test_data.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+const test_case test_cases[] = {
+    {"plain", {.threads = 1}},
+    {"-rle", {.rle = true, .threads = 1}},
+    {"-bwt", {.bwt = true, .threads = 1}},
+    {"-ans", {.ans = true, .threads = 1}},
+    {"-checksum", {.checksum = true, .threads = 1}},
+    {"-rle -checksum", {.rle = true, .checksum = true, .threads = 1}},
+    {"-ans -checksum", {.ans = true, .checksum = true, .threads = 1}},
+    {"-store-model", {.store_model = true, .threads = 1}},
+    {"all", {.checksum = true, .rle = true, .bwt = true, .ans = true, .store_model = true,
+             .threads = 1}},
+};
+const size_t test_case_count = sizeof(test_cases) / sizeof(test_cases[0]);
+
+/* A generator of the same pseudo-random numbers on every system */
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+unsigned char *test_data(size_t n) {
+    static const char *const words[] = {
+        "the ", "search ", "finds ", "the ", "codes ", "of ", "a ", "pattern ",
+        "in ", "the block ", "of ", "bits, ", "and ", "matches across blocks. ", "e ", "\n"
+    };
+    static const char *const other_words[] = {
+        "SEEK ", "FIND ", "SCAN ", "MATCH ", "LOOK ", "HUNT ", "QUERY ", "TRACE "
+    };
+    unsigned char *data = malloc(n > 0 ? n : 1);
+    uint32_t state = 7;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t part = i * 8 / n;
+        if (part == 1 || part == 7) {
+            unsigned char c = next_random(&state) & 0x3f;
+            for (size_t run = 40 + next_random(&state) % 200; run > 0 && i < n; run--) {
+                data[i++] = c;
+            }
+        } else if (part == 2) {
+            uint32_t r = next_random(&state) % 100;
+            data[i++] = r < 90 ? 'a' : r < 97 ? 'b' : 'c' + r % 3;
+        } else if (part == 3) {
+            data[i++] = next_random(&state);
+        } else if (part == 4) {
+            data[i] = data[i - n / 4];
+            i++;
+        } else {
+            const char *w = part == 5 ? other_words[next_random(&state) % 8]
+                                      : words[next_random(&state) % 16];
+            for (size_t k = 0; w[k] != '\0' && i < n; k++) {
+                data[i++] = w[k];
+            }
+        }
+    }
+    return data;
+}
+
+huffman_table *test_model(const unsigned char *data, size_t n) {
+    uint64_t counts[HUFF_SYMBOLS] = {0};
+    for (size_t i = 0; i < n / 8; i++) {
+        counts[data[i]]++;
+    }
+    return huffman_table_from_counts(counts);
+}
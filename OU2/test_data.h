@@ -0,0 +1,44 @@
+#ifndef TEST_DATA
+#define TEST_DATA
+
+#include <stddef.h>
+#include "huffman_table.h"
+#include "huffman_block.h"
+
+/*
+ * The data and the options that the tests of make test encode.
+ *
+ * The data has parts of text, long runs, skewed bytes, random bytes,
+ * the skewed bytes again, text of other words, text and runs, of n / 8
+ * bytes or a little more, so that the encoder makes blocks of every
+ * kind. The model is that of the first part, so the text can be coded
+ * with it, and the other words get a table of their own. The second
+ * part of skewed bytes starts at a chunk boundary like the first, so it
+ * reuses the table of the first.
+ */
+
+#define TEST_SIZE (320 * 1024)
+
+typedef struct {
+    const char *name;
+    block_options options;
+} test_case;
+
+/* Each of the options of huffman_block.h alone, the checksum with the
+   other codes, and all of them, on one thread, test_case_count of them */
+extern const test_case test_cases[];
+extern const size_t test_case_count;
+
+/*
+ * Returns n characters of the test data, the same on every system. The
+ * user is responsible for deallocating the result with free.
+ */
+unsigned char *test_data(size_t n);
+
+/*
+ * Returns the model table of the test data in the n characters of
+ * data. The user is responsible for deallocating the table with free.
+ */
+huffman_table *test_model(const unsigned char *data, size_t n);
+
+#endif
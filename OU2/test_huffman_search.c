@@ -0,0 +1,178 @@
+/*
+ * A test of huffman_search, whose matches must be those that memmem
+ * finds in the data. Built and run with make test.
+ *
+ * The data of test_data.h, which has blocks of every kind, is encoded
+ * with each of its options and searched for words whose codes are
+ * longer than the search looks for in the bits, for single characters
+ * and short strings whose codes are so short that the blocks are
+ * decoded instead, for strings that do not occur, and for the
+ * characters around the start of every block, which only match across
+ * two blocks.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "huffman_codec.h"
+#include "huffman_block.h"
+#include "huffman_search.h"
+#include "container.h"
+#include "test_data.h"
+
+/* The offsets of the matches that huffman_search reports */
+typedef struct {
+    uint64_t *offsets;
+    size_t count;
+    size_t capacity;
+} match_list;
+
+static size_t block_starts(const huffman_table *model, const unsigned char *encoded,
+                           size_t size, size_t **starts, int *types);
+static int check_search(const huffman_table *model, const unsigned char *encoded, size_t size,
+                        const unsigned char *data, size_t n, const unsigned char *pattern,
+                        size_t m);
+static void add_match(void *context, uint64_t offset);
+
+int main(void) {
+    unsigned char *data = test_data(TEST_SIZE);
+    huffman_table *model = test_model(data, TEST_SIZE);
+
+    /* Long words, short strings, one character and strings that are
+       not in the data, or only in some of its parts */
+    static const char *const patterns[] = {
+        "search ", "the codes of ", "matches across blocks. ", "th", "e", " ", "\n",
+        "aaaa", "ba", "SCAN MATCH ", "quokka", "seek find", "the block of "
+    };
+
+    int failed = 0;
+    int types = 0;
+    for (size_t c = 0; c < test_case_count; c++) {
+        const block_options *options = &test_cases[c].options;
+        size_t size;
+        unsigned char *encoded = encode_buffer(model, data, TEST_SIZE, options, &size);
+        /* A file that stores its model is searched without one */
+        const huffman_table *search_model = options->store_model ? NULL : model;
+
+        int err = 0;
+        size_t searches = 0;
+        for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+            err |= check_search(search_model, encoded, size, data, TEST_SIZE,
+                                (const unsigned char *)patterns[p], strlen(patterns[p]));
+            searches++;
+        }
+
+        /* The characters before and after the start of each block, as
+           many on each side as the longest match, and as few as fit
+           in one code */
+        size_t *starts;
+        size_t count = block_starts(search_model, encoded, size, &starts, &types);
+        if (count == (size_t)-1) {
+            err = -1;
+            count = 0;
+        }
+        for (size_t b = 0; b < count; b++) {
+            static const size_t sides[] = {1, 4, 12};
+            for (size_t k = 0; k < sizeof(sides) / sizeof(sides[0]); k++) {
+                size_t s = sides[k];
+                if (starts[b] >= s && starts[b] + s <= TEST_SIZE) {
+                    err |= check_search(search_model, encoded, size, data, TEST_SIZE,
+                                        data + starts[b] - s, 2 * s);
+                    searches++;
+                }
+            }
+        }
+        free(starts);
+
+        printf("%-15s %3zu searches  %s\n", test_cases[c].name, searches, err == 0 ? "ok" : "FAILED");
+        failed += err != 0;
+        free(encoded);
+    }
+
+    /* Every kind of block must have been searched */
+    static const int kinds[] = {BLOCK_MODEL, BLOCK_TABLE, BLOCK_STORED, BLOCK_BWT,
+                                BLOCK_REUSE, BLOCK_ANS};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        if ((types & 1 << kinds[k]) == 0) {
+            printf("No block of type %d was searched\n", kinds[k]);
+            failed++;
+        }
+    }
+
+    free(model);
+    free(data);
+    return failed == 0 ? 0 : 1;
+}
+
+/*
+ * Stores a newly allocated array of the offsets in the decoded file of
+ * the blocks of the size bytes of an encoded file in *starts, and sets
+ * bit t of *types for each block of type t. Returns the number of
+ * blocks, or (size_t)-1 if the file is invalid.
+ */
+static size_t block_starts(const huffman_table *model, const unsigned char *encoded,
+                           size_t size, size_t **starts, int *types) {
+    container *c = malloc(sizeof(container));
+    block_info *blocks;
+    size_t count = (size_t)-1;
+    *starts = NULL;
+    if (container_read(c, encoded, size, model) == 0) {
+        count = parse_blocks(c->blocks, c->size, c->sizes, c->count, c->characters,
+                             &blocks);
+    }
+    if (count != (size_t)-1) {
+        *starts = malloc((count > 0 ? count : 1) * sizeof(size_t));
+        for (size_t i = 0; i < count; i++) {
+            (*starts)[i] = blocks[i].out_pos;
+            *types |= 1 << blocks[i].type;
+        }
+        free_block_tables(blocks, count);
+        free(blocks);
+    }
+    free(c);
+    return count;
+}
+
+/*
+ * Searches the encoded file for the m characters of pattern and
+ * compares the matches, and their number, with the occurrences of
+ * pattern in the n characters of data. Returns 0 if they are the same.
+ */
+static int check_search(const huffman_table *model, const unsigned char *encoded, size_t size,
+                        const unsigned char *data, size_t n, const unsigned char *pattern,
+                        size_t m) {
+    match_list found = {NULL, 0, 0};
+    int64_t total = huffman_search(model, encoded, size, pattern, m, 0, add_match, &found);
+
+    int err = total != (int64_t)found.count ? -1 : 0;
+    size_t expected = 0;
+    const unsigned char *p = data;
+    while ((p = memmem(p, data + n - p, pattern, m)) != NULL) {
+        if (expected >= found.count || found.offsets[expected] != (uint64_t)(p - data)) {
+            err = -1;
+        }
+        expected++;
+        p++;
+    }
+    if (err == 0 && expected != found.count) {
+        err = -1;
+    }
+    if (err != 0) {
+        printf("The search for \"%.*s\" found %lld matches instead of %zu\n", (int)m,
+               (const char *)pattern, (long long)total, expected);
+    }
+
+    free(found.offsets);
+    return err;
+}
+
+static void add_match(void *context, uint64_t offset) {
+    match_list *l = context;
+    if (l->count == l->capacity) {
+        l->capacity = l->capacity > 0 ? 2 * l->capacity : 64;
+        l->offsets = realloc(l->offsets, l->capacity * sizeof(uint64_t));
+    }
+    l->offsets[l->count++] = offset;
+}
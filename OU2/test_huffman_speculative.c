@@ -0,0 +1,211 @@
+/*
+ * A test of huffman_decode_speculative, whose result must be that of
+ * huffman_decode. Built and run with make test.
+ *
+ * The data of test_data.h is coded with a model of all of it, and
+ * prefixes of it whose codes take about a multiple of
+ * SPECULATIVE_MIN_PART bytes are decoded on several numbers of threads,
+ * so that the codes are cut into each possible number of parts, with
+ * part boundaries inside codes. Random characters are also coded with
+ * a table whose codes all have 7 bits, so that a part that starts off
+ * the true code boundaries never meets them and has to be decoded
+ * again. Last, a file in the format of -legacy is decoded with
+ * decode_file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "huffman_codec.h"
+#include "huffman_speculative.h"
+#include "byte_order.h"
+#include "test_data.h"
+
+#define SPECULATIVE_TEST_SIZE (4 * 1024 * 1024)
+
+static unsigned char *encode_codes(const huffman_table *table, const unsigned char *data,
+                                   size_t n, size_t *size);
+static size_t prefix_for_bytes(const huffman_table *table, const unsigned char *data,
+                               size_t n, size_t bytes);
+static int check_decode(const huffman_table *table, const unsigned char *codes, size_t size,
+                        size_t n);
+static int check_resync(void);
+static int check_legacy(const huffman_table *table, const unsigned char *data, size_t n);
+
+int main(void) {
+    unsigned char *data = test_data(SPECULATIVE_TEST_SIZE);
+    uint64_t counts[HUFF_SYMBOLS] = {0};
+    for (size_t i = 0; i < SPECULATIVE_TEST_SIZE; i++) {
+        counts[data[i]]++;
+    }
+    huffman_table *table = huffman_table_from_counts(counts);
+
+    /* Sizes of the codes in bytes, around the sizes where another part
+       is cut */
+    static const size_t sizes[] = {
+        0, 1, SPECULATIVE_MIN_PART - 1, SPECULATIVE_MIN_PART, SPECULATIVE_MIN_PART + 1,
+        2 * SPECULATIVE_MIN_PART + 3, 3 * SPECULATIVE_MIN_PART - 1,
+        4 * SPECULATIVE_MIN_PART + 1, 8 * SPECULATIVE_MIN_PART + 7
+    };
+
+    int failed = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = prefix_for_bytes(table, data, SPECULATIVE_TEST_SIZE, sizes[s]);
+        size_t size;
+        unsigned char *codes = encode_codes(table, data, n, &size);
+        /* And one character more than there are codes for */
+        int err = check_decode(table, codes, size, n) | check_decode(table, codes, size, n + 1);
+        printf("%8zu bytes  %s\n", size, err == 0 ? "ok" : "FAILED");
+        failed += err != 0;
+        free(codes);
+    }
+
+    int err = check_resync();
+    printf("no resync       %s\n", err == 0 ? "ok" : "FAILED");
+    failed += err != 0;
+
+    err = check_legacy(table, data, SPECULATIVE_TEST_SIZE / 2);
+    printf("-legacy         %s\n", err == 0 ? "ok" : "FAILED");
+    failed += err != 0;
+
+    free(table);
+    free(data);
+    return failed == 0 ? 0 : 1;
+}
+
+/* Returns the codes of the n characters in data, and their number of
+   bytes in *size */
+static unsigned char *encode_codes(const huffman_table *table, const unsigned char *data,
+                                   size_t n, size_t *size) {
+    bit_buffer *b = bit_buffer_empty();
+    huffman_encode(table, data, n, b);
+    *size = ((size_t)bit_buffer_size(b) + 7) / 8;
+    unsigned char *codes = (unsigned char *)bit_buffer_to_byte_array(b);
+    bit_buffer_free(b);
+    return codes;
+}
+
+/* Returns the number of the first characters of data whose codes take
+   at least bytes bytes, or n if all of them take fewer */
+static size_t prefix_for_bytes(const huffman_table *table, const unsigned char *data,
+                               size_t n, size_t bytes) {
+    uint64_t bits = 0;
+    size_t i = 0;
+    while (i < n && bits < (uint64_t)bytes * 8) {
+        bits += table->length[data[i++]];
+    }
+    return i;
+}
+
+/*
+ * Decodes n characters from the size bytes of codes with huffman_decode
+ * and with huffman_decode_speculative on several numbers of threads.
+ * Returns 0 if they all give the same result.
+ */
+static int check_decode(const huffman_table *table, const unsigned char *codes, size_t size,
+                        size_t n) {
+    static const int threads[] = {1, 2, 3, 4, 8};
+    unsigned char *expected = malloc(n > 0 ? n : 1);
+    unsigned char *out = malloc(n > 0 ? n : 1);
+    int expected_err = huffman_decode(table, codes, size, expected, n, NULL);
+
+    int err = 0;
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        memset(out, 0, n);
+        int result = huffman_decode_speculative(table, codes, size, out, n, threads[t]);
+        if (result != expected_err || (result == 0 && memcmp(out, expected, n) != 0)) {
+            printf("%zu characters on %d threads differ\n", n, threads[t]);
+            err = -1;
+        }
+    }
+
+    free(out);
+    free(expected);
+    return err;
+}
+
+/*
+ * Random characters coded with a table of 7-bit codes, one of which is
+ * for a symbol above 255 that the characters never use. The codes are
+ * cut into two parts at a bit that is not on a code boundary, so a
+ * decoder that starts there stays off the true codes, and soon reads
+ * the code of the unused symbol as if it were one. The part ends there,
+ * long before its stop, and never meets the true codes, so the rest of
+ * it has to be decoded again.
+ */
+static int check_resync(void) {
+    uint64_t counts[HUFF_SYMBOLS] = {0};
+    for (int c = 0; c < 127; c++) {
+        counts[c] = 1;
+    }
+    counts[256] = 1;
+    huffman_table *table = huffman_table_from_counts(counts);
+
+    /* The fourth of the eight parts of the test data is random */
+    size_t n = 2 * SPECULATIVE_MIN_PART * 8 / 7 + 1;
+    unsigned char *data = test_data(8 * n);
+    unsigned char *random = data + 3 * n;
+    for (size_t i = 0; i < n; i++) {
+        random[i] %= 127;
+    }
+
+    size_t size;
+    unsigned char *codes = encode_codes(table, random, n, &size);
+    unsigned char *out = malloc(n);
+    int err = size >= 2 * SPECULATIVE_MIN_PART && size * 8 / 2 % 7 != 0 ? 0 : -1;
+    if (err == 0 && (huffman_decode_speculative(table, codes, size, out, n, 2) != 0 ||
+                     memcmp(out, random, n) != 0)) {
+        err = -1;
+    }
+
+    free(out);
+    free(codes);
+    free(data);
+    free(table);
+    return err;
+}
+
+/*
+ * Writes the n characters of data in the format from before
+ * container.h, the u64 number of characters and the codes, and decodes
+ * the file with decode_file on all threads. Returns 0 if the result is
+ * the data.
+ */
+static int check_legacy(const huffman_table *table, const unsigned char *data, size_t n) {
+    size_t size;
+    unsigned char *codes = encode_codes(table, data, n, &size);
+    unsigned char header[8];
+    store_le64(header, n);
+
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    int err = in != NULL && out != NULL ? 0 : -1;
+    if (err == 0 && (fwrite(header, 1, 8, in) != 8 || fwrite(codes, 1, size, in) != size)) {
+        err = -1;
+    }
+    block_options options = {.threads = 0, .legacy = true};
+    if (err == 0) {
+        rewind(in);
+        err = decode_file(in, out, table, &options);
+    }
+
+    size_t decoded = 0;
+    unsigned char *result = NULL;
+    if (err == 0) {
+        rewind(out);
+        result = read_file(out, &decoded);
+    }
+    if (result == NULL || decoded != n || memcmp(result, data, n) != 0) {
+        err = -1;
+    }
+
+    free(result);
+    if (in != NULL) {
+        fclose(in);
+    }
+    if (out != NULL) {
+        fclose(out);
+    }
+    free(codes);
+    return err;
+}
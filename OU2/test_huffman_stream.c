@@ -0,0 +1,158 @@
+/*
+ * A test of stream_decode, which must resume wherever its input or its
+ * output ends. Built and run with make test.
+ *
+ * The data of test_data.h, which has blocks of every kind, is encoded
+ * with each of its options and then decoded one input byte at a time
+ * into a one byte output buffer, which stops the decoder inside every
+ * header field, table and code. The result must be the data, and the
+ * input after the end of the file must be left unused. The blocks are
+ * also decoded with decode_buffer, which must give the same result, and
+ * reject a block whose checksum differs. A file whose block table no
+ * longer matches its blocks must be rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "huffman_codec.h"
+#include "huffman_stream.h"
+#include "byte_order.h"
+#include "container.h"
+#include "test_data.h"
+
+static int decode_bytewise(const huffman_table *model, const unsigned char *in, size_t size,
+                           const unsigned char *data, size_t n);
+static int check_buffer(const huffman_table *model, unsigned char *in, size_t size,
+                        const unsigned char *data, size_t n);
+static int check_moved_chars(const huffman_table *model, unsigned char *in, size_t size,
+                             const unsigned char *data, size_t n);
+
+int main(void) {
+    unsigned char *data = test_data(TEST_SIZE);
+    huffman_table *model = test_model(data, TEST_SIZE);
+
+    int failed = 0;
+    for (size_t c = 0; c < test_case_count; c++) {
+        const block_options *options = &test_cases[c].options;
+        size_t size;
+        unsigned char *encoded = encode_buffer(model, data, TEST_SIZE, options, &size);
+        /* A file that stores its model decodes without one */
+        const huffman_table *decode_model = options->store_model ? NULL : model;
+        int err = decode_bytewise(decode_model, encoded, size, data, TEST_SIZE);
+        err |= check_buffer(decode_model, encoded, size, data, TEST_SIZE);
+        err |= check_moved_chars(decode_model, encoded, size, data, TEST_SIZE);
+        printf("%-15s %7zu bytes  %s\n", test_cases[c].name, size, err == 0 ? "ok" : "FAILED");
+        failed += err != 0;
+        free(encoded);
+    }
+
+    free(model);
+    free(data);
+    return failed == 0 ? 0 : 1;
+}
+
+/*
+ * Decodes the size bytes of in one byte at a time, followed by a byte
+ * that is not part of the file, and compares the result with the n
+ * characters of data. Returns 0 if they are the same.
+ */
+static int decode_bytewise(const huffman_table *model, const unsigned char *in, size_t size,
+                           const unsigned char *data, size_t n) {
+    stream_decoder *d = stream_decoder_new(model);
+    unsigned char *input = malloc(size + 1);
+    memcpy(input, in, size);
+    input[size] = 0xa5;
+
+    size_t pos = 0;
+    size_t done = 0;
+    int result = STREAM_MORE;
+    while (result == STREAM_MORE) {
+        unsigned char out;
+        size_t consumed, produced;
+        result = stream_decode(d, input + pos, pos <= size ? 1 : 0, &consumed, &out, 1,
+                               &produced);
+        pos += consumed;
+        if (produced > 0) {
+            if (done >= n || out != data[done]) {
+                result = STREAM_ERROR;
+            }
+            done++;
+        }
+        /* No input left and no progress */
+        if (result == STREAM_MORE && pos > size && produced == 0) {
+            result = STREAM_ERROR;
+        }
+    }
+
+    stream_decoder_free(d);
+    free(input);
+    return result == STREAM_END && done == n && pos == size ? 0 : -1;
+}
+
+/*
+ * Decodes the size bytes of in with decode_buffer and compares the
+ * result with the n characters of data. The decoding must fail once a
+ * bit of the checksum of any one block is flipped. Returns 0 if both
+ * hold.
+ */
+static int check_buffer(const huffman_table *model, unsigned char *in, size_t size,
+                        const unsigned char *data, size_t n) {
+    block_options options = {.threads = 1};
+    size_t decoded;
+    unsigned char *out = decode_buffer(model, in, size, &options, &decoded);
+    int err = out != NULL && decoded == n && memcmp(out, data, n) == 0 ? 0 : -1;
+    free(out);
+
+    container *c = malloc(sizeof(container));
+    if (err == 0 && container_read(c, in, size, model) != 0) {
+        err = -1;
+    }
+    size_t start = 0;
+    for (size_t i = 0; err == 0 && i < c->count; i++) {
+        unsigned char *block = (unsigned char *)c->blocks + start;
+        start += container_block(c, i).bytes;
+        if ((block[0] & BLOCK_CHECKSUM) == 0) {
+            continue;
+        }
+        block[5] ^= 1;
+        out = decode_buffer(model, in, size, &options, &decoded);
+        if (out != NULL) {
+            err = -1;
+        }
+        free(out);
+        block[5] ^= 1;
+    }
+    free(c);
+    return err;
+}
+
+/*
+ * Moves a character from the first entry of the block table of the
+ * size bytes in in to the second, which keeps the totals that
+ * container_read checks, but no longer matches the block headers. Both
+ * decoders must reject the file. Returns 0 if they do.
+ */
+static int check_moved_chars(const huffman_table *model, unsigned char *in, size_t size,
+                             const unsigned char *data, size_t n) {
+    container *c = malloc(sizeof(container));
+    int err = container_read(c, in, size, model);
+    if (err == 0 && c->count >= 2) {
+        unsigned char *sizes = (unsigned char *)c->sizes;
+        store_le32(sizes, load_le32(sizes) - 1);
+        store_le32(sizes + 8, load_le32(sizes + 8) + 1);
+
+        size_t decoded;
+        unsigned char *out = decode_buffer(model, in, size, &(block_options){.threads = 1},
+                                           &decoded);
+        if (out != NULL || decode_bytewise(model, in, size, data, n) == 0) {
+            err = -1;
+        }
+        free(out);
+
+        store_le32(sizes, load_le32(sizes) + 1);
+        store_le32(sizes + 8, load_le32(sizes + 8) - 1);
+    }
+    free(c);
+    return err;
+}
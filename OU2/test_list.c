@@ -0,0 +1,113 @@
+/**
+  * Compiles with:
+  * gcc -Wall -std=c99 -o test_list list.c ilist.c test_list.c
+  *
+  * Just a short demonstration of inserting ranges of values with
+  * list_insert_range and ilist_insert_range. Each list is printed
+  * forwards and backwards, so that both the next and the previous
+  * links of the spliced nodes are shown.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "list.h"
+#include "ilist.h"
+
+typedef struct {
+	char val;
+	ilist_link link;
+} ilist_elem;
+
+
+/*
+ * Prints the characters of a list from the first to the last and then
+ * from the last to the first
+ */
+void print_list(list *l)
+{
+	list_position pos = list_first(l);
+	while (!list_is_end(l, pos)) {
+		printf("%c", *(char *)list_inspect(l, pos));
+		pos = list_next(l, pos);
+	}
+	printf(" ");
+	pos = list_end(l);
+	while (!list_is_first(l, pos)) {
+		pos = list_previous(l, pos);
+		printf("%c", *(char *)list_inspect(l, pos));
+	}
+	printf("\n");
+}
+
+void print_ilist(ilist *l)
+{
+	ilist_position pos = ilist_first(l);
+	while (!ilist_is_end(l, pos)) {
+		printf("%c", ILIST_ENTRY(ilist_inspect(l, pos), ilist_elem, link)->val);
+		pos = ilist_next(l, pos);
+	}
+	printf(" ");
+	pos = ilist_end(l);
+	while (!ilist_is_first(l, pos)) {
+		pos = ilist_previous(l, pos);
+		printf("%c", ILIST_ENTRY(ilist_inspect(l, pos), ilist_elem, link)->val);
+	}
+	printf("\n");
+}
+
+/*
+ * Inserts "bc" into an empty list, "a" at its start, "xy" between the
+ * b and the c and "de" at its end, each as one range
+ */
+void test_list(void)
+{
+	static char chars[] = "abcdexy";
+	void *bc[] = {&chars[1], &chars[2]};
+	void *a[] = {&chars[0]};
+	void *xy[] = {&chars[5], &chars[6]};
+	void *de[] = {&chars[3], &chars[4]};
+
+	list *l = list_empty();
+	list_insert_range(l, list_first(l), bc, 2);
+	list_insert_range(l, list_first(l), a, 1);
+	list_position pos = list_next(l, list_next(l, list_first(l)));
+	pos = list_insert_range(l, pos, xy, 2);
+	list_insert_range(l, list_end(l), de, 2);
+	list_insert_range(l, pos, NULL, 0);
+
+	printf("The list should read abxycde edcyxba:\n");
+	print_list(l);
+	list_kill(l);
+}
+
+void test_ilist(void)
+{
+	ilist_elem elems[7];
+	for (int i = 0; i < 7; i++) {
+		elems[i].val = "abcdexy"[i];
+	}
+	ilist_link *bc[] = {&elems[1].link, &elems[2].link};
+	ilist_link *a[] = {&elems[0].link};
+	ilist_link *xy[] = {&elems[5].link, &elems[6].link};
+	ilist_link *de[] = {&elems[3].link, &elems[4].link};
+
+	ilist l;
+	ilist_init(&l);
+	ilist_insert_range(&l, ilist_first(&l), bc, 2);
+	ilist_insert_range(&l, ilist_first(&l), a, 1);
+	ilist_position pos = ilist_next(&l, ilist_next(&l, ilist_first(&l)));
+	pos = ilist_insert_range(&l, pos, xy, 2);
+	ilist_insert_range(&l, ilist_end(&l), de, 2);
+	ilist_insert_range(&l, pos, NULL, 0);
+
+	printf("The intrusive list should read the same:\n");
+	print_ilist(&l);
+}
+
+int main()
+{
+	test_list();
+	test_ilist();
+
+	return 0;
+}
@@ -1,6 +1,9 @@
 /**
   * Compiles with:
-  * gcc -Wall -std=c99 -o test_pqueue list.c pqueue.c test_pqueue.c
+  * gcc -Wall -std=c99 -o test_pqueue pqueue.c test_pqueue.c
+  *
+  * It also demonstrates the queue generated by PQUEUE_DEFINE from
+  * pqueue_def.h, which holds the elements by value.
   *
   * Just a short demonstration of usage of the datatype pqueue.
   * The code lacks some comments.
@@ -13,12 +16,26 @@
 #include <stdlib.h>
 #include "list.h"
 #include "pqueue.h"
+#include "pqueue_def.h"
 
 typedef struct {
 	int prio;
 	char val;
 } queue_elem;
 
+/* The generated queue does not keep equal priorities in insertion
+   order by itself, so the elements carry their insertion order */
+typedef struct {
+	int prio;
+	char val;
+	int seq;
+} value_elem;
+
+#define value_less(a, b) ((a)->prio < (b)->prio || \
+                          ((a)->prio == (b)->prio && (a)->seq < (b)->seq))
+
+PQUEUE_DEFINE(value_pq, value_elem, value_less)
+
 
 /* Function for comparing two prio-elements
  *
@@ -53,6 +70,22 @@ pqueue *create_pq(int choice)
 	return pq;
 }
 
+pqueue *create_pq_from_array(void)
+{
+	int numbers[7] = {5,3,9,7,1,0,5};
+	char chars[7] = {'a','a','a','a','a','a','b'};
+	void *values[7];
+
+	for (int i = 0; i < 7; i++){
+		queue_elem *q_elem = malloc(sizeof *q_elem);
+		q_elem->prio = numbers[i];
+		q_elem->val = chars[i];
+		values[i] = q_elem;
+	}
+
+	return pqueue_from_array(values, 7, lessthan);
+}
+
 /*
  * Prints and empties a priorityqueue (but does not remove the queue)
  */
@@ -72,6 +105,34 @@ void print_and_empty(pqueue *pq)
 }
 
 
+/*
+ * Merges two elements into one with the sum of their priorities, as
+ * two nodes are merged into their parent in a Huffman trie
+ */
+void *merge_elems(void *elem1, void *elem2)
+{
+	queue_elem *q_elem = malloc(sizeof *q_elem);
+	q_elem->prio = ((queue_elem *)elem1)->prio + ((queue_elem *)elem2)->prio;
+	q_elem->val = 'm';
+	free(elem1);
+	free(elem2);
+	return q_elem;
+}
+
+/*
+ * Prints and empties a generated queue
+ */
+void print_and_empty_values(value_pq *pq)
+{
+	printf("\nThe elements in the queue:\n");
+
+	while (!value_pq_is_empty(pq)){
+		value_elem v_elem = value_pq_delete_first(pq);
+		printf("(%d, %c) ", v_elem.prio, v_elem.val);
+	}
+	printf("\n");
+}
+
 /*
  * The test creates a priority queue and insert the tuples (5,a)
  * (3,a) (9,a) (7,a) (1,a) (0,a) (5,b) into it, then it empties the
@@ -93,5 +154,56 @@ int main()
 	printf("\n");
 	pqueue_kill(pq);
 
+	printf("\nThe same elements given to pqueue_from_array should ");
+	printf("give the same result:\n");
+
+	pq = create_pq_from_array();
+
+	print_and_empty(pq);
+	printf("\n");
+	pqueue_kill(pq);
+
+	printf("\nRemoving the first three with pqueue_pop_n and then ");
+	printf("merging the\nfirst two twice with pqueue_merge_first_two ");
+	printf("should give\n(0, a) (1, a) (3, a) and then (10, m) (16, m)\n");
+
+	pq = create_pq_from_array();
+	void *values[3];
+	size_t popped = pqueue_pop_n(pq, values, 3);
+	printf("\nThe removed elements:\n");
+	for (size_t i = 0; i < popped; i++) {
+		queue_elem *q_elem = values[i];
+		printf("(%d, %c) ", q_elem->prio, q_elem->val);
+		free(q_elem);
+	}
+	printf("\n");
+	pqueue_merge_first_two(pq, merge_elems);
+	pqueue_merge_first_two(pq, merge_elems);
+
+	print_and_empty(pq);
+	printf("\n");
+	pqueue_kill(pq);
+
+	printf("\nThe queue generated by PQUEUE_DEFINE should also give ");
+	printf("(5, a) before\n(5, b), both when inserted one by one and ");
+	printf("from an array:\n");
+
+	int numbers[7] = {5,3,9,7,1,0,5};
+	char chars[7] = {'a','a','a','a','a','a','b'};
+	value_elem elems[7];
+	value_pq *vpq = value_pq_empty();
+	for (int i = 0; i < 7; i++){
+		elems[i] = (value_elem){numbers[i], chars[i], i};
+		value_pq_insert(vpq, elems[i]);
+	}
+
+	print_and_empty_values(vpq);
+	value_pq_kill(vpq);
+
+	vpq = value_pq_from_array(elems, 7);
+	print_and_empty_values(vpq);
+	printf("\n");
+	value_pq_kill(vpq);
+
 	return 0;
 }
@@ -0,0 +1,506 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "train.h"
+#include "parallel.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_SIZE (256 * 1024)
+#define MAX_EXTENSION 16
+
+enum { SNIFF_TEXT, SNIFF_JSON, SNIFF_XML, SNIFF_BINARY, SNIFF_CATEGORIES };
+
+static const char *const sniff_names[SNIFF_CATEGORIES] = {"text", "json", "xml", "binary"};
+
+typedef struct train_work train_work;
+
+/* A file of the corpus. Regular files are counted in chunks, and the
+   last chunk to finish closes the file. */
+typedef struct {
+    train_work *work;
+    char *path;
+    int category;
+    int fd;
+    off_t size;
+    size_t remaining;
+} train_file;
+
+/*
+ * counts   threads * categories tables of 256 counts, so that every
+ *          thread adds to its own tables.
+ * buffers  A read buffer for each thread, allocated on first use.
+ */
+struct train_work {
+    int by;
+    train_file *files;
+    size_t count;
+    size_t capacity;
+    char **names;
+    int categories;
+
+    int threads;
+    uint64_t *counts;
+    unsigned char **buffers;
+
+    pthread_mutex_t lock;
+    size_t failed;
+};
+
+static int add_source(train_work *work, const char *source);
+static int add_path(train_work *work, const char *path);
+static int add_directory(train_work *work, const char *path);
+static void add_file(train_work *work, const char *path);
+static int extension_category(train_work *work, const char *path);
+static int sniff(const unsigned char *data, size_t n);
+static void count_file(task_worker *worker, void *context, size_t i);
+static void count_chunk(task_worker *worker, void *context, size_t i);
+static void count_stream(train_file *file, int thread);
+static unsigned char *thread_buffer(train_work *work, int thread);
+static void file_failed(train_file *file);
+static int save_model(const char *path, const uint64_t *counts);
+static int commit_model(const char *path);
+static void remove_model(const char *path);
+
+int train(const char *out_path, const char *sources[], int count, int categories,
+          const prog_options *options) {
+    train_work work;
+    memset(&work, 0, sizeof(work));
+    work.by = categories;
+    work.capacity = 64;
+    work.files = malloc(work.capacity * sizeof(train_file));
+    if (categories == TRAIN_BY_CONTENT) {
+        work.names = malloc(SNIFF_CATEGORIES * sizeof(char *));
+        for (int c = 0; c < SNIFF_CATEGORIES; c++) {
+            work.names[c] = strdup(sniff_names[c]);
+        }
+        work.categories = SNIFF_CATEGORIES;
+    } else if (categories == TRAIN_WHOLE) {
+        work.categories = 1;
+    }
+
+    int err = 0;
+    for (int i = 0; i < count && !err; i++) {
+        err = add_source(&work, sources[i]);
+    }
+    if (!err && work.count == 0) {
+        fprintf(stderr, "No files to train on\n");
+        err = 1;
+    }
+
+    if (!err) {
+        work.threads = options->blocks.threads > 0 ? options->blocks.threads
+                                                   : parallel_processors();
+        work.counts = calloc((size_t)work.threads * work.categories * 256, sizeof(uint64_t));
+        work.buffers = calloc(work.threads, sizeof(unsigned char *));
+        pthread_mutex_init(&work.lock, NULL);
+
+        /* One task per file, which spawns a task per chunk, so a few
+           large files still spread over all threads */
+        parallel_tasks(work.count, work.threads, count_file, &work);
+
+        pthread_mutex_destroy(&work.lock);
+        err = work.failed > 0;
+    }
+
+    if (!err) {
+        /* Reduce the tables of the threads, then the categories */
+        uint64_t *totals = calloc((size_t)work.categories * 256, sizeof(uint64_t));
+        uint64_t whole[256] = {0};
+        for (int t = 0; t < work.threads; t++) {
+            const uint64_t *counts = work.counts + (size_t)t * work.categories * 256;
+            for (size_t k = 0; k < (size_t)work.categories * 256; k++) {
+                totals[k] += counts[k];
+            }
+        }
+        for (int c = 0; c < work.categories; c++) {
+            for (int s = 0; s < 256; s++) {
+                whole[s] += totals[c * 256 + s];
+            }
+        }
+
+        /* Every model is written to PATH.tmp first, and the models are
+           only renamed to their paths once all of them are written */
+        char **paths = malloc(((size_t)work.categories + 1) * sizeof(char *));
+        size_t *files = malloc(((size_t)work.categories + 1) * sizeof(size_t));
+        int models = 0;
+        paths[models] = strdup(out_path);
+        files[models] = work.count;
+        err = save_model(paths[models], whole);
+        if (err) {
+            fprintf(stderr, "Could not write the histogram: %s\n", out_path);
+            free(paths[models]);
+        } else {
+            models++;
+        }
+        for (int c = 0; c < work.categories && work.by != TRAIN_WHOLE && !err; c++) {
+            files[models] = 0;
+            for (size_t i = 0; i < work.count; i++) {
+                files[models] += work.files[i].category == c;
+            }
+            if (files[models] == 0) {
+                continue;
+            }
+
+            char *path = malloc(strlen(out_path) + strlen(work.names[c]) + 2);
+            sprintf(path, "%s.%s", out_path, work.names[c]);
+            err = save_model(path, totals + c * 256);
+            if (err) {
+                fprintf(stderr, "Could not write the histogram: %s\n", path);
+                free(path);
+            } else {
+                paths[models++] = path;
+            }
+        }
+        for (int m = 0; m < models; m++) {
+            if (err) {
+                remove_model(paths[m]);
+            } else if (commit_model(paths[m]) != 0) {
+                fprintf(stderr, "Could not write the histogram: %s\n", paths[m]);
+                err = 1;
+            } else if (m > 0) {
+                fprintf(stderr, "%s: %zu files\n", paths[m], files[m]);
+            }
+            free(paths[m]);
+        }
+        if (!err) {
+            fprintf(stderr, "%s: %zu files on %d threads\n", out_path, work.count,
+                    work.threads);
+        }
+        free(files);
+        free(paths);
+        free(totals);
+    }
+
+    for (size_t i = 0; i < work.count; i++) {
+        free(work.files[i].path);
+    }
+    for (int c = 0; c < work.categories && work.names != NULL; c++) {
+        free(work.names[c]);
+    }
+    for (int t = 0; t < work.threads; t++) {
+        free(work.buffers[t]);
+    }
+    free(work.buffers);
+    free(work.counts);
+    free(work.names);
+    free(work.files);
+
+    return err ? 1 : 0;
+}
+
+/* Adds the files of a source. Returns 0 on success. */
+static int add_source(train_work *work, const char *source) {
+    if (source[0] != '@') {
+        return add_path(work, source);
+    }
+
+    const char *list_path = source + 1;
+    FILE *list_file_p = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "rb");
+    if (list_file_p == NULL) {
+        fprintf(stderr, "Could not open the file: %s\n", list_path);
+        return -1;
+    }
+    size_t list_size;
+    unsigned char *list = read_file(list_file_p, &list_size);
+    if (list_file_p != stdin) {
+        fclose(list_file_p);
+    }
+    if (list == NULL) {
+        fprintf(stderr, "Could not read the file: %s\n", list_path);
+        return -1;
+    }
+    list = realloc(list, list_size + 1);
+    list[list_size] = '\0';
+
+    int err = 0;
+    for (char *line = (char *)list; *line != '\0' && !err;) {
+        char *end = line + strcspn(line, "\n");
+        char *next = *end != '\0' ? end + 1 : end;
+        *end = '\0';
+        if (end > line && end[-1] == '\r') {
+            end[-1] = '\0';
+        }
+        if (*line != '\0') {
+            err = add_path(work, line);
+        }
+        line = next;
+    }
+
+    free(list);
+    return err;
+}
+
+static int add_path(train_work *work, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Could not open the file: %s\n", path);
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return add_directory(work, path);
+    }
+    add_file(work, path);
+    return 0;
+}
+
+/* Adds the regular files under path. Symbolic links to directories are
+   not followed, so the walk always ends. */
+static int add_directory(train_work *work, const char *path) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "Could not open the directory: %s\n", path);
+        return -1;
+    }
+
+    int err = 0;
+    struct dirent *de;
+    while (!err && (de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+        char *child = malloc(strlen(path) + strlen(de->d_name) + 2);
+        sprintf(child, "%s/%s", path, de->d_name);
+
+        struct stat st;
+        if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+            err = add_directory(work, child);
+        } else if (stat(child, &st) == 0 && S_ISREG(st.st_mode)) {
+            add_file(work, child);
+        }
+        free(child);
+    }
+
+    closedir(dir);
+    return err;
+}
+
+static void add_file(train_work *work, const char *path) {
+    if (work->count == work->capacity) {
+        work->capacity *= 2;
+        work->files = realloc(work->files, work->capacity * sizeof(train_file));
+    }
+
+    train_file *file = memset(&work->files[work->count++], 0, sizeof(train_file));
+    file->work = work;
+    file->path = strdup(path);
+    file->fd = -1;
+    if (work->by == TRAIN_BY_EXTENSION) {
+        file->category = extension_category(work, path);
+    }
+}
+
+/* Returns the category of the extension of path, and adds it if it is
+   new. Extensions that are long or not alphanumeric are "other". */
+static int extension_category(train_work *work, const char *path) {
+    const char *base = strrchr(path, '/');
+    base = base != NULL ? base + 1 : path;
+    const char *dot = strrchr(base, '.');
+
+    char name[MAX_EXTENSION + 1] = "none";
+    if (dot != NULL && dot != base && dot[1] != '\0') {
+        size_t length = strlen(dot + 1);
+        bool valid = length <= MAX_EXTENSION;
+        for (size_t k = 0; k < length && valid; k++) {
+            valid = isalnum((unsigned char)dot[1 + k]);
+            name[k] = tolower((unsigned char)dot[1 + k]);
+        }
+        if (valid) {
+            name[length] = '\0';
+        } else {
+            strcpy(name, "other");
+        }
+    }
+
+    for (int c = 0; c < work->categories; c++) {
+        if (strcmp(work->names[c], name) == 0) {
+            return c;
+        }
+    }
+    work->names = realloc(work->names, (work->categories + 1) * sizeof(char *));
+    work->names[work->categories] = strdup(name);
+    return work->categories++;
+}
+
+/* Guesses the kind of a file from its first bytes */
+static int sniff(const unsigned char *data, size_t n) {
+    size_t control = 0;
+    for (size_t k = 0; k < n; k++) {
+        unsigned char c = data[k];
+        if (c == 0) {
+            return SNIFF_BINARY;
+        }
+        if ((c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != 0x1b) ||
+            c == 0x7f) {
+            control++;
+        }
+    }
+    if (control * 10 > n) {
+        return SNIFF_BINARY;
+    }
+
+    size_t k = n >= 3 && memcmp(data, "\xef\xbb\xbf", 3) == 0 ? 3 : 0;
+    while (k < n && isspace(data[k])) {
+        k++;
+    }
+    if (k < n && (data[k] == '{' || data[k] == '[')) {
+        return SNIFF_JSON;
+    }
+    if (k < n && data[k] == '<') {
+        return SNIFF_XML;
+    }
+    return SNIFF_TEXT;
+}
+
+static void count_file(task_worker *worker, void *context, size_t i) {
+    train_work *work = context;
+    train_file *file = &work->files[i];
+    int thread = parallel_worker_index(worker);
+
+    struct stat st;
+    file->fd = open(file->path, O_RDONLY);
+    if (file->fd < 0 || fstat(file->fd, &st) != 0) {
+        if (file->fd >= 0) {
+            close(file->fd);
+        }
+        file_failed(file);
+        return;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        count_stream(file, thread);
+        return;
+    }
+
+    /* The category must be known before any chunk is counted */
+    if (work->by == TRAIN_BY_CONTENT) {
+        unsigned char *buffer = thread_buffer(work, thread);
+        ssize_t n = pread(file->fd, buffer, TRAIN_SNIFF_BYTES, 0);
+        file->category = sniff(buffer, n > 0 ? n : 0);
+    }
+
+    file->size = st.st_size;
+    size_t chunks = (file->size + TRAIN_CHUNK_SIZE - 1) / TRAIN_CHUNK_SIZE;
+    if (chunks == 0) {
+        close(file->fd);
+        return;
+    }
+    file->remaining = chunks;
+    for (size_t j = chunks; j-- > 1;) {
+        parallel_spawn(worker, count_chunk, file, j);
+    }
+    count_chunk(worker, file, 0);
+}
+
+static void count_chunk(task_worker *worker, void *context, size_t i) {
+    train_file *file = context;
+    train_work *work = file->work;
+    int thread = parallel_worker_index(worker);
+    unsigned char *buffer = thread_buffer(work, thread);
+    uint64_t *counts = work->counts + ((size_t)thread * work->categories + file->category) * 256;
+
+    off_t offset = (off_t)i * TRAIN_CHUNK_SIZE;
+    off_t end = offset + TRAIN_CHUNK_SIZE < file->size ? offset + TRAIN_CHUNK_SIZE : file->size;
+    bool failed = false;
+    while (offset < end) {
+        size_t want = end - offset < READ_SIZE ? (size_t)(end - offset) : READ_SIZE;
+        ssize_t n = pread(file->fd, buffer, want, offset);
+        if (n <= 0) {
+            /* A file that shrank while it was counted is counted up to
+               its new end */
+            failed = n < 0;
+            break;
+        }
+        count_bytes(buffer, n, counts);
+        offset += n;
+    }
+
+    pthread_mutex_lock(&work->lock);
+    bool last = --file->remaining == 0;
+    pthread_mutex_unlock(&work->lock);
+
+    if (failed) {
+        file_failed(file);
+    }
+    if (last) {
+        close(file->fd);
+    }
+}
+
+/* Counts a pipe or device, which can only be read in order */
+static void count_stream(train_file *file, int thread) {
+    train_work *work = file->work;
+    unsigned char *buffer = thread_buffer(work, thread);
+    bool first = true;
+
+    ssize_t n;
+    while ((n = read(file->fd, buffer, READ_SIZE)) > 0) {
+        if (first && work->by == TRAIN_BY_CONTENT) {
+            file->category = sniff(buffer, n < TRAIN_SNIFF_BYTES ? n : TRAIN_SNIFF_BYTES);
+        }
+        first = false;
+        count_bytes(buffer, n, work->counts +
+                    ((size_t)thread * work->categories + file->category) * 256);
+    }
+    close(file->fd);
+
+    if (n < 0) {
+        file_failed(file);
+    }
+}
+
+static unsigned char *thread_buffer(train_work *work, int thread) {
+    if (work->buffers[thread] == NULL) {
+        work->buffers[thread] = malloc(READ_SIZE);
+    }
+    return work->buffers[thread];
+}
+
+static void file_failed(train_file *file) {
+    fprintf(stderr, "Could not read the file: %s\n", file->path);
+    pthread_mutex_lock(&file->work->lock);
+    file->work->failed++;
+    pthread_mutex_unlock(&file->work->lock);
+}
+
+/* Writes the counts as a histogram to PATH.tmp. Returns 0 on success. */
+static int save_model(const char *path, const uint64_t *counts) {
+    charFrequency frequency[256];
+    for (int i = 0; i < 256; i++) {
+        frequency[i].character = i;
+        frequency[i].frequency = (long long)counts[i];
+    }
+
+    char *tmp_path = malloc(strlen(path) + 5);
+    sprintf(tmp_path, "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "wb");
+    int err = fp == NULL ? -1 : histogram_save(fp, frequency);
+    if (fp != NULL && fclose(fp) != 0) {
+        err = -1;
+    }
+    if (err && fp != NULL) {
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return err;
+}
+
+/* Renames the model written by save_model to path */
+static int commit_model(const char *path) {
+    char *tmp_path = malloc(strlen(path) + 5);
+    sprintf(tmp_path, "%s.tmp", path);
+    int err = rename(tmp_path, path);
+    free(tmp_path);
+    return err;
+}
+
+/* Removes the model written by save_model */
+static void remove_model(const char *path) {
+    char *tmp_path = malloc(strlen(path) + 5);
+    sprintf(tmp_path, "%s.tmp", path);
+    remove(tmp_path);
+    free(tmp_path);
+}
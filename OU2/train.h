@@ -0,0 +1,42 @@
+#ifndef TRAIN
+#define TRAIN
+
+#include "huffman.h"
+
+/*
+ * Trains models on a corpus of many files.
+ *
+ * Each source is a file, a directory, whose regular files are used
+ * recursively, or @LIST, a file that names one source per line (@- is
+ * read from stdin). The files are counted in parallel, and the models
+ * are stored as histogram files, which can be given as FILE0.
+ *
+ * With categories, each file is also counted towards the model of its
+ * category, which is stored in OUT.CATEGORY next to the model of the
+ * whole corpus in OUT. TRAIN_BY_EXTENSION uses the lower case file
+ * extension, or "none". TRAIN_BY_CONTENT looks at the first
+ * TRAIN_SNIFF_BYTES bytes and picks "text", "json", "xml" or "binary".
+ */
+
+#define TRAIN_WHOLE 0
+#define TRAIN_BY_EXTENSION 1
+#define TRAIN_BY_CONTENT 2
+
+#define TRAIN_SNIFF_BYTES 4096
+
+/* Larger files are split into chunks of this size, which are counted
+   by different threads */
+#define TRAIN_CHUNK_SIZE (4 * 1024 * 1024)
+
+/*
+ * Counts the files of sources[0..count) on options->blocks.threads
+ * threads, each with its own 64-bit counts, adds the counts up and
+ * stores the models. Returns 0 on success and 1 if a file could not be
+ * read or a model could not be written. The models are written to
+ * PATH.tmp and only renamed to their paths once all of them are
+ * written, so a failure leaves the models of an earlier run in place.
+ */
+int train(const char *out_path, const char *sources[], int count, int categories,
+          const prog_options *options);
+
+#endif